@@ -0,0 +1,71 @@
+#!/bin/sh
+#
+# Writes the synthetic inputs of the compile-time benchmark to the given
+# directory. The sizes are multiplied by the optional scale factor.
+#
+#   functions.c     thousands of small functions, all called from main
+#   nested.c        deeply nested if and while statements
+#   expressions.c   long arithmetic expressions
+#   strings.c       a large table of string literals, each used twice
+#
+# Usage: generate.sh directory [scale]
+
+if [ $# -lt 1 ]; then
+  echo "Usage: $0 directory [scale]" >&2
+  exit 1
+fi
+DIRECTORY=$1
+SCALE=${2:-1}
+mkdir -p "$DIRECTORY" || exit 1
+
+awk -v n=$((5000 * SCALE)) 'BEGIN {
+  print "void print_int(int i);"
+  for (i = 0; i < n; i++) {
+    printf "int f%d(int a) {\n  int b;\n  b = a * %d + 1;\n", i, i % 7 + 2
+    printf "  if (b < %d) {\n    b = b - a;\n  }\n  return 0;\n}\n", i
+  }
+  print "int main(void) {\n  int s;\n  s = 0;"
+  for (i = 0; i < n; i++) {
+    printf "  s = s + f%d(%d);\n", i, i
+  }
+  print "  print_int(s);\n  return 0;\n}"
+}' > "$DIRECTORY/functions.c"
+
+awk -v n=$((200 * SCALE)) 'BEGIN {
+  print "void print_int(int i);\nint main(void) {\n  int a;\n  int b;\n  a = 0;\n  b = 0;"
+  for (i = 0; i < n; i++) {
+    if (i % 2 == 0) {
+      printf "  if (a < %d) {\n  a = a + 1;\n", n
+    } else {
+      printf "  while (b < %d) {\n  b = b + 1;\n", i
+    }
+  }
+  for (i = 0; i < n; i++) {
+    print "  }"
+  }
+  print "  print_int(a);\n  print_int(b);\n  return 0;\n}"
+}' > "$DIRECTORY/nested.c"
+
+awk -v n=$((200 * SCALE)) -v terms=200 'BEGIN {
+  print "void print_int(int i);\nint main(void) {\n  int a;\n  int b;\n  int c;\n  a = 3;\n  b = 5;"
+  for (i = 0; i < n; i++) {
+    printf "  c = a"
+    for (j = 0; j < terms; j++) {
+      op = substr("+-*", j % 3 + 1, 1)
+      printf " %s %s", op, (j % 2 == 0) ? "b" : j
+    }
+    print ";\n  print_int(c);"
+  }
+  print "  return 0;\n}"
+}' > "$DIRECTORY/expressions.c"
+
+awk -v n=$((5000 * SCALE)) 'BEGIN {
+  print "void print_string(char *s);\nint main(void) {"
+  for (i = 0; i < n; i++) {
+    printf "  print_string(\"benchmark string number %d\\n\");\n", i
+  }
+  for (i = 0; i < n; i++) {
+    printf "  print_string(\"benchmark string number %d\\n\");\n", i
+  }
+  print "  return 0;\n}"
+}' > "$DIRECTORY/strings.c"
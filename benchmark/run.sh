@@ -0,0 +1,61 @@
+#!/bin/sh
+#
+# Compile-time benchmark. Compiles the programs in tests/ and the synthetic
+# inputs written by generate.sh, and prints for every phase its wall time in
+# milliseconds and the kilobytes it allocated, as reported by -f time-report
+# and -f mem-report, followed by the peak memory of the compiler. Programs the
+# compiler rejects are listed with the exit status of the compiler.
+#
+# Usage: run.sh compiler [scale]
+
+if [ $# -lt 1 ]; then
+  echo "Usage: $0 compiler [scale]" >&2
+  exit 1
+fi
+COMPILER=$1
+SCALE=${2:-1}
+BENCHMARK_DIRECTORY=$(cd "$(dirname "$0")" && pwd)
+TESTS_DIRECTORY=$BENCHMARK_DIRECTORY/../tests
+
+WORK_DIRECTORY=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK_DIRECTORY"' EXIT INT TERM
+
+sh "$BENCHMARK_DIRECTORY/generate.sh" "$WORK_DIRECTORY/generated" "$SCALE" || exit 1
+
+PHASES="parse symbols types ir noops gotos labels promotion constants sccp strength dead mips total"
+
+printf "%-28s" input
+for phase in $PHASES; do
+  printf " %17s" "$phase"
+done
+printf " %10s\n" "peak KB"
+printf "%-28s" ""
+for phase in $PHASES; do
+  printf " %8s %8s" ms KB
+done
+printf "\n"
+
+for input in "$TESTS_DIRECTORY"/*/*.c "$WORK_DIRECTORY"/generated/*.c; do
+  name=$(basename "$(dirname "$input")")/$(basename "$input")
+  "$COMPILER" -f time-report -f mem-report -D "$WORK_DIRECTORY/report" -o "$WORK_DIRECTORY/output.s" "$input" \
+    > "$WORK_DIRECTORY/messages" 2>&1
+  status=$?
+  if [ $status -ne 0 ]; then
+    printf "%-28s failed with status %d\n" "$name" $status
+    continue
+  fi
+  awk -v name="$name" -v phases="$PHASES" '
+    /TIME REPORT/ { section = "time"; next }
+    /MEMORY REPORT/ { section = "memory"; next }
+    /^$|^phase|^arena/ { next }
+    section == "time" && NF == 3 { milliseconds[$1] = $2 * 1000; peak = $3 }
+    section == "memory" && NF >= 7 { kilobytes[$1] = $2 / 1024 }
+    END {
+      printf "%-28s", name
+      num_phases = split(phases, phase_names, " ")
+      for (i = 1; i <= num_phases; i++) {
+        printf " %8.2f %8.1f", milliseconds[phase_names[i]], kilobytes[phase_names[i]]
+      }
+      printf " %10d\n", peak
+    }' "$WORK_DIRECTORY/report"
+done
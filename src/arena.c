@@ -0,0 +1,133 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "arena.h"
+
+/*
+ * An arena is a list of chunks, newest first; allocations are carved off the
+ * front chunk until it is full. Chunks come from calloc and are freed on
+ * reset rather than reused, so every allocation starts out zeroed.
+ */
+
+#define ARENA_CHUNK_SIZE   65536
+#define ARENA_ALIGNMENT    8
+
+struct arena_chunk {
+  struct arena_chunk *next;
+  size_t size;
+  size_t used;
+  /* Keeps the memory that follows the header aligned */
+  union {
+    long l;
+    double d;
+    void *p;
+  } data[1];
+};
+
+struct arena parse_tree_arena = { "parse tree", NULL, 0, 0, 0, 0, 0 };
+struct arena symbol_arena     = { "symbols",    NULL, 0, 0, 0, 0, 0 };
+struct arena ir_arena         = { "ir",         NULL, 0, 0, 0, 0, 0 };
+struct arena string_arena     = { "strings",    NULL, 0, 0, 0, 0, 0 };
+struct arena optimizer_arena  = { "optimizer",  NULL, 0, 0, 0, 0, 0 };
+
+static struct arena *all_arenas[] = {
+  &parse_tree_arena,
+  &symbol_arena,
+  &ir_arena,
+  &string_arena,
+  &optimizer_arena,
+  NULL
+};
+
+void *arena_allocate(struct arena *arena, size_t size) {
+  struct arena_chunk *chunk = arena->chunks;
+  void *memory;
+  size_t chunk_size;
+
+  size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+  if(size == 0) {
+    size = ARENA_ALIGNMENT;
+  }
+
+  if(chunk == NULL || chunk->used + size > chunk->size) {
+    /* Anything larger than a chunk gets a chunk of its own */
+    chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+    chunk = calloc(1, offsetof(struct arena_chunk, data) + chunk_size);
+    assert(NULL != chunk);
+    chunk->size = chunk_size;
+    chunk->used = 0;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+
+    arena->bytes_reserved += chunk_size;
+    if(arena->bytes_reserved > arena->peak_bytes_reserved) {
+      arena->peak_bytes_reserved = arena->bytes_reserved;
+    }
+  }
+
+  memory = (char *)chunk->data + chunk->used;
+  chunk->used += size;
+  arena->num_allocations++;
+  arena->bytes_allocated += size;
+  return memory;
+}
+
+void arena_reset(struct arena *arena) {
+  struct arena_chunk *chunk, *next_chunk;
+
+  for(chunk = arena->chunks; chunk != NULL; chunk = next_chunk) {
+    next_chunk = chunk->next;
+    free(chunk);
+  }
+  arena->chunks = NULL;
+  arena->bytes_reserved = 0;
+  arena->num_resets++;
+}
+
+/*
+ * Releases the memory of the whole compilation. The string pool has tables
+ * of its own; string_pool_release has to be used for the strings.
+ */
+void arena_release_all(void) {
+  int i;
+  for(i = 0; all_arenas[i] != NULL; i++) {
+    if(all_arenas[i] != &string_arena) {
+      arena_reset(all_arenas[i]);
+    }
+  }
+}
+
+/* Bytes handed out by all of the arenas so far */
+unsigned long arena_total_bytes_allocated(void) {
+  unsigned long total = 0;
+  int i;
+  for(i = 0; all_arenas[i] != NULL; i++) {
+    total += all_arenas[i]->bytes_allocated;
+  }
+  return total;
+}
+
+/* Bytes the arenas are holding on to right now */
+unsigned long arena_total_bytes_reserved(void) {
+  unsigned long total = 0;
+  int i;
+  for(i = 0; all_arenas[i] != NULL; i++) {
+    total += all_arenas[i]->bytes_reserved;
+  }
+  return total;
+}
+
+void arena_print_statistics(FILE *output) {
+  struct arena *arena;
+  int i;
+
+  fprintf(output, "%-12s %12s %12s %12s %8s\n",
+          "arena", "allocations", "bytes", "peak bytes", "resets");
+  for(i = 0; all_arenas[i] != NULL; i++) {
+    arena = all_arenas[i];
+    fprintf(output, "%-12s %12lu %12lu %12lu %8lu\n", arena->name, arena->num_allocations,
+            arena->bytes_allocated, arena->peak_bytes_reserved, arena->num_resets);
+  }
+}
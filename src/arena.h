@@ -0,0 +1,53 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * Bump pointer arenas. Memory handed out by an arena is zero filled and is
+ * never freed on its own; resetting the arena releases everything allocated
+ * from it at once.
+ *
+ *   parse_tree_arena - nodes of the abstract syntax tree
+ *   symbol_arena     - symbols, symbol tables and types
+ *   ir_arena         - IR instructions and sections
+ *   string_arena     - text of the string pool
+ *   optimizer_arena  - scratch data for the function that is being
+ *                      optimized or emitted; reset when the function is done
+ *
+ * Each arena counts the allocations made from it over the whole
+ * compilation, including those released by earlier resets.
+ */
+
+struct arena_chunk;
+
+struct arena {
+  const char *name;
+  struct arena_chunk *chunks;
+  unsigned long num_allocations;
+  unsigned long bytes_allocated;
+  unsigned long bytes_reserved;
+  unsigned long peak_bytes_reserved;
+  unsigned long num_resets;
+};
+
+extern struct arena parse_tree_arena;
+extern struct arena symbol_arena;
+extern struct arena ir_arena;
+extern struct arena string_arena;
+extern struct arena optimizer_arena;
+
+void *arena_allocate(struct arena *arena, size_t size);
+
+void arena_reset(struct arena *arena);
+
+void arena_release_all(void);
+
+unsigned long arena_total_bytes_allocated(void);
+
+unsigned long arena_total_bytes_reserved(void);
+
+void arena_print_statistics(FILE *output);
+
+#endif /* _ARENA_H */
@@ -7,6 +7,10 @@
 #include "type.h"
 #include "basic_blocks.h"
 #include "ir.h"
+#include "ssa.h"
+#include "arena.h"
+
+unsigned long basic_block_num_created;
 
 void ir_remove_next_instruction(struct ir_instruction *instruction) {
   assert(instruction->next != NULL);
@@ -31,7 +35,7 @@ void remove_no_ops_from_ir(struct ir_section **root_ir) {
   /* Cleaning up the remaining no-ops */
   if(ir_section->first->kind == IR_NO_OPERATION) {
     ir_section->first = ir_section->first->next;
-    ir_section->first->next->prev = NULL;
+    ir_section->first->prev = NULL;
   }
 
   *root_ir = ir_section;
@@ -71,136 +75,1827 @@ void remove_redundant_gotos(struct ir_section **root_ir) {
   *root_ir = ir_section;
 }
 
+/*
+ * The number of branches that jump to each generated label, indexed by the
+ * label offset by the smallest label in the section.
+ */
+struct label_references {
+  int min_label;
+  int num_labels;
+  int *counts;
+};
+
+/* The label operand of a branch, or NULL for any other instruction */
+static struct ir_operand *branch_target(struct ir_instruction *instruction) {
+  struct ir_operand *target;
+
+  switch(instruction->kind) {
+    case IR_GOTO:
+      target = &instruction->operands[0];
+      break;
+    case IR_GOTO_IF_FALSE:
+    case IR_GOTO_IF_TRUE:
+      target = &instruction->operands[1];
+      break;
+    default:
+      return NULL;
+  }
+  return target->kind == OPERAND_GENERATED_LABEL ? target : NULL;
+}
+
+static void label_references_build(struct label_references *references,
+                                   struct ir_section *ir_section) {
+  struct ir_instruction *instruction;
+  struct ir_operand *target;
+  int label, min_label = 0, max_label = -1;
+
+  /* The range of labels defined or branched to */
+  for(instruction = ir_section->first; instruction != NULL; instruction = instruction->next) {
+    if(instruction->kind == IR_GENERATED_LABEL) {
+      label = instruction->operands[0].data.generated_label;
+    } else if((target = branch_target(instruction)) != NULL) {
+      label = target->data.generated_label;
+    } else {
+      continue;
+    }
+    if(max_label < min_label) {
+      min_label = max_label = label;
+    } else if(label < min_label) {
+      min_label = label;
+    } else if(label > max_label) {
+      max_label = label;
+    }
+  }
+
+  references->min_label = min_label;
+  references->num_labels = max_label - min_label + 1;
+  references->counts = calloc(references->num_labels + 1, sizeof(int));
+  assert(references->counts != NULL);
+  for(instruction = ir_section->first; instruction != NULL; instruction = instruction->next) {
+    if((target = branch_target(instruction)) != NULL) {
+      references->counts[target->data.generated_label - min_label]++;
+    }
+  }
+}
+
+static int label_references_count(struct label_references *references, int label) {
+  assert(label >= references->min_label &&
+         label < references->min_label + references->num_labels);
+  return references->counts[label - references->min_label];
+}
+
+/*
+ * A label is redundant when no branch jumps to it. The branches are counted
+ * once up front, so each label is checked in constant time.
+ */
 void remove_redundant_labels(struct ir_section **root_ir) {
   struct ir_section *ir_section = *root_ir;
   struct ir_instruction *instruction = ir_section->first;
-  int generated_label;
-  struct ir_instruction *temp_instruction;
-  bool label_found = false;
+  struct label_references references;
 
+  label_references_build(&references, ir_section);
   while(instruction->next != NULL) {
     if(instruction->kind == IR_GENERATED_LABEL) {
-      label_found = false;
       assert(instruction->operands[0].kind == OPERAND_GENERATED_LABEL);
-      generated_label = instruction->operands[0].data.generated_label;
-      temp_instruction = instruction->next;
-      while(temp_instruction != NULL) {
-	if((temp_instruction->kind == IR_GOTO) &&
-	   (temp_instruction->operands[0].data.generated_label == generated_label)) {
-	  label_found = true;
-	  break;
-	} else if(((temp_instruction->kind == IR_GOTO_IF_FALSE) ||
-		  (temp_instruction->kind == IR_GOTO_IF_TRUE)) &&
-		  (temp_instruction->operands[1].data.generated_label == generated_label)) {
-	  label_found = true;
-	  break;
-	}
-	temp_instruction = temp_instruction->next;
-      }
-
-      if(label_found == false) {
-	temp_instruction = instruction->prev;
-	while(temp_instruction != NULL) {
-	  if((temp_instruction->kind == IR_GOTO) &&
-	     (temp_instruction->operands[0].data.generated_label == generated_label)) {
-	    label_found = true;
-	    break;
-	  } else if(((temp_instruction->kind == IR_GOTO_IF_FALSE) ||
-		     (temp_instruction->kind == IR_GOTO_IF_TRUE)) &&
-		    (temp_instruction->operands[1].data.generated_label == generated_label)) {
-	    label_found = true;
-	    break;
-	  }
-	  temp_instruction = temp_instruction->prev;
-	}
-      }
-
-      if(label_found == false) {
-	ir_remove_next_instruction(instruction->prev);
+      if(label_references_count(&references, instruction->operands[0].data.generated_label) == 0) {
+        ir_remove_next_instruction(instruction->prev);
       }
     }
     instruction = instruction->next;
   }
+  free(references.counts);
 
   *root_ir = ir_section;
 }
 
-struct basic_block* add_to_basic_block(struct ir_instruction *beginning,
-				       struct ir_instruction *end) {
-  struct basic_block *basic_block;
+/*
+ * All of the blocks built from one section live in a single allocation: the
+ * blocks themselves, the ir_section of each block and the predecessor lists,
+ * which together hold at most two edges per block. The allocation comes
+ * from the optimizer arena and lasts until the arena is reset.
+ */
+struct basic_block_pool {
+  struct basic_block *blocks;
+  struct ir_section *sections;
+  struct basic_block **edges;
+  int num_blocks;
+  int num_edges;
+};
+
+static void add_to_basic_block(struct basic_block_pool *pool,
+                               struct ir_instruction *beginning,
+                               struct ir_instruction *end) {
+  struct basic_block *basic_block = &pool->blocks[pool->num_blocks];
 
-  basic_block = malloc(sizeof(struct basic_block *));
-  basic_block->ir_section = ir_section(beginning, end);
+  pool->sections[pool->num_blocks].first = beginning;
+  pool->sections[pool->num_blocks].last = end;
+  basic_block->ir_section = &pool->sections[pool->num_blocks];
   basic_block->beginning = beginning;
-  basic_block->beginning = end;
+  basic_block->end = end;
   basic_block->next = NULL;
   basic_block->left = NULL;
   basic_block->right = NULL;
+  basic_block->predecessors = NULL;
+  basic_block->num_predecessors = 0;
+  basic_block->number = pool->num_blocks;
 
-  return basic_block;
+  if(pool->num_blocks > 0) {
+    pool->blocks[pool->num_blocks - 1].next = basic_block;
+  }
+  pool->num_blocks++;
+}
+
+static bool ends_basic_block(struct ir_instruction *instruction, struct ir_instruction *last) {
+  return (instruction == last) ||
+    (instruction->kind == IR_GOTO) ||
+    (instruction->kind == IR_GOTO_IF_FALSE) ||
+    (instruction->kind == IR_GOTO_IF_TRUE) ||
+    (instruction->kind == IR_FUNCTION_END) ||
+    (instruction->next->kind == IR_GENERATED_LABEL);
+}
+
+/*
+ * Looks up the block a branch jumps to in the label index, which maps a
+ * generated label (offset by the smallest label in the section) to the
+ * block it begins.
+ */
+static struct basic_block *find_basic_block_for_label(struct basic_block **label_index,
+                                                      int min_label, int max_label,
+                                                      struct ir_operand *label) {
+  if(label->kind != OPERAND_GENERATED_LABEL ||
+     label->data.generated_label < min_label || label->data.generated_label > max_label) {
+    return NULL;
+  }
+  return label_index[label->data.generated_label - min_label];
+}
+
+/*
+ * Fills in the successors of every block from the instruction that ends it
+ * and then the predecessors from the successors. Every label starts a block
+ * of its own, so a branch always targets the beginning of a block.
+ */
+static void link_basic_blocks(struct basic_block_pool *pool, struct basic_block **label_index,
+                              int min_label, int max_label) {
+  struct basic_block *basic_block, *successor;
+  struct ir_instruction *end;
+  int i;
+
+  for(i = 0; i < pool->num_blocks; i++) {
+    basic_block = &pool->blocks[i];
+    end = basic_block->end;
+    switch(end->kind) {
+      case IR_GOTO:
+        basic_block->right = find_basic_block_for_label(label_index, min_label, max_label,
+                                                        &end->operands[0]);
+        break;
+      case IR_GOTO_IF_FALSE:
+      case IR_GOTO_IF_TRUE:
+        basic_block->left = basic_block->next;
+        basic_block->right = find_basic_block_for_label(label_index, min_label, max_label,
+                                                        &end->operands[1]);
+        break;
+      case IR_FUNCTION_END:
+        break;
+      default:
+        basic_block->left = basic_block->next;
+        break;
+    }
+    /* A conditional branch to the very next instruction is a single edge */
+    if(basic_block->right == basic_block->left) {
+      basic_block->right = NULL;
+    }
+    if(basic_block->left != NULL) {
+      basic_block->left->num_predecessors++;
+    }
+    if(basic_block->right != NULL) {
+      basic_block->right->num_predecessors++;
+    }
+  }
+
+  /* Hand every block its slice of the edge array */
+  for(i = 0; i < pool->num_blocks; i++) {
+    basic_block = &pool->blocks[i];
+    basic_block->predecessors = &pool->edges[pool->num_edges];
+    pool->num_edges += basic_block->num_predecessors;
+    basic_block->num_predecessors = 0;
+  }
+  assert(pool->num_edges <= 2 * pool->num_blocks);
+
+  for(i = 0; i < pool->num_blocks; i++) {
+    basic_block = &pool->blocks[i];
+    successor = basic_block->left;
+    if(successor != NULL) {
+      successor->predecessors[successor->num_predecessors++] = basic_block;
+    }
+    successor = basic_block->right;
+    if(successor != NULL) {
+      successor->predecessors[successor->num_predecessors++] = basic_block;
+    }
+  }
 }
 
+/*
+ * Splits the section into basic blocks in a single pass and links them into
+ * a control flow graph. A block ends at a branch, at the end of a function or
+ * right before a label.
+ */
 struct basic_block * get_basic_blocks_from_ir(struct ir_section *root_ir) {
-  struct ir_instruction *instruction = root_ir->first;
+  struct ir_instruction *instruction;
+  struct ir_instruction *beginning_of_basic_block;
+  struct basic_block_pool pool;
+  struct basic_block **label_index;
+  int num_blocks = 0;
+  int min_label = 0, max_label = -1;
+  int label;
+  char *memory;
 
-  struct ir_instruction *beginning_of_basic_block = root_ir->first;
+  for(instruction = root_ir->first; ; instruction = instruction->next) {
+    if(instruction->kind == IR_GENERATED_LABEL) {
+      label = instruction->operands[0].data.generated_label;
+      if(max_label < min_label) {
+        min_label = max_label = label;
+      } else if(label < min_label) {
+        min_label = label;
+      } else if(label > max_label) {
+        max_label = label;
+      }
+    }
+    if(ends_basic_block(instruction, root_ir->last)) {
+      num_blocks++;
+      if(instruction == root_ir->last) {
+        break;
+      }
+    }
+  }
+
+  memory = arena_allocate(&optimizer_arena,
+                          num_blocks * (sizeof(struct basic_block) + sizeof(struct ir_section) +
+                                        2 * sizeof(struct basic_block *)));
+  label_index = arena_allocate(&optimizer_arena,
+                               sizeof(struct basic_block *) * (max_label - min_label + 2));
+  pool.blocks = (struct basic_block *)memory;
+  pool.sections = (struct ir_section *)(memory + num_blocks * sizeof(struct basic_block));
+  pool.edges = (struct basic_block **)(memory + num_blocks * (sizeof(struct basic_block) +
+                                                             sizeof(struct ir_section)));
+  pool.num_blocks = 0;
+  pool.num_edges = 0;
 
-  struct ir_instruction *end_of_basic_block = NULL;
+  beginning_of_basic_block = root_ir->first;
+  for(instruction = root_ir->first; ; instruction = instruction->next) {
+    if(ends_basic_block(instruction, root_ir->last)) {
+      if(beginning_of_basic_block->kind == IR_GENERATED_LABEL) {
+        label = beginning_of_basic_block->operands[0].data.generated_label;
+        label_index[label - min_label] = &pool.blocks[pool.num_blocks];
+      }
+      add_to_basic_block(&pool, beginning_of_basic_block, instruction);
+      if(instruction == root_ir->last) {
+        break;
+      }
+      beginning_of_basic_block = instruction->next;
+    }
+  }
+  assert(pool.num_blocks == num_blocks);
+  basic_block_num_created += num_blocks;
 
-  struct basic_block *root_basic_block = NULL, *basic_block = NULL;
-  bool basic_block_found = false;
-  int instruction_number = 0;
+  link_basic_blocks(&pool, label_index, min_label, max_label);
+  return pool.blocks;
+}
 
-  while(instruction->next != NULL) {
-    if((instruction->kind == IR_GOTO) ||
-       (instruction->kind == IR_GOTO_IF_FALSE) ||
-       (instruction->kind == IR_GOTO_IF_TRUE) ||
-       (instruction->kind == IR_FUNCTION_END) ||
-       (instruction->next->kind == IR_GENERATED_LABEL)) {
-      end_of_basic_block = instruction;
-      basic_block_found = true;
-    }
-
-    if(basic_block_found) {
-      if(root_basic_block == NULL) {
-	root_basic_block = add_to_basic_block(beginning_of_basic_block,
-					      end_of_basic_block);
+/*******************************
+ * CONTROL FLOW GRAPH          *
+ *******************************/
+
+static void cfg_depth_first_search(struct control_flow_graph *cfg, struct basic_block *basic_block,
+                                   bool *visited, int *num_finished) {
+  struct basic_block **stack;
+  int *next_successor;
+  int top = 0;
+  struct basic_block *successor;
+
+  /* Explicit stack; a recursive walk can overflow on long chains of blocks */
+  stack = arena_allocate(&optimizer_arena, sizeof(struct basic_block *) * (cfg->num_blocks + 1));
+  next_successor = arena_allocate(&optimizer_arena, sizeof(int) * (cfg->num_blocks + 1));
+
+  visited[basic_block->number] = true;
+  stack[top] = basic_block;
+  next_successor[top] = 0;
+  while(top >= 0) {
+    basic_block = stack[top];
+    successor = NULL;
+    if(next_successor[top] == 0) {
+      next_successor[top]++;
+      successor = basic_block->left;
+    }
+    if(successor == NULL && next_successor[top] == 1) {
+      next_successor[top]++;
+      successor = basic_block->right;
+    }
+
+    if(successor == NULL && next_successor[top] == 2) {
+      /* All successors done, the block is finished */
+      (*num_finished)++;
+      cfg->reverse_postorder[cfg->num_blocks - *num_finished] = basic_block;
+      top--;
+    } else if(successor != NULL && !visited[successor->number]) {
+      visited[successor->number] = true;
+      top++;
+      stack[top] = successor;
+      next_successor[top] = 0;
+    }
+  }
+}
+
+/*
+ * Builds the control flow graph of the function starting at the given
+ * IR_FUNCTION_BEGIN instruction.
+ */
+struct control_flow_graph *cfg_build_for_function(struct ir_instruction *function_begin) {
+  struct control_flow_graph *cfg;
+  struct basic_block *basic_block;
+  struct ir_instruction *function_end;
+  struct ir_section section;
+  bool *visited;
+  int num_finished = 0;
+  int i;
+
+  assert(IR_FUNCTION_BEGIN == function_begin->kind);
+  for(function_end = function_begin; function_end->kind != IR_FUNCTION_END;
+      function_end = function_end->next) {
+    assert(function_end->next != NULL);
+  }
+
+  cfg = arena_allocate(&optimizer_arena, sizeof(struct control_flow_graph));
+  cfg->function_begin = function_begin;
+  cfg->function_end = function_end;
+  section.first = function_begin;
+  section.last = function_end;
+  cfg->entry = get_basic_blocks_from_ir(&section);
+
+  cfg->num_blocks = 0;
+  for(basic_block = cfg->entry; basic_block != NULL; basic_block = basic_block->next) {
+    cfg->num_blocks++;
+  }
+  cfg->blocks = arena_allocate(&optimizer_arena, sizeof(struct basic_block *) * cfg->num_blocks);
+  cfg->reverse_postorder = arena_allocate(&optimizer_arena,
+                                          sizeof(struct basic_block *) * cfg->num_blocks);
+  visited = arena_allocate(&optimizer_arena, sizeof(bool) * cfg->num_blocks);
+  for(basic_block = cfg->entry, i = 0; basic_block != NULL; basic_block = basic_block->next, i++) {
+    cfg->blocks[i] = basic_block;
+  }
+
+  /* The postorder is written from the back of the array, so the reachable
+   * blocks end up at its tail; move them to the front. */
+  cfg_depth_first_search(cfg, cfg->entry, visited, &num_finished);
+  cfg->num_reachable_blocks = num_finished;
+  memmove(cfg->reverse_postorder, cfg->reverse_postorder + cfg->num_blocks - num_finished,
+          sizeof(struct basic_block *) * num_finished);
+
+  return cfg;
+}
+
+/*******************************
+ * CONSTANT PROPAGATION        *
+ *******************************/
+
+/*
+ * Constants are folded with the same 32 bit semantics as the instructions
+ * that the MIPS backend selects for each opcode, so folding never changes
+ * what the program computes: multu/divu make multiplication, division and
+ * remainder unsigned, the comparisons are signed and sra makes the right
+ * shift arithmetic. A division by zero is left for the program to trap on.
+ */
+static bool fold_binary_operation(int kind, unsigned int left, unsigned int right,
+                                  unsigned int *result) {
+  switch(kind) {
+    case IR_ADD:
+      *result = left + right;
+      return true;
+    case IR_SUBTRACT:
+      *result = left - right;
+      return true;
+    case IR_MULTIPLY:
+      *result = left * right;
+      return true;
+    case IR_DIVIDE:
+      if(right == 0) {
+        return false;
+      }
+      *result = left / right;
+      return true;
+    case IR_REMAINDER:
+      if(right == 0) {
+        return false;
+      }
+      *result = left % right;
+      return true;
+    case IR_LESS_THAN:
+      *result = (int)left < (int)right;
+      return true;
+    case IR_LESS_THAN_OR_EQ_TO:
+      *result = (int)left <= (int)right;
+      return true;
+    case IR_GREATER_THAN:
+      *result = (int)left > (int)right;
+      return true;
+    case IR_GREATER_THAN_OR_EQ_TO:
+      *result = (int)left >= (int)right;
+      return true;
+    case IR_EQUAL_TO:
+      *result = left == right;
+      return true;
+    case IR_NOT_EQUAL_TO:
+      *result = left != right;
+      return true;
+    case IR_SHIFT_LEFT:
+      /* sllv and srav only look at the low five bits of the shift amount */
+      *result = left << (right & 31);
+      return true;
+    case IR_SHIFT_RIGHT:
+      if((left & 0x80000000u) && (right & 31)) {
+        *result = (left >> (right & 31)) | ~(0xffffffffu >> (right & 31));
       } else {
-	basic_block = root_basic_block;
-	while(basic_block->next != NULL) {
-	basic_block = basic_block->next;
-	}
-	basic_block->next = add_to_basic_block(beginning_of_basic_block,
-					       end_of_basic_block);
+        *result = left >> (right & 31);
+      }
+      return true;
+    case IR_SHIFT_RIGHT_LOGICAL:
+      *result = left >> (right & 31);
+      return true;
+    case IR_MULTIPLY_HIGH:
+      *result = (unsigned int)(((unsigned long long)left * right) >> 32);
+      return true;
+    case IR_BITWISE_OR:
+      *result = left | right;
+      return true;
+    case IR_BITWISE_XOR:
+      *result = left ^ right;
+      return true;
+    case IR_BITWISE_AND:
+      *result = left & right;
+      return true;
+    default:
+      return false;
+  }
+}
+
+static unsigned int sign_extend(unsigned int value, unsigned int bits) {
+  unsigned int sign_bit = 1u << (bits - 1);
+  value &= (sign_bit << 1) - 1;
+  return (value ^ sign_bit) - sign_bit;
+}
+
+/*
+ * A cast keeps as many bits as the narrower of its two widths and then
+ * zero or sign extends them to a full word, depending on the signedness
+ * of the target type.
+ */
+static bool fold_unary_operation(int kind, unsigned int value, unsigned int *result) {
+  switch(kind) {
+    case IR_BITWISE_NOT:
+      *result = ~value;
+      return true;
+    case IR_LOGICAL_NOT:
+      *result = value == 0;
+      return true;
+    case IR_NEGATION:
+      *result = -value;
+      return true;
+    case IR_CAST_TO_U_WORD:
+    case IR_CAST_TO_S_WORD:
+      *result = value;
+      return true;
+    case IR_CAST_TO_U_HALFWORD:
+    case IR_CAST_WORD_TO_U_HWORD:
+    case IR_CAST_HWORD_TO_U_WORD:
+      *result = value & 0xffff;
+      return true;
+    case IR_CAST_TO_S_HALFWORD:
+    case IR_CAST_WORD_TO_S_HWORD:
+    case IR_CAST_HWORD_TO_S_WORD:
+      *result = sign_extend(value, 16);
+      return true;
+    case IR_CAST_TO_U_BYTE:
+    case IR_CAST_WORD_TO_U_BYTE:
+    case IR_CAST_HWORD_TO_U_BYTE:
+    case IR_CAST_BYTE_TO_U_WORD:
+    case IR_CAST_BYTE_TO_U_HWORD:
+      *result = value & 0xff;
+      return true;
+    case IR_CAST_TO_S_BYTE:
+    case IR_CAST_WORD_TO_S_BYTE:
+    case IR_CAST_HWORD_TO_S_BYTE:
+    case IR_CAST_BYTE_TO_S_WORD:
+    case IR_CAST_BYTE_TO_S_HWORD:
+      *result = sign_extend(value, 8);
+      return true;
+    default:
+      return false;
+  }
+}
+
+static void ir_rewrite_as_load_immediate(struct ir_instruction *instruction,
+                                         unsigned int value) {
+  instruction->kind = IR_LOAD_IMMEDIATE;
+  instruction->operands[1].kind = OPERAND_NUMBER;
+  instruction->operands[1].lvalue = false;
+  instruction->operands[1].data.number = value;
+  instruction->operands[2].kind = OPERAND_NULL;
+}
+
+/*
+ * The constants known at some point of a basic block. A temporary is known
+ * only while its stamp matches the current block, so moving on to the next
+ * block forgets everything without touching the table.
+ */
+struct constant_table {
+  int *block_stamps;
+  unsigned int *values;
+  int current_block;
+};
+
+static bool constant_lookup(struct constant_table *table, struct ir_operand *operand,
+                            unsigned int *value) {
+  if(operand->kind != OPERAND_TEMPORARY ||
+     table->block_stamps[operand->data.temporary] != table->current_block) {
+    return false;
+  }
+  *value = table->values[operand->data.temporary];
+  return true;
+}
+
+static void constant_record(struct constant_table *table, int temporary,
+                            unsigned int value) {
+  table->block_stamps[temporary] = table->current_block;
+  table->values[temporary] = value;
+}
+
+static void constant_forget(struct constant_table *table, int temporary) {
+  table->block_stamps[temporary] = -1;
+}
+
+static void propagate_constants_in_instruction(struct constant_table *table,
+                                               struct ir_instruction *instruction) {
+  unsigned int left, right, result;
+  int destination;
+
+  if(!ir_is_destination_operand(instruction, 0)) {
+    return;
+  }
+  destination = instruction->operands[0].data.temporary;
+
+  switch(instruction->kind) {
+    case IR_LOAD_IMMEDIATE:
+      constant_record(table, destination, (unsigned int)instruction->operands[1].data.number);
+      return;
+
+    case IR_COPY:
+      if(constant_lookup(table, &instruction->operands[1], &left)) {
+        ir_rewrite_as_load_immediate(instruction, left);
+        constant_record(table, destination, left);
+        return;
+      }
+      break;
+
+    default:
+      if(constant_lookup(table, &instruction->operands[1], &left)) {
+        if(constant_lookup(table, &instruction->operands[2], &right) &&
+           fold_binary_operation(instruction->kind, left, right, &result)) {
+          ir_rewrite_as_load_immediate(instruction, result);
+          constant_record(table, destination, result);
+          return;
+        }
+        if(fold_unary_operation(instruction->kind, left, &result)) {
+          ir_rewrite_as_load_immediate(instruction, result);
+          constant_record(table, destination, result);
+          return;
+        }
+      }
+      break;
+  }
+
+  constant_forget(table, destination);
+}
+
+/*
+ * Once the instructions that read a load immediate have been folded, the
+ * load itself is usually dead.
+ */
+static void remove_unused_load_immediates(struct control_flow_graph *cfg, int num_temporaries) {
+  struct ir_instruction *instruction, *next;
+  int *use_counts;
+  int i;
+
+  use_counts = arena_allocate(&optimizer_arena, sizeof(int) * (num_temporaries + 1));
+  for(instruction = cfg->function_begin; instruction != cfg->function_end;
+      instruction = instruction->next) {
+    for(i = 0; i < 3; i++) {
+      if(instruction->operands[i].kind == OPERAND_TEMPORARY &&
+         !ir_is_destination_operand(instruction, i)) {
+        use_counts[instruction->operands[i].data.temporary]++;
       }
-      beginning_of_basic_block = end_of_basic_block->next;
-      end_of_basic_block = NULL;
-      basic_block_found = false;
     }
-    instruction = instruction->next;
-    instruction_number++;
   }
 
-  /* The last basic block */
-    if(root_basic_block == NULL) {
-      root_basic_block = add_to_basic_block(beginning_of_basic_block,
-					    end_of_basic_block);
-    } else {
-      basic_block = root_basic_block;
-      while(basic_block->next != NULL) {
-	basic_block = basic_block->next;
+  for(instruction = cfg->function_begin->next; instruction != cfg->function_end; instruction = next) {
+    next = instruction->next;
+    if(instruction->kind == IR_LOAD_IMMEDIATE &&
+       use_counts[instruction->operands[0].data.temporary] == 0) {
+      ir_remove_next_instruction(instruction->prev);
+    }
+  }
+}
+
+static int count_temporaries(struct control_flow_graph *cfg) {
+  struct ir_instruction *instruction;
+  int num_temporaries = 0;
+  int i;
+
+  for(instruction = cfg->function_begin; instruction != cfg->function_end;
+      instruction = instruction->next) {
+    for(i = 0; i < 3; i++) {
+      if(instruction->operands[i].kind == OPERAND_TEMPORARY &&
+         instruction->operands[i].data.temporary >= num_temporaries) {
+        num_temporaries = instruction->operands[i].data.temporary + 1;
       }
-      basic_block->next = add_to_basic_block(beginning_of_basic_block,
-					     end_of_basic_block);
     }
-    return root_basic_block;
+  }
+  return num_temporaries;
 }
 
 void propagate_constant_values(struct ir_section **root_ir) {
+  struct control_flow_graph *cfg;
+  struct basic_block *basic_block;
+  struct ir_instruction *instruction, *function_begin;
+  struct constant_table table;
+  int num_temporaries;
+  int i;
+
+  function_begin = (*root_ir)->first;
+  while(function_begin != NULL) {
+    if(function_begin->kind != IR_FUNCTION_BEGIN) {
+      function_begin = function_begin->next;
+      continue;
+    }
+
+    cfg = cfg_build_for_function(function_begin);
+    num_temporaries = count_temporaries(cfg);
+    table.block_stamps = arena_allocate(&optimizer_arena, sizeof(int) * (num_temporaries + 1));
+    table.values = arena_allocate(&optimizer_arena, sizeof(unsigned int) * (num_temporaries + 1));
+    for(i = 0; i < num_temporaries; i++) {
+      table.block_stamps[i] = -1;
+    }
+    table.current_block = 0;
+
+    for(basic_block = cfg->entry; basic_block != NULL; basic_block = basic_block->next) {
+      for(instruction = basic_block->beginning; ; instruction = instruction->next) {
+        propagate_constants_in_instruction(&table, instruction);
+        if(instruction == basic_block->end) {
+          break;
+        }
+      }
+      table.current_block++;
+    }
+    remove_unused_load_immediates(cfg, num_temporaries);
+
+    function_begin = cfg->function_end->next;
+    arena_reset(&optimizer_arena);
+  }
+}
+
+/*******************************
+ * STRENGTH REDUCTION          *
+ *******************************/
+
+/*
+ * Multiplications, divisions and remainders by a constant are rewritten as
+ * shifts, masks and multiplications by a reciprocal, and an operation whose
+ * constant operand leaves the other one unchanged becomes a copy. As in
+ * constant propagation, a constant is only known in the block that loads it.
+ *
+ * Division and remainder are unsigned, since the backend selects divu for
+ * them, so dividing by 2^k is a logical shift right by k and needs none of
+ * the rounding corrections of a signed division. Every other divisor d is
+ * replaced by the high word of a multiplication by a 32 bit approximation
+ * of 2^(32 + s) / d, the method of Granlund and Montgomery.
+ */
+
+static void ir_insert_instruction_before(struct ir_instruction *instruction,
+                                         struct ir_instruction *inserted) {
+  assert(instruction->prev != NULL);
+
+  inserted->prev = instruction->prev;
+  inserted->next = instruction;
+  instruction->prev->next = inserted;
+  instruction->prev = inserted;
+}
+
+static void ir_set_temporary_operand(struct ir_instruction *instruction, int position,
+                                     int temporary) {
+  instruction->operands[position].kind = OPERAND_TEMPORARY;
+  instruction->operands[position].lvalue = false;
+  instruction->operands[position].data.temporary = temporary;
+}
+
+static void ir_rewrite_as_copy(struct ir_instruction *instruction, int source) {
+  instruction->kind = IR_COPY;
+  ir_set_temporary_operand(instruction, 1, source);
+  instruction->operands[2].kind = OPERAND_NULL;
+}
+
+static void ir_rewrite_as_binary_operation(struct ir_instruction *instruction, int kind,
+                                           int left, int right) {
+  instruction->kind = kind;
+  ir_set_temporary_operand(instruction, 1, left);
+  ir_set_temporary_operand(instruction, 2, right);
+}
+
+/* The instructions a reduction adds write temporaries no one has used yet */
+static int insert_load_immediate(struct ir_instruction *instruction, int *next_temporary,
+                                 unsigned int value) {
+  struct ir_instruction *load_immediate;
+
+  load_immediate = ir_instruction(IR_LOAD_IMMEDIATE);
+  ir_set_temporary_operand(load_immediate, 0, (*next_temporary)++);
+  ir_rewrite_as_load_immediate(load_immediate, value);
+  ir_insert_instruction_before(instruction, load_immediate);
+  return load_immediate->operands[0].data.temporary;
+}
+
+static int insert_binary_operation(struct ir_instruction *instruction, int *next_temporary,
+                                   int kind, int left, int right) {
+  struct ir_instruction *operation;
+
+  operation = ir_instruction(kind);
+  ir_set_temporary_operand(operation, 0, (*next_temporary)++);
+  ir_rewrite_as_binary_operation(operation, kind, left, right);
+  ir_insert_instruction_before(instruction, operation);
+  return operation->operands[0].data.temporary;
+}
+
+/* Returns k when value is 2^k and -1 otherwise */
+static int power_of_two_exponent(unsigned int value) {
+  int exponent;
+
+  if(value == 0 || (value & (value - 1)) != 0) {
+    return -1;
+  }
+  for(exponent = 0; value != 1; exponent++) {
+    value >>= 1;
+  }
+  return exponent;
+}
+
+/*
+ * Adds, before instruction, the instructions that divide dividend by a
+ * constant divisor that is neither 0 nor a power of two, all but the final
+ * logical shift right of high by shift that leaves the quotient.
+ *
+ * With s = floor(log2(d)), the magic number m = floor(2^(32 + s) / d) + 1 is
+ * exact enough when the rounding error it makes is below 2^s, and then the
+ * quotient is (m * n) >> (32 + s). Otherwise m needs a 33rd bit; its low 32
+ * bits are used and the missing n is added back in a way that cannot
+ * overflow: with h = (m * n) >> 32 the quotient is (((n - h) >> 1) + h) >> s.
+ */
+static void reduce_division_by_constant(struct ir_instruction *instruction, int *next_temporary,
+                                        int dividend, unsigned int divisor,
+                                        int *high, int *shift) {
+  unsigned long long power;
+  unsigned int magic, remainder;
+  int exponent, difference, half;
+
+  for(exponent = 31; (divisor >> exponent) == 0; exponent--) {
+    continue;
+  }
+  power = 1ULL << (32 + exponent);
+  magic = (unsigned int)(power / divisor);
+  remainder = (unsigned int)(power % divisor);
+
+  if(divisor - remainder < (1u << exponent)) {
+    *high = insert_binary_operation(instruction, next_temporary, IR_MULTIPLY_HIGH, dividend,
+                                    insert_load_immediate(instruction, next_temporary,
+                                                          magic + 1));
+  } else {
+    /* The low 32 bits of 2^(33 + s) / d, rounded up */
+    magic = 2 * magic + (2 * (unsigned long long)remainder >= divisor) + 1;
+    *high = insert_binary_operation(instruction, next_temporary, IR_MULTIPLY_HIGH, dividend,
+                                    insert_load_immediate(instruction, next_temporary, magic));
+    difference = insert_binary_operation(instruction, next_temporary, IR_SUBTRACT,
+                                         dividend, *high);
+    half = insert_binary_operation(instruction, next_temporary, IR_SHIFT_RIGHT_LOGICAL,
+                                   difference,
+                                   insert_load_immediate(instruction, next_temporary, 1));
+    *high = insert_binary_operation(instruction, next_temporary, IR_ADD, half, *high);
+  }
+  *shift = insert_load_immediate(instruction, next_temporary, exponent);
+}
+
+static bool is_commutative(int kind) {
+  switch(kind) {
+    case IR_ADD:
+    case IR_MULTIPLY:
+    case IR_BITWISE_OR:
+    case IR_BITWISE_XOR:
+    case IR_BITWISE_AND:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/*
+ * Rewrites an operation whose second operand is the constant value. Returns
+ * true and sets result when the operation now loads a constant.
+ */
+static bool reduce_operation_with_constant(struct ir_instruction *instruction,
+                                           int *next_temporary, unsigned int value,
+                                           unsigned int *result) {
+  int left, exponent, high, shift, quotient, product;
+
+  left = instruction->operands[1].data.temporary;
+  exponent = power_of_two_exponent(value);
+
+  switch(instruction->kind) {
+    case IR_ADD:
+    case IR_SUBTRACT:
+    case IR_BITWISE_OR:
+    case IR_BITWISE_XOR:
+      if(value == 0) {
+        ir_rewrite_as_copy(instruction, left);
+      }
+      return false;
+
+    case IR_SHIFT_LEFT:
+    case IR_SHIFT_RIGHT:
+    case IR_SHIFT_RIGHT_LOGICAL:
+      /* The shift instructions only look at the low five bits */
+      if((value & 31) == 0) {
+        ir_rewrite_as_copy(instruction, left);
+      }
+      return false;
+
+    case IR_BITWISE_AND:
+      if(value == 0) {
+        *result = 0;
+        ir_rewrite_as_load_immediate(instruction, *result);
+        return true;
+      }
+      if(value == 0xffffffffu) {
+        ir_rewrite_as_copy(instruction, left);
+      }
+      return false;
+
+    case IR_MULTIPLY:
+      if(value == 0) {
+        *result = 0;
+        ir_rewrite_as_load_immediate(instruction, *result);
+        return true;
+      }
+      if(value == 1) {
+        ir_rewrite_as_copy(instruction, left);
+      } else if(exponent > 0) {
+        ir_rewrite_as_binary_operation(instruction, IR_SHIFT_LEFT, left,
+                                       insert_load_immediate(instruction, next_temporary,
+                                                             exponent));
+      }
+      return false;
+
+    case IR_DIVIDE:
+      /* A division by zero is left for the program to trap on */
+      if(value == 1) {
+        ir_rewrite_as_copy(instruction, left);
+      } else if(exponent > 0) {
+        ir_rewrite_as_binary_operation(instruction, IR_SHIFT_RIGHT_LOGICAL, left,
+                                       insert_load_immediate(instruction, next_temporary,
+                                                             exponent));
+      } else if(value != 0) {
+        reduce_division_by_constant(instruction, next_temporary, left, value, &high, &shift);
+        ir_rewrite_as_binary_operation(instruction, IR_SHIFT_RIGHT_LOGICAL, high, shift);
+      }
+      return false;
+
+    case IR_REMAINDER:
+      if(value == 1) {
+        *result = 0;
+        ir_rewrite_as_load_immediate(instruction, *result);
+        return true;
+      }
+      if(exponent > 0) {
+        ir_rewrite_as_binary_operation(instruction, IR_BITWISE_AND, left,
+                                       insert_load_immediate(instruction, next_temporary,
+                                                             value - 1));
+      } else if(value != 0) {
+        /* n % d = n - (n / d) * d, where d is still in the second operand */
+        reduce_division_by_constant(instruction, next_temporary, left, value, &high, &shift);
+        quotient = insert_binary_operation(instruction, next_temporary, IR_SHIFT_RIGHT_LOGICAL,
+                                           high, shift);
+        product = insert_binary_operation(instruction, next_temporary, IR_MULTIPLY, quotient,
+                                          instruction->operands[2].data.temporary);
+        ir_rewrite_as_binary_operation(instruction, IR_SUBTRACT, left, product);
+      }
+      return false;
+
+    default:
+      return false;
+  }
+}
+
+static void reduce_strength_in_instruction(struct constant_table *table,
+                                           struct ir_instruction *instruction,
+                                           int *next_temporary) {
+  struct ir_operand swapped;
+  unsigned int left, right, result;
+  int destination;
+
+  if(!ir_is_destination_operand(instruction, 0)) {
+    return;
+  }
+  destination = instruction->operands[0].data.temporary;
+
+  if(instruction->kind == IR_LOAD_IMMEDIATE) {
+    constant_record(table, destination, (unsigned int)instruction->operands[1].data.number);
+    return;
+  }
+
+  if(is_commutative(instruction->kind) &&
+     constant_lookup(table, &instruction->operands[1], &left) &&
+     !constant_lookup(table, &instruction->operands[2], &right)) {
+    swapped = instruction->operands[1];
+    instruction->operands[1] = instruction->operands[2];
+    instruction->operands[2] = swapped;
+  }
+
+  /* Operations on two constants are left to constant propagation */
+  if(instruction->operands[1].kind == OPERAND_TEMPORARY &&
+     !constant_lookup(table, &instruction->operands[1], &left) &&
+     constant_lookup(table, &instruction->operands[2], &right) &&
+     reduce_operation_with_constant(instruction, next_temporary, right, &result)) {
+    constant_record(table, destination, result);
+    return;
+  }
+
+  constant_forget(table, destination);
+}
+
+void reduce_strength_of_operations(struct ir_section **root_ir) {
+  struct control_flow_graph *cfg;
   struct basic_block *basic_block;
+  struct ir_instruction *instruction, *function_begin;
+  struct constant_table table;
+  int num_temporaries, next_temporary;
+  int i;
 
-  basic_block = get_basic_blocks_from_ir(*root_ir);
+  function_begin = (*root_ir)->first;
+  while(function_begin != NULL) {
+    if(function_begin->kind != IR_FUNCTION_BEGIN) {
+      function_begin = function_begin->next;
+      continue;
+    }
 
+    cfg = cfg_build_for_function(function_begin);
+    num_temporaries = count_temporaries(cfg);
+    table.block_stamps = arena_allocate(&optimizer_arena, sizeof(int) * (num_temporaries + 1));
+    table.values = arena_allocate(&optimizer_arena, sizeof(unsigned int) * (num_temporaries + 1));
+    for(i = 0; i < num_temporaries; i++) {
+      table.block_stamps[i] = -1;
+    }
+    table.current_block = 0;
+
+    /* The added instructions go before the one being reduced, so the walk
+     * never sees them and the table never needs their temporaries. */
+    next_temporary = num_temporaries;
+    for(basic_block = cfg->entry; basic_block != NULL; basic_block = basic_block->next) {
+      for(instruction = basic_block->beginning; ; instruction = instruction->next) {
+        reduce_strength_in_instruction(&table, instruction, &next_temporary);
+        if(instruction == basic_block->end) {
+          break;
+        }
+      }
+      table.current_block++;
+    }
+    remove_unused_load_immediates(cfg, next_temporary);
+
+    function_begin = cfg->function_end->next;
+    arena_reset(&optimizer_arena);
+  }
+}
 
+/*******************************
+ * PROMOTION OF LOCALS         *
+ *******************************/
+
+/*
+ * A local or parameter lives in a stack slot, and every access to it goes
+ * through IR_ADDRESS_OF followed by a load or store of the address. When the
+ * address of a scalar word never goes anywhere else, no pointer can reach the
+ * slot, so the variable is given a temporary of its own: its loads become
+ * copies from that temporary, its stores copies into it, and the address
+ * computations disappear. A parameter arrives in its slot, so it is loaded
+ * into its temporary once on entry to the function.
+ *
+ * The temporary is written wherever the variable was stored to, so it has
+ * several definitions; nothing downstream relies on a temporary having only
+ * one.
+ */
+
+struct promoted_variable {
+  struct symbol *symbol;
+  bool is_promotable;
+  int temporary;
+};
+
+/* Open addressing hash from symbols to the variables of one function */
+struct variable_table {
+  struct promoted_variable *variables;
+  int num_slots;
+};
+
+static int variable_table_find(struct variable_table *table, struct symbol *symbol) {
+  int slot;
+
+  slot = (int)((((unsigned long)symbol >> 4) * 2654435761u) & (table->num_slots - 1));
+  while(table->variables[slot].symbol != NULL && table->variables[slot].symbol != symbol) {
+    slot = (slot + 1) & (table->num_slots - 1);
+  }
+  return slot;
+}
+
+static bool is_promotable_symbol(struct symbol *symbol) {
+  struct type *type = symbol->result.type;
+
+  if(symbol->owner_symbol_table->type_of_symbol_table == FILE_SCOPE_SYMBOL_TABLE) {
+    return false;
+  }
+  return type->kind == TYPE_POINTER ||
+         (type->kind == TYPE_BASIC && type->data.basic.width == TYPE_WIDTH_INT);
+}
+
+/*
+ * The only uses an address may have if its variable is to be promoted are
+ * as the address of a word load or store.
+ */
+static bool is_promotable_use(struct ir_instruction *instruction, int position) {
+  return (instruction->kind == IR_LOAD_WORD && position == 1) ||
+         (instruction->kind == IR_STORE_WORD && position == 0);
+}
+
+static void find_promotable_variables(struct control_flow_graph *cfg, struct variable_table *table,
+                                      int *address_variables, int num_temporaries) {
+  struct ir_instruction *instruction;
+  int *num_definitions;
+  int i, slot, temporary;
+
+  num_definitions = arena_allocate(&optimizer_arena, sizeof(int) * (num_temporaries + 1));
+  for(i = 0; i < num_temporaries; i++) {
+    address_variables[i] = -1;
+  }
+
+  for(instruction = cfg->function_begin; instruction != cfg->function_end;
+      instruction = instruction->next) {
+    for(i = 0; i < 3; i++) {
+      if(ir_is_destination_operand(instruction, i)) {
+        num_definitions[instruction->operands[i].data.temporary]++;
+      }
+    }
+    if(instruction->kind == IR_ADDRESS_OF &&
+       instruction->operands[1].kind == OPERAND_IDENTIFIER &&
+       instruction->operands[1].data.symbol->owner_symbol_table->type_of_symbol_table !=
+         FILE_SCOPE_SYMBOL_TABLE) {
+      slot = variable_table_find(table, instruction->operands[1].data.symbol);
+      if(table->variables[slot].symbol == NULL) {
+        table->variables[slot].symbol = instruction->operands[1].data.symbol;
+        table->variables[slot].is_promotable = is_promotable_symbol(table->variables[slot].symbol);
+        table->variables[slot].temporary = -1;
+      }
+      address_variables[instruction->operands[0].data.temporary] = slot;
+    }
+  }
+
+  for(instruction = cfg->function_begin; instruction != cfg->function_end;
+      instruction = instruction->next) {
+    for(i = 0; i < 3; i++) {
+      if(instruction->operands[i].kind != OPERAND_TEMPORARY) {
+        continue;
+      }
+      temporary = instruction->operands[i].data.temporary;
+      slot = address_variables[temporary];
+      if(slot < 0) {
+        continue;
+      }
+      if(num_definitions[temporary] != 1 ||
+         (!ir_is_destination_operand(instruction, i) && !is_promotable_use(instruction, i))) {
+        table->variables[slot].is_promotable = false;
+      }
+    }
+  }
+}
+
+/*
+ * Hands out the temporaries in the order the variables first occur, which
+ * keeps the output the same from one run to the next.
+ */
+static void assign_variable_temporaries(struct control_flow_graph *cfg, struct variable_table *table,
+                                        int *address_variables, int *next_temporary) {
+  struct ir_instruction *instruction, *entry, *address, *load;
+  struct promoted_variable *variable;
+  int slot;
+
+  entry = cfg->function_begin->next;
+  for(instruction = cfg->function_begin; instruction != cfg->function_end;
+      instruction = instruction->next) {
+    if(instruction->kind != IR_ADDRESS_OF || instruction->operands[0].kind != OPERAND_TEMPORARY) {
+      continue;
+    }
+    slot = address_variables[instruction->operands[0].data.temporary];
+    if(slot < 0 || !table->variables[slot].is_promotable ||
+       table->variables[slot].temporary != -1) {
+      continue;
+    }
+    variable = &table->variables[slot];
+    variable->temporary = (*next_temporary)++;
+
+    /* Parameters live at negative offsets */
+    if(variable->symbol->stack_offset < 0) {
+      address = ir_instruction(IR_ADDRESS_OF);
+      ir_set_temporary_operand(address, 0, (*next_temporary)++);
+      address->operands[1] = instruction->operands[1];
+      ir_insert_instruction_before(entry, address);
+      load = ir_instruction(IR_LOAD_WORD);
+      ir_set_temporary_operand(load, 0, variable->temporary);
+      ir_set_temporary_operand(load, 1, address->operands[0].data.temporary);
+      ir_insert_instruction_before(entry, load);
+    }
+  }
+}
+
+static void promote_variables_in_function(struct control_flow_graph *cfg,
+                                          struct variable_table *table,
+                                          int *address_variables, int num_temporaries) {
+  struct ir_instruction *instruction, *next;
+  struct promoted_variable *variable;
+  int slot;
+
+  for(instruction = cfg->function_begin->next; instruction != cfg->function_end;
+      instruction = next) {
+    next = instruction->next;
+    if(instruction->kind != IR_ADDRESS_OF && instruction->kind != IR_LOAD_WORD &&
+       instruction->kind != IR_STORE_WORD) {
+      continue;
+    }
+    /* The loads of the parameters on entry use temporaries of their own */
+    slot = -1;
+    if(instruction->kind == IR_LOAD_WORD) {
+      if(instruction->operands[1].kind == OPERAND_TEMPORARY &&
+         instruction->operands[1].data.temporary < num_temporaries) {
+        slot = address_variables[instruction->operands[1].data.temporary];
+      }
+    } else if(instruction->operands[0].kind == OPERAND_TEMPORARY &&
+              instruction->operands[0].data.temporary < num_temporaries) {
+      slot = address_variables[instruction->operands[0].data.temporary];
+    }
+    if(slot < 0 || !table->variables[slot].is_promotable) {
+      continue;
+    }
+    variable = &table->variables[slot];
+
+    switch(instruction->kind) {
+      case IR_ADDRESS_OF:
+        ir_remove_next_instruction(instruction->prev);
+        break;
+      case IR_LOAD_WORD:
+        ir_rewrite_as_copy(instruction, variable->temporary);
+        break;
+      case IR_STORE_WORD:
+        assert(instruction->operands[1].kind == OPERAND_TEMPORARY);
+        instruction->kind = IR_COPY;
+        ir_set_temporary_operand(instruction, 0, variable->temporary);
+        break;
+    }
+  }
+}
+
+void promote_variables_to_registers(struct ir_section **root_ir) {
+  struct control_flow_graph *cfg;
+  struct ir_instruction *instruction, *function_begin;
+  struct variable_table table;
+  int *address_variables;
+  int num_temporaries, next_temporary, num_addresses;
+
+  function_begin = (*root_ir)->first;
+  while(function_begin != NULL) {
+    if(function_begin->kind != IR_FUNCTION_BEGIN) {
+      function_begin = function_begin->next;
+      continue;
+    }
+
+    cfg = cfg_build_for_function(function_begin);
+    num_temporaries = count_temporaries(cfg);
+    num_addresses = 0;
+    for(instruction = cfg->function_begin; instruction != cfg->function_end;
+        instruction = instruction->next) {
+      if(instruction->kind == IR_ADDRESS_OF) {
+        num_addresses++;
+      }
+    }
+    table.num_slots = 1;
+    while(table.num_slots <= 2 * num_addresses) {
+      table.num_slots *= 2;
+    }
+    table.variables = arena_allocate(&optimizer_arena,
+                                     sizeof(struct promoted_variable) * table.num_slots);
+    address_variables = arena_allocate(&optimizer_arena, sizeof(int) * (num_temporaries + 1));
+
+    find_promotable_variables(cfg, &table, address_variables, num_temporaries);
+    next_temporary = num_temporaries;
+    assign_variable_temporaries(cfg, &table, address_variables, &next_temporary);
+    promote_variables_in_function(cfg, &table, address_variables, num_temporaries);
+
+    function_begin = cfg->function_end->next;
+    arena_reset(&optimizer_arena);
+  }
+}
+
+/*******************************
+ * DEAD CODE ELIMINATION       *
+ *******************************/
+
+/*
+ * Mark and sweep over the SSA form of each function. The instructions that
+ * do something besides defining a temporary are live, and so is every
+ * definition, instruction or phi, of a name that something live uses. The
+ * rest computes values no one reads. Divisions stay even when their result
+ * is dead, since a division by zero has to trap, and so do the RESULTWORDs
+ * that end the calls.
+ *
+ * Dead instructions are turned into no-ops while the function is in SSA
+ * form, so that the blocks keep their bounds, and removed once it is out.
+ */
+
+static void ir_rewrite_as_no_operation(struct ir_instruction *instruction) {
+  instruction->kind = IR_NO_OPERATION;
+  instruction->operands[0].kind = OPERAND_NULL;
+  instruction->operands[1].kind = OPERAND_NULL;
+  instruction->operands[2].kind = OPERAND_NULL;
+}
+
+static void remove_no_operations_in_function(struct control_flow_graph *cfg) {
+  struct ir_instruction *instruction, *next;
+
+  for(instruction = cfg->function_begin->next; instruction != cfg->function_end;
+      instruction = next) {
+    next = instruction->next;
+    if(instruction->kind == IR_NO_OPERATION) {
+      ir_remove_next_instruction(instruction->prev);
+    }
+  }
+}
+
+static bool is_critical_instruction(struct ir_instruction *instruction) {
+  switch(instruction->kind) {
+    case IR_DIVIDE:
+    case IR_REMAINDER:
+    case IR_RESULTWORD:
+      return true;
+    default:
+      return !ir_is_destination_operand(instruction, 0);
+  }
+}
+
+static void mark_live_name(bool *is_live, int *worklist, int *num_work, int name) {
+  if(!is_live[name]) {
+    is_live[name] = true;
+    worklist[(*num_work)++] = name;
+  }
+}
+
+static void mark_live_operands(bool *is_live, int *worklist, int *num_work,
+                               struct ir_instruction *instruction) {
+  int i;
+  for(i = 0; i < 3; i++) {
+    if(instruction->operands[i].kind == OPERAND_TEMPORARY &&
+       !ir_is_destination_operand(instruction, i)) {
+      mark_live_name(is_live, worklist, num_work, instruction->operands[i].data.temporary);
+    }
+  }
+}
+
+static void remove_dead_code_in_function(struct ssa_form *ssa) {
+  struct control_flow_graph *cfg = ssa->cfg;
+  struct basic_block *basic_block;
+  struct ir_instruction *instruction;
+  struct ssa_phi *phi, **link;
+  struct ssa_name *name;
+  bool *is_live;
+  int *worklist;
+  int i, num_work;
+
+  is_live = arena_allocate(&optimizer_arena, sizeof(bool) * (ssa->num_names + 1));
+  worklist = arena_allocate(&optimizer_arena, sizeof(int) * (ssa->num_names + 1));
+  num_work = 0;
+
+  for(i = 0; i < cfg->num_reachable_blocks; i++) {
+    basic_block = cfg->reverse_postorder[i];
+    for(instruction = basic_block->beginning; ; instruction = instruction->next) {
+      if(is_critical_instruction(instruction)) {
+        mark_live_operands(is_live, worklist, &num_work, instruction);
+      }
+      if(instruction == basic_block->end) {
+        break;
+      }
+    }
+  }
+
+  while(num_work > 0) {
+    name = &ssa->names[worklist[--num_work]];
+    if(name->instruction != NULL) {
+      mark_live_operands(is_live, worklist, &num_work, name->instruction);
+    } else if(name->phi != NULL) {
+      for(i = 0; i < name->phi->basic_block->num_predecessors; i++) {
+        mark_live_name(is_live, worklist, &num_work, name->phi->arguments[i]);
+      }
+    }
+  }
+
+  for(i = 0; i < cfg->num_reachable_blocks; i++) {
+    basic_block = cfg->reverse_postorder[i];
+    for(link = &ssa->phis[basic_block->number]; *link != NULL; ) {
+      phi = *link;
+      if(is_live[phi->temporary]) {
+        link = &phi->next;
+      } else {
+        *link = phi->next;
+      }
+    }
+    for(instruction = basic_block->beginning; ; instruction = instruction->next) {
+      if(!is_critical_instruction(instruction) &&
+         !is_live[instruction->operands[0].data.temporary]) {
+        ir_rewrite_as_no_operation(instruction);
+      }
+      if(instruction == basic_block->end) {
+        break;
+      }
+    }
+  }
+}
+
+void remove_dead_code(struct ir_section **root_ir) {
+  struct control_flow_graph *cfg;
+  struct ir_instruction *function_begin;
+  struct ssa_form *ssa;
+
+  function_begin = (*root_ir)->first;
+  while(function_begin != NULL) {
+    if(function_begin->kind != IR_FUNCTION_BEGIN) {
+      function_begin = function_begin->next;
+      continue;
+    }
+
+    cfg = cfg_build_for_function(function_begin);
+    ssa = ssa_build(cfg, count_temporaries(cfg));
+    remove_dead_code_in_function(ssa);
+    ssa_destroy(ssa);
+    remove_no_operations_in_function(cfg);
+
+    function_begin = cfg->function_end->next;
+    arena_reset(&optimizer_arena);
+  }
+}
+
+/*******************************
+ * CONDITIONAL CONSTANTS       *
+ *******************************/
+
+/*
+ * Sparse conditional constant propagation, the algorithm of Wegman and
+ * Zadeck, over the SSA form of each function. Every name starts out with no
+ * value and is lowered to a constant, and from there to varying, as the
+ * definitions that reach it are evaluated. Only the blocks that control can
+ * reach are evaluated, and a conditional branch on a constant makes only one
+ * of its edges executable, so constants flow across the branches that can
+ * never be taken, which propagating them inside a block cannot do.
+ *
+ * Afterwards every constant name is defined by a load immediate, a branch
+ * on a constant becomes a goto or goes away, and the blocks control never
+ * reaches are removed. A constant used outside the block that defines it is
+ * loaded again right before the use, so that the passes that only know the
+ * constants of a block still see it.
+ */
+
+#define SCCP_UNDEFINED  0
+#define SCCP_CONSTANT   1
+#define SCCP_VARYING    2
+
+/*
+ * The executable edges are kept apart for the fallthrough and the branch
+ * out of each block, indexed by block number.
+ */
+struct sccp {
+  struct ssa_form *ssa;
+  int *lattice;
+  unsigned int *values;
+  bool *is_executable;
+  bool *is_left_executable, *is_right_executable;
+  int *name_worklist;
+  int num_names_to_visit;
+  struct basic_block **block_worklist;
+  int num_blocks_to_visit;
+};
+
+/* A constant used in another block, to be loaded again before the use */
+struct sccp_rematerialization {
+  struct ir_instruction *instruction;
+  int position;
+  unsigned int value;
+  struct sccp_rematerialization *next;
+};
+
+static int sccp_operand(struct sccp *sccp, struct ir_operand *operand, unsigned int *value) {
+  switch(operand->kind) {
+    case OPERAND_TEMPORARY:
+      *value = sccp->values[operand->data.temporary];
+      return sccp->lattice[operand->data.temporary];
+    case OPERAND_NUMBER:
+      *value = (unsigned int)operand->data.number;
+      return SCCP_CONSTANT;
+    default:
+      return SCCP_VARYING;
+  }
+}
+
+static void sccp_lower(struct sccp *sccp, int name, int lattice, unsigned int value) {
+  if(lattice == SCCP_CONSTANT && sccp->lattice[name] == SCCP_CONSTANT &&
+     sccp->values[name] != value) {
+    lattice = SCCP_VARYING;
+  }
+  if(lattice <= sccp->lattice[name]) {
+    return;
+  }
+  sccp->lattice[name] = lattice;
+  sccp->values[name] = value;
+  sccp->name_worklist[sccp->num_names_to_visit++] = name;
+}
+
+static void sccp_mark_edge(struct sccp *sccp, struct basic_block *basic_block, bool is_branch) {
+  struct basic_block *successor;
+
+  /* A conditional branch to the very next block only has its fallthrough */
+  if(is_branch && basic_block->right != NULL) {
+    if(sccp->is_right_executable[basic_block->number]) {
+      return;
+    }
+    sccp->is_right_executable[basic_block->number] = true;
+    successor = basic_block->right;
+  } else {
+    if(basic_block->left == NULL || sccp->is_left_executable[basic_block->number]) {
+      return;
+    }
+    sccp->is_left_executable[basic_block->number] = true;
+    successor = basic_block->left;
+  }
+  sccp->block_worklist[sccp->num_blocks_to_visit++] = successor;
+}
+
+static bool sccp_is_edge_executable(struct sccp *sccp, struct basic_block *predecessor,
+                                    struct basic_block *basic_block) {
+  return (predecessor->left == basic_block && sccp->is_left_executable[predecessor->number]) ||
+    (predecessor->right == basic_block && sccp->is_right_executable[predecessor->number]);
+}
+
+/* A phi is the meet of its arguments along the executable edges */
+static void sccp_visit_phi(struct sccp *sccp, struct ssa_phi *phi) {
+  struct basic_block *basic_block = phi->basic_block;
+  unsigned int value = 0;
+  int lattice = SCCP_UNDEFINED;
+  int i, argument;
+
+  for(i = 0; i < basic_block->num_predecessors && lattice != SCCP_VARYING; i++) {
+    if(!sccp_is_edge_executable(sccp, basic_block->predecessors[i], basic_block)) {
+      continue;
+    }
+    argument = phi->arguments[i];
+    if(sccp->lattice[argument] == SCCP_VARYING ||
+       (lattice == SCCP_CONSTANT && sccp->lattice[argument] == SCCP_CONSTANT &&
+        sccp->values[argument] != value)) {
+      lattice = SCCP_VARYING;
+    } else if(sccp->lattice[argument] == SCCP_CONSTANT) {
+      lattice = SCCP_CONSTANT;
+      value = sccp->values[argument];
+    }
+  }
+  sccp_lower(sccp, phi->temporary, lattice, value);
+}
+
+/*
+ * An operation is undefined while one of its operands is, and varying once
+ * one of them is varying or it cannot be folded, such as a load.
+ */
+static int sccp_evaluate(struct sccp *sccp, struct ir_instruction *instruction,
+                         unsigned int *result) {
+  unsigned int values[2];
+  bool is_undefined = false;
+  int i, num_operands;
+
+  switch(instruction->kind) {
+    case IR_LOAD_IMMEDIATE:
+      *result = (unsigned int)instruction->operands[1].data.number;
+      return SCCP_CONSTANT;
+    case IR_COPY:
+      return sccp_operand(sccp, &instruction->operands[1], result);
+    default:
+      break;
+  }
+
+  num_operands = 0;
+  for(i = 1; i < 3 && instruction->operands[i].kind != OPERAND_NULL; i++) {
+    switch(sccp_operand(sccp, &instruction->operands[i], &values[num_operands++])) {
+      case SCCP_VARYING:
+        return SCCP_VARYING;
+      case SCCP_UNDEFINED:
+        is_undefined = true;
+        break;
+    }
+  }
+  if(num_operands == 0) {
+    return SCCP_VARYING;
+  }
+  if(is_undefined) {
+    return SCCP_UNDEFINED;
+  }
+  if(num_operands == 2 ?
+     fold_binary_operation(instruction->kind, values[0], values[1], result) :
+     fold_unary_operation(instruction->kind, values[0], result)) {
+    return SCCP_CONSTANT;
+  }
+  return SCCP_VARYING;
+}
+
+static void sccp_visit_branch(struct sccp *sccp, struct basic_block *basic_block,
+                              struct ir_instruction *instruction) {
+  unsigned int value;
+
+  switch(instruction->kind) {
+    case IR_GOTO:
+      sccp_mark_edge(sccp, basic_block, true);
+      break;
+    case IR_GOTO_IF_FALSE:
+    case IR_GOTO_IF_TRUE:
+      switch(sccp_operand(sccp, &instruction->operands[0], &value)) {
+        case SCCP_CONSTANT:
+          sccp_mark_edge(sccp, basic_block,
+                         (value == 0) == (instruction->kind == IR_GOTO_IF_FALSE));
+          break;
+        case SCCP_VARYING:
+          sccp_mark_edge(sccp, basic_block, false);
+          sccp_mark_edge(sccp, basic_block, true);
+          break;
+      }
+      break;
+    case IR_FUNCTION_END:
+      break;
+    default:
+      sccp_mark_edge(sccp, basic_block, false);
+      break;
+  }
+}
+
+static void sccp_visit_instruction(struct sccp *sccp, struct basic_block *basic_block,
+                                   struct ir_instruction *instruction) {
+  unsigned int value = 0;
+  int lattice;
+
+  if(ir_is_destination_operand(instruction, 0)) {
+    lattice = sccp_evaluate(sccp, instruction, &value);
+    sccp_lower(sccp, instruction->operands[0].data.temporary, lattice, value);
+  }
+  if(instruction == basic_block->end) {
+    sccp_visit_branch(sccp, basic_block, instruction);
+  }
+}
+
+static void sccp_visit_block(struct sccp *sccp, struct basic_block *basic_block) {
+  struct ir_instruction *instruction;
+  struct ssa_phi *phi;
+  bool is_first_visit;
+
+  is_first_visit = !sccp->is_executable[basic_block->number];
+  sccp->is_executable[basic_block->number] = true;
+
+  for(phi = sccp->ssa->phis[basic_block->number]; phi != NULL; phi = phi->next) {
+    sccp_visit_phi(sccp, phi);
+  }
+  /* Only the phis can change when a block is reached along another edge */
+  if(!is_first_visit) {
+    return;
+  }
+  for(instruction = basic_block->beginning; ; instruction = instruction->next) {
+    sccp_visit_instruction(sccp, basic_block, instruction);
+    if(instruction == basic_block->end) {
+      break;
+    }
+  }
+}
+
+static void sccp_solve(struct sccp *sccp) {
+  struct ssa_use *use;
+  int name;
+
+  sccp->block_worklist[sccp->num_blocks_to_visit++] = sccp->ssa->cfg->entry;
+  while(sccp->num_names_to_visit > 0 || sccp->num_blocks_to_visit > 0) {
+    if(sccp->num_names_to_visit == 0) {
+      sccp_visit_block(sccp, sccp->block_worklist[--sccp->num_blocks_to_visit]);
+      continue;
+    }
+    name = sccp->name_worklist[--sccp->num_names_to_visit];
+    for(use = sccp->ssa->names[name].uses; use != NULL; use = use->next) {
+      if(!sccp->is_executable[use->basic_block->number]) {
+        continue;
+      }
+      if(use->phi != NULL) {
+        sccp_visit_phi(sccp, use->phi);
+      } else {
+        sccp_visit_instruction(sccp, use->basic_block, use->instruction);
+      }
+    }
+  }
+}
+
+/*
+ * A constant phi becomes a load immediate at the top of its block, which
+ * always begins with a label since more than one edge enters it. The
+ * arguments along edges that are never taken are made the phi itself, so
+ * that leaving SSA form puts no copies on them.
+ */
+static void sccp_rewrite_phis(struct sccp *sccp, struct basic_block *basic_block) {
+  struct ir_instruction *load_immediate, *label = basic_block->beginning;
+  struct ssa_phi *phi, **link;
+  int i;
+
+  for(link = &sccp->ssa->phis[basic_block->number]; *link != NULL; ) {
+    phi = *link;
+    if(sccp->lattice[phi->temporary] != SCCP_CONSTANT) {
+      for(i = 0; i < basic_block->num_predecessors; i++) {
+        if(!sccp_is_edge_executable(sccp, basic_block->predecessors[i], basic_block)) {
+          phi->arguments[i] = phi->temporary;
+        }
+      }
+      link = &phi->next;
+      continue;
+    }
+
+    assert(label->kind == IR_GENERATED_LABEL);
+    load_immediate = ir_instruction(IR_LOAD_IMMEDIATE);
+    ir_set_temporary_operand(load_immediate, 0, phi->temporary);
+    ir_rewrite_as_load_immediate(load_immediate, sccp->values[phi->temporary]);
+    ir_insert_instruction_before(label->next, load_immediate);
+    if(basic_block->end == label) {
+      basic_block->end = load_immediate;
+    }
+    *link = phi->next;
+  }
+}
+
+/* The branch that ends a block keeps only the edges that can be taken */
+static void sccp_rewrite_branch(struct sccp *sccp, struct basic_block *basic_block) {
+  struct ir_instruction *branch = basic_block->end;
+
+  if((branch->kind != IR_GOTO_IF_FALSE && branch->kind != IR_GOTO_IF_TRUE) ||
+     (sccp->is_left_executable[basic_block->number] &&
+      sccp->is_right_executable[basic_block->number])) {
+    return;
+  }
+  if(sccp->is_right_executable[basic_block->number]) {
+    branch->kind = IR_GOTO;
+    branch->operands[0] = branch->operands[1];
+    branch->operands[1].kind = OPERAND_NULL;
+  } else {
+    ir_rewrite_as_no_operation(branch);
+  }
+}
+
+static struct sccp_rematerialization *sccp_rewrite_block(struct sccp *sccp,
+                                                         struct basic_block *basic_block,
+                                                         struct sccp_rematerialization *list) {
+  struct sccp_rematerialization *rematerialization;
+  struct ir_instruction *instruction;
+  int i, name;
+
+  sccp_rewrite_phis(sccp, basic_block);
+  for(instruction = basic_block->beginning; ; instruction = instruction->next) {
+    if(ir_is_destination_operand(instruction, 0) &&
+       sccp->lattice[instruction->operands[0].data.temporary] == SCCP_CONSTANT) {
+      if(instruction->kind != IR_LOAD_IMMEDIATE) {
+        ir_rewrite_as_load_immediate(instruction,
+                                     sccp->values[instruction->operands[0].data.temporary]);
+      }
+    } else if(instruction->kind != IR_GOTO_IF_FALSE && instruction->kind != IR_GOTO_IF_TRUE) {
+      for(i = 0; i < 3; i++) {
+        if(instruction->operands[i].kind != OPERAND_TEMPORARY ||
+           ir_is_destination_operand(instruction, i)) {
+          continue;
+        }
+        name = instruction->operands[i].data.temporary;
+        if(sccp->lattice[name] == SCCP_CONSTANT &&
+           sccp->ssa->names[name].basic_block != basic_block) {
+          rematerialization = arena_allocate(&optimizer_arena,
+                                             sizeof(struct sccp_rematerialization));
+          rematerialization->instruction = instruction;
+          rematerialization->position = i;
+          rematerialization->value = sccp->values[name];
+          rematerialization->next = list;
+          list = rematerialization;
+        }
+      }
+    }
+    if(instruction == basic_block->end) {
+      break;
+    }
+  }
+  sccp_rewrite_branch(sccp, basic_block);
+  return list;
+}
+
+static void propagate_conditional_constants_in_function(struct control_flow_graph *cfg) {
+  struct sccp_rematerialization *list = NULL;
+  struct basic_block *basic_block;
+  struct ir_instruction *instruction;
+  struct sccp sccp;
+  int i, next_temporary;
+
+  next_temporary = count_temporaries(cfg);
+  sccp.ssa = ssa_build(cfg, next_temporary);
+  sccp.lattice = arena_allocate(&optimizer_arena, sizeof(int) * (sccp.ssa->num_names + 1));
+  sccp.values = arena_allocate(&optimizer_arena,
+                               sizeof(unsigned int) * (sccp.ssa->num_names + 1));
+  sccp.is_executable = arena_allocate(&optimizer_arena, sizeof(bool) * cfg->num_blocks);
+  sccp.is_left_executable = arena_allocate(&optimizer_arena, sizeof(bool) * cfg->num_blocks);
+  sccp.is_right_executable = arena_allocate(&optimizer_arena, sizeof(bool) * cfg->num_blocks);
+  for(i = 0; i < cfg->num_blocks; i++) {
+    sccp.is_executable[i] = false;
+    sccp.is_left_executable[i] = false;
+    sccp.is_right_executable[i] = false;
+  }
+
+  /* Nothing is known of the values the variables have on entry */
+  for(i = 0; i < sccp.ssa->num_names; i++) {
+    sccp.lattice[i] = i < sccp.ssa->num_variables ? SCCP_VARYING : SCCP_UNDEFINED;
+    sccp.values[i] = 0;
+  }
+
+  /* A name is lowered at most twice and an edge becomes executable once */
+  sccp.name_worklist = arena_allocate(&optimizer_arena,
+                                      sizeof(int) * (2 * sccp.ssa->num_names + 1));
+  sccp.num_names_to_visit = 0;
+  sccp.block_worklist = arena_allocate(&optimizer_arena,
+                                       sizeof(struct basic_block *) * (2 * cfg->num_blocks + 1));
+  sccp.num_blocks_to_visit = 0;
+
+  sccp_solve(&sccp);
+
+  for(i = 0; i < cfg->num_blocks; i++) {
+    basic_block = cfg->blocks[i];
+    if(sccp.is_executable[i]) {
+      list = sccp_rewrite_block(&sccp, basic_block, list);
+      continue;
+    }
+    for(instruction = basic_block->beginning; ; instruction = instruction->next) {
+      if(instruction->kind != IR_FUNCTION_END) {
+        ir_rewrite_as_no_operation(instruction);
+      }
+      if(instruction == basic_block->end) {
+        break;
+      }
+    }
+  }
+  ssa_destroy(sccp.ssa);
+
+  for(; list != NULL; list = list->next) {
+    ir_set_temporary_operand(list->instruction, list->position,
+                             insert_load_immediate(list->instruction, &next_temporary,
+                                                   list->value));
+  }
+  remove_no_operations_in_function(cfg);
+}
+
+/*
+ * The branches that were rewritten leave gotos to the very next label and
+ * labels no one jumps to any more, which are cleaned up as before.
+ */
+void propagate_conditional_constants(struct ir_section **root_ir) {
+  struct control_flow_graph *cfg;
+  struct ir_instruction *function_begin;
+
+  function_begin = (*root_ir)->first;
+  while(function_begin != NULL) {
+    if(function_begin->kind != IR_FUNCTION_BEGIN) {
+      function_begin = function_begin->next;
+      continue;
+    }
+
+    cfg = cfg_build_for_function(function_begin);
+    propagate_conditional_constants_in_function(cfg);
+
+    function_begin = cfg->function_end->next;
+    arena_reset(&optimizer_arena);
+  }
 
+  remove_redundant_gotos(root_ir);
+  remove_redundant_labels(root_ir);
 }
@@ -6,12 +6,33 @@
 struct ir_instruction;
 struct ir_section;
 
+/*
+ * left is the block control falls through to and right the block the branch
+ * ending this one jumps to; either is NULL when there is no such edge.
+ * number is the position of the block in program order.
+ */
 struct basic_block {
   struct ir_section * ir_section;
   struct ir_instruction *beginning;
   struct ir_instruction *end;
   struct basic_block *next;
   struct basic_block *left, *right;
+  struct basic_block **predecessors;
+  int num_predecessors;
+  int number;
+};
+
+/*
+ * The control flow graph of one function. blocks lists every block in
+ * program order, reverse_postorder only those reachable from the entry.
+ */
+struct control_flow_graph {
+  struct ir_instruction *function_begin, *function_end;
+  struct basic_block *entry;
+  struct basic_block **blocks;
+  int num_blocks;
+  struct basic_block **reverse_postorder;
+  int num_reachable_blocks;
 };
 
 void remove_no_ops_from_ir(struct ir_section **root_ir);
@@ -20,7 +41,21 @@ void remove_redundant_gotos(struct ir_section **root_ir);
 
 void remove_redundant_labels(struct ir_section **root_ir);
 
+/* Blocks and graphs live in optimizer_arena until it is reset */
 struct basic_block * get_basic_blocks_from_ir(struct ir_section *root_ir);
 
+struct control_flow_graph *cfg_build_for_function(struct ir_instruction *function_begin);
+
+void promote_variables_to_registers(struct ir_section **root_ir);
+
 void propagate_constant_values(struct ir_section **root_ir);
+
+void propagate_conditional_constants(struct ir_section **root_ir);
+
+void reduce_strength_of_operations(struct ir_section **root_ir);
+
+void remove_dead_code(struct ir_section **root_ir);
+
+/* Number of basic blocks built over the whole compilation */
+extern unsigned long basic_block_num_created;
 #endif /* _BASIC_BLOCKS_H */
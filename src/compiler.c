@@ -1,13 +1,20 @@
+#include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <errno.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/resource.h>
 
 #include "node.h"
 #include "symbol.h"
 #include "type.h"
 #include "ir.h"
 #include "mips.h"
+#include "interpreter.h"
+#include "string_pool.h"
+#include "arena.h"
 
 
 #define YYSTYPE struct node *
@@ -19,8 +26,6 @@
 int yyparse();
 extern int yynerrs;
 
-extern int errno;
-
 struct node *root_node;
 
 static void print_errors_from_pass(FILE *output, char *pass, int num_errors) {
@@ -28,7 +33,7 @@ static void print_errors_from_pass(FILE *output, char *pass, int num_errors) {
           pass, num_errors, (num_errors == 1 ? "error" : "errors"));
 }
 
-static void print_string(FILE *output, char *str, int length) {
+static void print_string(FILE *output, const char *str, int length) {
   int i;
   for (i = 0; i < length; i++) {
     if (str[i] == 0) {
@@ -230,10 +235,11 @@ int scan_only(FILE *output) {
 	}
       }
     } else if (0 == strcmp("id", token_type)) {
-      fprintf(output, "\tToken type: Identifier\tName = %s\n", yylval->data.identifier.name);
+      fprintf(output, "\tToken type: Identifier\tName = %s\n", string_pool_text(yylval->data.identifier.name));
     } else if (0 == strcmp("str", token_type)) {
       fprintf(output, "\tToken type: String\tName = ");
-      print_string(output, yylval->data.string.name, yylval->data.string.length);
+      print_string(output, string_pool_text(yylval->data.string.name),
+                   string_pool_length(yylval->data.string.name));
       fprintf(output, "\n");
     } else if (0 == strcmp("op", token_type)) {
       fprintf(output, "\tToken type: Operand\tName = %s\n", token_name);
@@ -248,16 +254,433 @@ int scan_only(FILE *output) {
   return num_errors;
 }
 
+/*
+ * Diagnostic dumps. Nothing is dumped unless asked for with -d, so a plain
+ * compilation does no formatting besides the assembly itself.
+ */
+#define DUMP_PARSE_TREE     (1 << 0)
+#define DUMP_SYMBOLS        (1 << 1)
+#define DUMP_TYPES          (1 << 2)
+#define DUMP_IR             (1 << 3)
+#define DUMP_MIPS           (1 << 4)
+#define DUMP_NO_OPS         (1 << 5)
+#define DUMP_GOTOS          (1 << 6)
+#define DUMP_LABELS         (1 << 7)
+#define DUMP_CONSTANTS      (1 << 8)
+#define DUMP_MEMORY         (1 << 9)
+#define DUMP_STRENGTH       (1 << 10)
+#define DUMP_PROMOTION      (1 << 11)
+#define DUMP_DEAD_CODE      (1 << 12)
+#define DUMP_SCCP           (1 << 13)
+
+static struct {
+  char *name;
+  int flag;
+  char *description;
+} dump_stages[] = {
+  { "parse",     DUMP_PARSE_TREE, "parse tree as parsed" },
+  { "symbols",   DUMP_SYMBOLS,    "file scope symbol table" },
+  { "types",     DUMP_TYPES,      "parse tree after type checking" },
+  { "ir",        DUMP_IR,         "IR as generated" },
+  { "mips",      DUMP_MIPS,       "MIPS for the unoptimized IR" },
+  { "noops",     DUMP_NO_OPS,     "IR after removing no-ops" },
+  { "gotos",     DUMP_GOTOS,      "IR after removing redundant gotos" },
+  { "labels",    DUMP_LABELS,     "IR after removing redundant labels" },
+  { "promotion", DUMP_PROMOTION,  "IR after promoting locals to temporaries" },
+  { "constants", DUMP_CONSTANTS,  "IR after propagating constant values" },
+  { "sccp",      DUMP_SCCP,       "IR after sparse conditional constant propagation" },
+  { "strength",  DUMP_STRENGTH,   "IR after reducing the strength of operations" },
+  { "dead",      DUMP_DEAD_CODE,  "IR after removing dead code" },
+  { "memory",    DUMP_MEMORY,     "arena statistics" },
+  { NULL, 0, NULL }
+};
+
+/*
+ * Reports asked for with -f. They are printed to the dump output once the
+ * compilation is done, as text or, with -f json, as a single JSON object
+ * holding all of them.
+ */
+#define REPORT_TIME         (1 << 0)
+#define REPORT_MEMORY       (1 << 1)
+#define REPORT_JSON         (1 << 2)
+
+static struct {
+  char *name;
+  int flag;
+  char *description;
+} reports[] = {
+  { "time-report", REPORT_TIME,   "wall time and peak memory of every phase" },
+  { "mem-report",  REPORT_MEMORY, "memory and objects allocated by every phase" },
+  { "json",        REPORT_JSON,   "all of the reports as JSON" },
+  { NULL, 0, NULL }
+};
+
+/*
+ * Every phase of the compilation is measured whether or not a report is
+ * asked for; reading the clock and the counters is cheap next to any of the
+ * phases. Memory is what the phase allocated from the arenas.
+ */
+#define MAX_PHASES          16
+
+struct phase_counters {
+  unsigned long bytes_allocated;
+  unsigned long nodes;
+  unsigned long symbols;
+  unsigned long types;
+  unsigned long instructions;
+  unsigned long basic_blocks;
+};
+
+static struct {
+  char *name;
+  double seconds;
+  long peak_kilobytes;
+  unsigned long bytes_reserved;
+  struct phase_counters created;
+} phases[MAX_PHASES];
+static int num_phases;
+static struct timespec phase_start;
+static struct phase_counters phase_start_counters;
+
+static void read_phase_counters(struct phase_counters *counters) {
+  counters->bytes_allocated = arena_total_bytes_allocated();
+  counters->nodes = node_num_created;
+  counters->symbols = symbol_num_created;
+  counters->types = type_num_created;
+  counters->instructions = ir_num_instructions_created;
+  counters->basic_blocks = basic_block_num_created;
+}
+
+static void phase_begin(void) {
+  read_phase_counters(&phase_start_counters);
+  clock_gettime(CLOCK_MONOTONIC, &phase_start);
+}
+
+static void phase_end(char *name) {
+  struct timespec phase_end_time;
+  struct phase_counters counters, *created;
+  struct rusage usage;
+
+  clock_gettime(CLOCK_MONOTONIC, &phase_end_time);
+  getrusage(RUSAGE_SELF, &usage);
+  read_phase_counters(&counters);
+  assert(num_phases < MAX_PHASES);
+  phases[num_phases].name = name;
+  phases[num_phases].seconds = (phase_end_time.tv_sec - phase_start.tv_sec) +
+    (phase_end_time.tv_nsec - phase_start.tv_nsec) / 1e9;
+  /* ru_maxrss is the peak resident set size of the process so far */
+  phases[num_phases].peak_kilobytes = usage.ru_maxrss;
+  phases[num_phases].bytes_reserved = arena_total_bytes_reserved();
+
+  created = &phases[num_phases].created;
+  created->bytes_allocated = counters.bytes_allocated - phase_start_counters.bytes_allocated;
+  created->nodes = counters.nodes - phase_start_counters.nodes;
+  created->symbols = counters.symbols - phase_start_counters.symbols;
+  created->types = counters.types - phase_start_counters.types;
+  created->instructions = counters.instructions - phase_start_counters.instructions;
+  created->basic_blocks = counters.basic_blocks - phase_start_counters.basic_blocks;
+  num_phases++;
+}
+
+static double total_phase_seconds(void) {
+  double total = 0;
+  int i;
+  for (i = 0; i < num_phases; i++) {
+    total += phases[i].seconds;
+  }
+  return total;
+}
+
+static long peak_phase_kilobytes(void) {
+  return num_phases > 0 ? phases[num_phases - 1].peak_kilobytes : 0L;
+}
+
+static void print_time_report(FILE *output) {
+  int i;
+
+  fprintf(output, "\n============== TIME REPORT ===============\n");
+  fprintf(output, "%-12s %12s %16s\n", "phase", "seconds", "peak memory (KB)");
+  for (i = 0; i < num_phases; i++) {
+    fprintf(output, "%-12s %12.6f %16ld\n", phases[i].name, phases[i].seconds, phases[i].peak_kilobytes);
+  }
+  fprintf(output, "%-12s %12.6f %16ld\n", "total", total_phase_seconds(), peak_phase_kilobytes());
+}
+
+static void print_memory_report(FILE *output) {
+  struct phase_counters total;
+  int i;
+
+  memset(&total, 0, sizeof(struct phase_counters));
+  fprintf(output, "\n============= MEMORY REPORT ==============\n");
+  fprintf(output, "%-12s %12s %12s %10s %10s %8s %12s %8s\n", "phase", "allocated", "reserved",
+          "nodes", "symbols", "types", "instructions", "blocks");
+  for (i = 0; i < num_phases; i++) {
+    fprintf(output, "%-12s %12lu %12lu %10lu %10lu %8lu %12lu %8lu\n", phases[i].name,
+            phases[i].created.bytes_allocated, phases[i].bytes_reserved, phases[i].created.nodes,
+            phases[i].created.symbols, phases[i].created.types, phases[i].created.instructions,
+            phases[i].created.basic_blocks);
+    total.bytes_allocated += phases[i].created.bytes_allocated;
+    total.nodes += phases[i].created.nodes;
+    total.symbols += phases[i].created.symbols;
+    total.types += phases[i].created.types;
+    total.instructions += phases[i].created.instructions;
+    total.basic_blocks += phases[i].created.basic_blocks;
+  }
+  fprintf(output, "%-12s %12lu %12s %10lu %10lu %8lu %12lu %8lu\n", "total", total.bytes_allocated,
+          "", total.nodes, total.symbols, total.types, total.instructions, total.basic_blocks);
+  fprintf(output, "\n");
+  arena_print_statistics(output);
+}
+
+static void print_json_report(FILE *output) {
+  int i;
+
+  fprintf(output, "{\n  \"phases\": [\n");
+  for (i = 0; i < num_phases; i++) {
+    fprintf(output, "    {\"name\": \"%s\", \"seconds\": %.6f, \"peak_kilobytes\": %ld, "
+            "\"bytes_allocated\": %lu, \"bytes_reserved\": %lu, \"nodes\": %lu, "
+            "\"symbols\": %lu, \"types\": %lu, \"instructions\": %lu, \"basic_blocks\": %lu}%s\n",
+            phases[i].name, phases[i].seconds, phases[i].peak_kilobytes,
+            phases[i].created.bytes_allocated, phases[i].bytes_reserved, phases[i].created.nodes,
+            phases[i].created.symbols, phases[i].created.types, phases[i].created.instructions,
+            phases[i].created.basic_blocks, i + 1 < num_phases ? "," : "");
+  }
+  fprintf(output, "  ],\n");
+  fprintf(output, "  \"seconds\": %.6f,\n  \"peak_kilobytes\": %ld,\n", total_phase_seconds(),
+          peak_phase_kilobytes());
+  fprintf(output, "  \"nodes\": %lu,\n  \"symbols\": %lu,\n  \"types\": %lu,\n",
+          node_num_created, symbol_num_created, type_num_created);
+  fprintf(output, "  \"instructions\": %lu,\n  \"basic_blocks\": %lu,\n",
+          ir_num_instructions_created, basic_block_num_created);
+  fprintf(output, "  \"bytes_allocated\": %lu\n}\n", arena_total_bytes_allocated());
+}
+
+static void print_reports(FILE *output, int report_flags) {
+  if (report_flags & REPORT_JSON) {
+    print_json_report(output);
+    return;
+  }
+  if (report_flags & REPORT_TIME) {
+    print_time_report(output);
+  }
+  if (report_flags & REPORT_MEMORY) {
+    print_memory_report(output);
+  }
+}
+
+static void print_usage(FILE *output, char *program) {
+  int i;
+  fprintf(output, "Usage: %s [-o output.s] [-s stage] [-d dump[,dump...]] [-D dump_file]\n"
+          "       [-f report] [-R report_file] [-x] [-i program_input] [input.c]\n", program);
+  fprintf(output, "Dumps (-dall selects all of them):\n");
+  for (i = 0; dump_stages[i].name != NULL; i++) {
+    fprintf(output, "  %-10s %s\n", dump_stages[i].name, dump_stages[i].description);
+  }
+  fprintf(output, "Reports:\n");
+  for (i = 0; reports[i].name != NULL; i++) {
+    fprintf(output, "  %-12s %s\n", reports[i].name, reports[i].description);
+  }
+  fprintf(output, "Reports go to the -R file, or with the dumps when there is none. The\n"
+          "json report needs a stream of its own.\n");
+  fprintf(output, "-x runs the IR with the interpreter after every pass, reading the\n"
+          "program's input from the -i file.\n");
+}
+
+/*
+ * Adds the dumps named in a comma separated list to dumps. Returns false if
+ * a name is not known.
+ */
+static bool parse_dump_list(char *list, int *dumps) {
+  char *name;
+  int i;
+
+  for (name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+    if (0 == strcmp("all", name)) {
+      for (i = 0; dump_stages[i].name != NULL; i++) {
+        *dumps |= dump_stages[i].flag;
+      }
+      continue;
+    }
+    for (i = 0; dump_stages[i].name != NULL; i++) {
+      if (0 == strcmp(dump_stages[i].name, name)) {
+        *dumps |= dump_stages[i].flag;
+        break;
+      }
+    }
+    if (dump_stages[i].name == NULL) {
+      fprintf(stdout, "Unknown dump %s.\n", name);
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Adds the report named by -f to report_flags. Returns false if it is not known. */
+static bool parse_report(char *name, int *report_flags) {
+  int i;
+
+  for (i = 0; reports[i].name != NULL; i++) {
+    if (0 == strcmp(reports[i].name, name)) {
+      *report_flags |= reports[i].flag;
+      return true;
+    }
+  }
+  fprintf(stdout, "Unknown report %s.\n", name);
+  return false;
+}
+
+static void dump_ir(FILE *dump_output, char *title, struct ir_section *section) {
+  fprintf(dump_output, "\n%s\n", title);
+  ir_print_section(dump_output, section);
+  fputs("\n\n", dump_output);
+}
+
+/*
+ * With -x the IR is run by the interpreter as generated and again after
+ * every optimization pass. Every run has to behave like the first one, and
+ * the executed instruction counts show what each pass saved.
+ */
+#define MAX_INTERPRETED_STAGES    16
+
+static struct interpreter_result interpreted_stages[MAX_INTERPRETED_STAGES];
+static char *interpreted_stage_names[MAX_INTERPRETED_STAGES];
+static int num_interpreted_stages;
+
+static char *interpreter_input;
+static int interpreter_input_length;
+
+static bool read_interpreter_input(char *file_name) {
+  FILE *input;
+  int max_length = 0, length_read;
+
+  input = fopen(file_name, "r");
+  if (NULL == input) {
+    fprintf(stdout, "Could not open program input %s: %s\n", file_name, strerror(errno));
+    return false;
+  }
+  do {
+    if (interpreter_input_length == max_length) {
+      max_length = max_length == 0 ? 4096 : 2 * max_length;
+      interpreter_input = realloc(interpreter_input, max_length);
+      assert(NULL != interpreter_input);
+    }
+    length_read = fread(interpreter_input + interpreter_input_length, 1,
+                        max_length - interpreter_input_length, input);
+    interpreter_input_length += length_read;
+  } while (length_read > 0);
+  fclose(input);
+  return true;
+}
+
+static void interpret_stage(char *name, struct ir_section *section) {
+  assert(num_interpreted_stages < MAX_INTERPRETED_STAGES);
+  interpreted_stage_names[num_interpreted_stages] = name;
+  interpreter_run(section, interpreter_input, interpreter_input_length,
+                  &interpreted_stages[num_interpreted_stages]);
+  num_interpreted_stages++;
+}
+
+static void print_interpreter_status(FILE *output, struct interpreter_result *result) {
+  switch (result->status) {
+    case INTERPRETER_OK:
+      fprintf(output, "exited with %d", result->exit_code);
+      break;
+    case INTERPRETER_RUNTIME_ERROR:
+      fprintf(output, "error: %s", result->message);
+      break;
+    default:
+      fprintf(output, "%s", result->message);
+      break;
+  }
+}
+
+/*
+ * Prints the executed instructions of every stage, in total and by opcode,
+ * followed by what the program printed. Returns the number of stages that
+ * behaved differently from the IR as generated. When the IR as generated
+ * did not exit normally there is nothing to compare the stages with.
+ */
+static int print_interpreter_report(FILE *output) {
+  struct interpreter_result *first = &interpreted_stages[0];
+  int num_differences = 0;
+  int i, kind;
+  bool used;
+
+  fprintf(output, "\n============== INTERPRETER ===============\n");
+  fprintf(output, "%-12s %12s %10s   %s\n", "stage", "instructions", "saved", "behavior");
+  for (i = 0; i < num_interpreted_stages; i++) {
+    fprintf(output, "%-12s %12lu ", interpreted_stage_names[i], interpreted_stages[i].num_instructions);
+    if (i == 0) {
+      fprintf(output, "%10s   ", "-");
+      print_interpreter_status(output, first);
+    } else {
+      fprintf(output, "%10ld   ",
+              (long)(first->num_instructions - interpreted_stages[i].num_instructions));
+      if (!interpreter_is_comparable(first)) {
+        fprintf(output, "not comparable, ");
+        print_interpreter_status(output, &interpreted_stages[i]);
+      } else if (interpreter_same_behavior(first, &interpreted_stages[i])) {
+        fprintf(output, "same");
+      } else {
+        fprintf(output, "DIFFERENT, ");
+        print_interpreter_status(output, &interpreted_stages[i]);
+        num_differences++;
+      }
+    }
+    fputs("\n", output);
+  }
+
+  fprintf(output, "\n%-12s", "opcode");
+  for (i = 0; i < num_interpreted_stages; i++) {
+    fprintf(output, " %10s", interpreted_stage_names[i]);
+  }
+  fputs("\n", output);
+  for (kind = 1; kind < IR_NUM_KINDS; kind++) {
+    used = false;
+    for (i = 0; i < num_interpreted_stages; i++) {
+      used = used || interpreted_stages[i].counts[kind] > 0;
+    }
+    if (!used) {
+      continue;
+    }
+    fprintf(output, "%-12s", ir_opcode_name(kind));
+    for (i = 0; i < num_interpreted_stages; i++) {
+      fprintf(output, " %10lu", interpreted_stages[i].counts[kind]);
+    }
+    fputs("\n", output);
+  }
+
+  fprintf(output, "\nOutput of the program:\n");
+  if (first->output_length > 0) {
+    fwrite(first->output, 1, first->output_length, output);
+  }
+  fputs("\n", output);
+
+  for (i = 0; i < num_interpreted_stages; i++) {
+    interpreter_release_result(&interpreted_stages[i]);
+  }
+  num_interpreted_stages = 0;
+  return num_differences;
+}
+
 int main(int argc, char **argv) {
-  FILE *output;
+  FILE *output, *dump_output, *report_output;
   int result;
   struct symbol_table symbol_table;
   char *stage;
   int opt;
+  int dumps;
+  int report_flags;
+  bool interpret;
 
   output = NULL;
+  dump_output = stdout;
+  report_output = NULL;
   stage = "mips";
-  while (-1 != (opt = getopt(argc, argv, "o:s:"))) {
+  dumps = 0;
+  report_flags = 0;
+  interpret = false;
+  while (-1 != (opt = getopt(argc, argv, "o:s:d:D:f:R:xi:"))) {
     switch (opt) {
       case 'o':
         output = fopen(optarg, "w");
@@ -269,8 +692,53 @@ int main(int argc, char **argv) {
       case 's':
         stage = optarg;
         break;
+      case 'd':
+        if (!parse_dump_list(optarg, &dumps)) {
+          print_usage(stdout, argv[0]);
+          return -1;
+        }
+        break;
+      case 'D':
+        dump_output = fopen(optarg, "w");
+        if (NULL == dump_output) {
+          fprintf(stdout, "Could not open dump file %s: %s", optarg, strerror(errno));
+          return -1;
+        }
+        break;
+      case 'f':
+        if (!parse_report(optarg, &report_flags)) {
+          print_usage(stdout, argv[0]);
+          return -1;
+        }
+        break;
+      case 'R':
+        report_output = fopen(optarg, "w");
+        if (NULL == report_output) {
+          fprintf(stdout, "Could not open report file %s: %s", optarg, strerror(errno));
+          return -1;
+        }
+        break;
+      case 'x':
+        interpret = true;
+        break;
+      case 'i':
+        if (!read_interpreter_input(optarg)) {
+          return -1;
+        }
+        break;
+      default:
+        print_usage(stdout, argv[0]);
+        return -1;
     }
   }
+  /* JSON is only machine readable when nothing else is written around it */
+  if (NULL == report_output) {
+    report_output = dump_output;
+  }
+  if ((report_flags & REPORT_JSON) && report_output == dump_output && (dumps != 0 || interpret)) {
+    fprintf(stdout, "The json report cannot share its stream with dumps or -x; use -R.\n");
+    return -1;
+  }
   /* Figure out whether we're using stdin/stdout or file in/file out. */
   if (optind >= argc) {
     yyin = stdin;
@@ -295,7 +763,9 @@ int main(int argc, char **argv) {
     }
   }
 
+  phase_begin();
   result = yyparse();
+  phase_end("parse");
   if (yynerrs > 0) {
     result = 1;
   }
@@ -313,79 +783,176 @@ int main(int argc, char **argv) {
       return 2;
   }
 
-  fprintf(stdout, "\n=============== PARSE TREE ===============\n");
-  node_print_translation_unit(stdout, root_node);
+  if (dumps & DUMP_PARSE_TREE) {
+    fprintf(dump_output, "\n=============== PARSE TREE ===============\n");
+    node_print_translation_unit(dump_output, root_node);
+  }
   if (0 == strcmp("parser", stage)) {
     return 0;
   }
 
+  phase_begin();
   symbol_initialize_table(&symbol_table, FILE_SCOPE_SYMBOL_TABLE);
 
   symbol_add_from_translation_unit(&symbol_table, root_node);
+  phase_end("symbols");
   if (symbol_table_num_errors > 0) {
     print_errors_from_pass(stdout, "Symbol table", symbol_table_num_errors);
     return 3;
   }
-  fprintf(stdout, "\n================= SYMBOLS ================\n");
-  symbol_print_table(stdout, &symbol_table);
+  if (dumps & DUMP_SYMBOLS) {
+    fprintf(dump_output, "\n================= SYMBOLS ================\n");
+    symbol_print_table(dump_output, &symbol_table);
+  }
   if (0 == strcmp("symbol", stage)) {
-    fprintf(stdout, "\n=============== PARSE TREE ===============\n");
-    node_print_translation_unit(stdout, root_node);
     return 0;
   }
 
+  phase_begin();
   type_assign_in_translation_unit(root_node);
+  phase_end("types");
   if (type_checking_num_errors > 0) {
     print_errors_from_pass(stdout, "Type checking", type_checking_num_errors);
     return 4;
   }
-  if (0 == strcmp("type_checking", stage)) {
-    return 0;
+  if (dumps & DUMP_TYPES) {
+    fprintf(dump_output, "\n======== PARSE TREE AFTER TYPES ==========\n");
+    node_print_translation_unit(dump_output, root_node);
   }
-
-  fprintf(stdout, "\n=============== PARSE TREE ===============\n");
-  node_print_translation_unit(stdout, root_node);
-  if (0 == strcmp("parser", stage)) {
+  if (0 == strcmp("type_checking", stage)) {
     return 0;
   }
 
+  phase_begin();
   ir_generate_for_program(root_node);
+  phase_end("ir");
   if (ir_generation_num_errors > 0) {
     print_errors_from_pass(stdout, "IR generation", ir_generation_num_errors);
     return 5;
   }
-  fprintf(stdout, "\n=================== IR ===================\n");
-  ir_print_section(stdout, root_node->ir);
+  if (dumps & DUMP_IR) {
+    dump_ir(dump_output, "=================== IR ===================", root_node->ir);
+  }
   if (0 == strcmp("ir", stage)) {
     return 0;
   }
+  if (interpret) {
+    interpret_stage("ir", root_node->ir);
+  }
 
-  if (0 == strcmp("mips", stage)) {
-    fprintf(stdout, "\n================== MIPS ==================\n");
-    mips_print_program(stdout, root_node->ir);
-    fputs("\n\n", stdout);
+  if (dumps & DUMP_MIPS) {
+    fprintf(dump_output, "\n================== MIPS ==================\n");
+    mips_print_program(dump_output, root_node->ir);
+    fputs("\n\n", dump_output);
   }
 
   /* Optimizations */
+  phase_begin();
   remove_no_ops_from_ir(&root_node->ir);
-  fprintf(stdout, "\n========= REMOVING NO OPS ================\n");
-  ir_print_section(stdout, root_node->ir);
-  fputs("\n\n", stdout);
+  phase_end("noops");
+  if (dumps & DUMP_NO_OPS) {
+    dump_ir(dump_output, "========= REMOVING NO OPS ================", root_node->ir);
+  }
+  if (interpret) {
+    interpret_stage("noops", root_node->ir);
+  }
+  phase_begin();
   remove_redundant_gotos(&root_node->ir);
   remove_redundant_gotos(&root_node->ir);
-  fprintf(stdout, "\n===== REMOVING REDUNDANT GOTOS  ===========\n");
-  ir_print_section(stdout, root_node->ir);
-  fputs("\n\n", stdout);
+  phase_end("gotos");
+  if (dumps & DUMP_GOTOS) {
+    dump_ir(dump_output, "===== REMOVING REDUNDANT GOTOS  ===========", root_node->ir);
+  }
+  if (interpret) {
+    interpret_stage("gotos", root_node->ir);
+  }
+  phase_begin();
   remove_redundant_labels(&root_node->ir);
-  fprintf(stdout, "\n===== REMOVING REDUNDANT LABELS ===========\n");
-  ir_print_section(stdout, root_node->ir);
-  fputs("\n\n", stdout);
+  phase_end("labels");
+  if (dumps & DUMP_LABELS) {
+    dump_ir(dump_output, "===== REMOVING REDUNDANT LABELS ===========", root_node->ir);
+  }
+  if (interpret) {
+    interpret_stage("labels", root_node->ir);
+  }
+  phase_begin();
+  promote_variables_to_registers(&root_node->ir);
+  phase_end("promotion");
+  if (dumps & DUMP_PROMOTION) {
+    dump_ir(dump_output, "===== PROMOTING LOCALS TO TEMPORARIES ====", root_node->ir);
+  }
+  if (interpret) {
+    interpret_stage("promotion", root_node->ir);
+  }
+  phase_begin();
+  propagate_constant_values(&root_node->ir);
+  phase_end("constants");
+  if (dumps & DUMP_CONSTANTS) {
+    dump_ir(dump_output, "===== PROPAGATING CONSTANT VALUES =========", root_node->ir);
+  }
+  if (interpret) {
+    interpret_stage("constants", root_node->ir);
+  }
+  phase_begin();
+  propagate_conditional_constants(&root_node->ir);
+  phase_end("sccp");
+  if (dumps & DUMP_SCCP) {
+    dump_ir(dump_output, "===== PROPAGATING CONDITIONAL CONSTANTS ==", root_node->ir);
+  }
+  if (interpret) {
+    interpret_stage("sccp", root_node->ir);
+  }
+  phase_begin();
+  reduce_strength_of_operations(&root_node->ir);
+  phase_end("strength");
+  if (dumps & DUMP_STRENGTH) {
+    dump_ir(dump_output, "===== REDUCING STRENGTH OF OPERATIONS ====", root_node->ir);
+  }
+  if (interpret) {
+    interpret_stage("strength", root_node->ir);
+  }
+  phase_begin();
+  remove_dead_code(&root_node->ir);
+  phase_end("dead");
+  if (dumps & DUMP_DEAD_CODE) {
+    dump_ir(dump_output, "========= REMOVING DEAD CODE =============", root_node->ir);
+  }
+  if (interpret) {
+    interpret_stage("dead", root_node->ir);
+    if (print_interpreter_report(dump_output) > 0) {
+      fprintf(stdout, "Interpreter: the optimized IR behaves differently from the IR as generated.\n");
+      return 6;
+    }
+  }
   if (0 == strcmp("optims", stage)) {
     return 0;
   }
 
+  phase_begin();
   mips_print_program(output, root_node->ir);
   fputs("\n\n", output);
+  phase_end("mips");
+
+  if (dumps & DUMP_MEMORY) {
+    fprintf(dump_output, "\n================= MEMORY =================\n");
+    arena_print_statistics(dump_output);
+  }
+  print_reports(report_output, report_flags);
+
+  /* Release the memory of the whole compilation */
+  type_release();
+  string_pool_release();
+  arena_release_all();
+  root_node = NULL;
+  free(interpreter_input);
+
+  if (report_output != stdout && report_output != dump_output) {
+    fclose(report_output);
+  }
+  if (dump_output != stdout) {
+    fclose(dump_output);
+  }
+  fclose(output);
 
   return 0;
 }
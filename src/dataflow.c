@@ -0,0 +1,332 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "node.h"
+#include "ir.h"
+#include "basic_blocks.h"
+#include "dataflow.h"
+#include "arena.h"
+
+/*
+ * Iterative bit vector dataflow analysis over the control flow graph of a
+ * function.
+ *
+ * The blocks are visited in reverse postorder for forward problems and in
+ * postorder for backward ones, so that in the absence of back edges a block
+ * is only visited after all of the blocks its input depends on. A block is
+ * revisited only when the output of one of those blocks changed, and the
+ * sweeps stop once a sweep changes nothing.
+ *
+ * Bit vectors and solutions are allocated from the optimizer arena.
+ */
+
+#define BITS_PER_WORD      (8 * sizeof(unsigned int))
+
+/***************
+ * BIT VECTORS *
+ ***************/
+
+void bit_vector_initialize(struct bit_vector *vector, int num_bits) {
+  vector->num_bits = num_bits;
+  vector->num_words = (num_bits + BITS_PER_WORD - 1) / BITS_PER_WORD;
+  vector->words = arena_allocate(&optimizer_arena, sizeof(unsigned int) * (vector->num_words + 1));
+}
+
+void bit_vector_clear_all(struct bit_vector *vector) {
+  memset(vector->words, 0, sizeof(unsigned int) * vector->num_words);
+}
+
+void bit_vector_set_all(struct bit_vector *vector) {
+  int i;
+  for(i = 0; i < vector->num_bits; i++) {
+    bit_vector_set(vector, i);
+  }
+}
+
+void bit_vector_set(struct bit_vector *vector, int bit) {
+  assert(bit >= 0 && bit < vector->num_bits);
+  vector->words[bit / BITS_PER_WORD] |= 1u << (bit % BITS_PER_WORD);
+}
+
+void bit_vector_clear(struct bit_vector *vector, int bit) {
+  assert(bit >= 0 && bit < vector->num_bits);
+  vector->words[bit / BITS_PER_WORD] &= ~(1u << (bit % BITS_PER_WORD));
+}
+
+bool bit_vector_test(struct bit_vector *vector, int bit) {
+  assert(bit >= 0 && bit < vector->num_bits);
+  return (vector->words[bit / BITS_PER_WORD] >> (bit % BITS_PER_WORD)) & 1u;
+}
+
+void bit_vector_copy(struct bit_vector *vector, struct bit_vector *other) {
+  assert(vector->num_bits == other->num_bits);
+  memcpy(vector->words, other->words, sizeof(unsigned int) * vector->num_words);
+}
+
+/* vector |= other; returns true if vector changed */
+bool bit_vector_union(struct bit_vector *vector, struct bit_vector *other) {
+  bool changed = false;
+  int i;
+  assert(vector->num_bits == other->num_bits);
+  for(i = 0; i < vector->num_words; i++) {
+    if((vector->words[i] | other->words[i]) != vector->words[i]) {
+      vector->words[i] |= other->words[i];
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+/* vector &= other; returns true if vector changed */
+bool bit_vector_intersect(struct bit_vector *vector, struct bit_vector *other) {
+  bool changed = false;
+  int i;
+  assert(vector->num_bits == other->num_bits);
+  for(i = 0; i < vector->num_words; i++) {
+    if((vector->words[i] & other->words[i]) != vector->words[i]) {
+      vector->words[i] &= other->words[i];
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+/* vector &= ~other */
+void bit_vector_subtract(struct bit_vector *vector, struct bit_vector *other) {
+  int i;
+  assert(vector->num_bits == other->num_bits);
+  for(i = 0; i < vector->num_words; i++) {
+    vector->words[i] &= ~other->words[i];
+  }
+}
+
+bool bit_vector_equal(struct bit_vector *vector, struct bit_vector *other) {
+  assert(vector->num_bits == other->num_bits);
+  return 0 == memcmp(vector->words, other->words, sizeof(unsigned int) * vector->num_words);
+}
+
+/**********
+ * SOLVER *
+ **********/
+
+static struct bit_vector *dataflow_allocate_vectors(int num_blocks, int num_bits) {
+  struct bit_vector *vectors;
+  int i;
+
+  vectors = arena_allocate(&optimizer_arena, sizeof(struct bit_vector) * (num_blocks + 1));
+  for(i = 0; i < num_blocks; i++) {
+    bit_vector_initialize(&vectors[i], num_bits);
+  }
+  return vectors;
+}
+
+struct dataflow *dataflow_create(struct control_flow_graph *cfg, int direction, int meet,
+                                 int num_bits) {
+  struct dataflow *dataflow;
+
+  assert(direction == DATAFLOW_FORWARD || direction == DATAFLOW_BACKWARD);
+  assert(meet == DATAFLOW_MEET_UNION || meet == DATAFLOW_MEET_INTERSECTION);
+
+  dataflow = arena_allocate(&optimizer_arena, sizeof(struct dataflow));
+  dataflow->direction = direction;
+  dataflow->meet = meet;
+  dataflow->num_bits = num_bits;
+  dataflow->num_blocks = cfg->num_blocks;
+  dataflow->gen = dataflow_allocate_vectors(cfg->num_blocks, num_bits);
+  dataflow->kill = dataflow_allocate_vectors(cfg->num_blocks, num_bits);
+  dataflow->in = dataflow_allocate_vectors(cfg->num_blocks, num_bits);
+  dataflow->out = dataflow_allocate_vectors(cfg->num_blocks, num_bits);
+  return dataflow;
+}
+
+/*
+ * The blocks whose output feeds the input of the given block: its
+ * predecessors in a forward problem, its successors in a backward one.
+ * Returns how many were stored in sources.
+ */
+static int dataflow_sources(struct dataflow *dataflow, struct basic_block *basic_block,
+                            struct basic_block ***sources, struct basic_block **successors) {
+  int num_successors = 0;
+
+  if(dataflow->direction == DATAFLOW_FORWARD) {
+    *sources = basic_block->predecessors;
+    return basic_block->num_predecessors;
+  }
+
+  if(basic_block->left != NULL) {
+    successors[num_successors++] = basic_block->left;
+  }
+  if(basic_block->right != NULL) {
+    successors[num_successors++] = basic_block->right;
+  }
+  *sources = successors;
+  return num_successors;
+}
+
+void dataflow_solve(struct dataflow *dataflow, struct control_flow_graph *cfg) {
+  struct basic_block **order, **sources, **targets;
+  struct basic_block *successors[2], *target_successors[2];
+  struct bit_vector *input, *output;
+  struct bit_vector result;
+  int *position;
+  bool *pending;
+  bool changed;
+  int num_sources, num_targets, i, j, number;
+
+  assert(dataflow->num_blocks == cfg->num_blocks);
+
+  /*
+   * Reverse postorder for forward problems, postorder for backward ones.
+   * Blocks that cannot be reached from the entry come last so that they get
+   * a solution as well.
+   */
+  order = arena_allocate(&optimizer_arena, sizeof(struct basic_block *) * (cfg->num_blocks + 1));
+  position = arena_allocate(&optimizer_arena, sizeof(int) * (cfg->num_blocks + 1));
+  pending = arena_allocate(&optimizer_arena, sizeof(bool) * (cfg->num_blocks + 1));
+  for(i = 0; i < cfg->num_blocks; i++) {
+    position[i] = -1;
+  }
+  for(i = 0; i < cfg->num_reachable_blocks; i++) {
+    if(dataflow->direction == DATAFLOW_FORWARD) {
+      order[i] = cfg->reverse_postorder[i];
+    } else {
+      order[i] = cfg->reverse_postorder[cfg->num_reachable_blocks - 1 - i];
+    }
+    position[order[i]->number] = i;
+  }
+  j = cfg->num_reachable_blocks;
+  for(i = 0; i < cfg->num_blocks; i++) {
+    if(position[i] == -1) {
+      order[j] = cfg->blocks[i];
+      position[i] = j++;
+    }
+  }
+
+  /* input is the side the meet is taken on, output the side after the transfer */
+  if(dataflow->direction == DATAFLOW_FORWARD) {
+    input = dataflow->in;
+    output = dataflow->out;
+  } else {
+    input = dataflow->out;
+    output = dataflow->in;
+  }
+
+  for(i = 0; i < cfg->num_blocks; i++) {
+    bit_vector_clear_all(&input[i]);
+    if(dataflow->meet == DATAFLOW_MEET_INTERSECTION) {
+      bit_vector_set_all(&output[i]);
+    } else {
+      bit_vector_clear_all(&output[i]);
+    }
+    pending[i] = true;
+  }
+
+  bit_vector_initialize(&result, dataflow->num_bits);
+  do {
+    changed = false;
+    for(i = 0; i < cfg->num_blocks; i++) {
+      if(!pending[i]) {
+        continue;
+      }
+      pending[i] = false;
+      number = order[i]->number;
+
+      num_sources = dataflow_sources(dataflow, order[i], &sources, successors);
+      if(num_sources == 0) {
+        bit_vector_clear_all(&input[number]);
+      } else {
+        bit_vector_copy(&input[number], &output[sources[0]->number]);
+        for(j = 1; j < num_sources; j++) {
+          if(dataflow->meet == DATAFLOW_MEET_UNION) {
+            bit_vector_union(&input[number], &output[sources[j]->number]);
+          } else {
+            bit_vector_intersect(&input[number], &output[sources[j]->number]);
+          }
+        }
+      }
+
+      bit_vector_copy(&result, &input[number]);
+      bit_vector_subtract(&result, &dataflow->kill[number]);
+      bit_vector_union(&result, &dataflow->gen[number]);
+      if(bit_vector_equal(&result, &output[number])) {
+        continue;
+      }
+      bit_vector_copy(&output[number], &result);
+      changed = true;
+
+      /* Revisit the blocks that read this output */
+      if(dataflow->direction == DATAFLOW_FORWARD) {
+        num_targets = 0;
+        if(order[i]->left != NULL) {
+          target_successors[num_targets++] = order[i]->left;
+        }
+        if(order[i]->right != NULL) {
+          target_successors[num_targets++] = order[i]->right;
+        }
+        targets = target_successors;
+      } else {
+        targets = order[i]->predecessors;
+        num_targets = order[i]->num_predecessors;
+      }
+      for(j = 0; j < num_targets; j++) {
+        pending[position[targets[j]->number]] = true;
+      }
+    }
+  } while(changed);
+}
+
+/************
+ * LIVENESS *
+ ************/
+
+/*
+ * Steps a set of live temporaries backwards over one instruction.
+ */
+void dataflow_live_transfer(struct bit_vector *live, struct ir_instruction *instruction) {
+  int i;
+
+  for(i = 0; i < 3; i++) {
+    if(ir_is_destination_operand(instruction, i)) {
+      bit_vector_clear(live, instruction->operands[i].data.temporary);
+    }
+  }
+  for(i = 0; i < 3; i++) {
+    if(instruction->operands[i].kind == OPERAND_TEMPORARY &&
+       !ir_is_destination_operand(instruction, i)) {
+      bit_vector_set(live, instruction->operands[i].data.temporary);
+    }
+  }
+}
+
+/*
+ * Live temporaries at the boundaries of every block. gen holds the
+ * temporaries read before they are written in the block and kill the ones
+ * the block writes.
+ */
+struct dataflow *dataflow_compute_liveness(struct control_flow_graph *cfg, int num_temporaries) {
+  struct dataflow *dataflow;
+  struct basic_block *basic_block;
+  struct ir_instruction *instruction;
+  int i, number;
+
+  dataflow = dataflow_create(cfg, DATAFLOW_BACKWARD, DATAFLOW_MEET_UNION, num_temporaries);
+  for(number = 0; number < cfg->num_blocks; number++) {
+    basic_block = cfg->blocks[number];
+    for(instruction = basic_block->end; ; instruction = instruction->prev) {
+      for(i = 0; i < 3; i++) {
+        if(ir_is_destination_operand(instruction, i)) {
+          bit_vector_set(&dataflow->kill[number], instruction->operands[i].data.temporary);
+        }
+      }
+      dataflow_live_transfer(&dataflow->gen[number], instruction);
+      if(instruction == basic_block->beginning) {
+        break;
+      }
+    }
+  }
+
+  dataflow_solve(dataflow, cfg);
+  return dataflow;
+}
@@ -0,0 +1,64 @@
+#ifndef _DATAFLOW_H
+#define _DATAFLOW_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+struct ir_instruction;
+struct control_flow_graph;
+
+#define DATAFLOW_FORWARD            1
+#define DATAFLOW_BACKWARD           2
+
+#define DATAFLOW_MEET_UNION         1
+#define DATAFLOW_MEET_INTERSECTION  2
+
+/* Bit vectors are allocated from optimizer_arena */
+struct bit_vector {
+  int num_bits;
+  int num_words;
+  unsigned int *words;
+};
+
+void bit_vector_initialize(struct bit_vector *vector, int num_bits);
+void bit_vector_clear_all(struct bit_vector *vector);
+void bit_vector_set_all(struct bit_vector *vector);
+void bit_vector_set(struct bit_vector *vector, int bit);
+void bit_vector_clear(struct bit_vector *vector, int bit);
+bool bit_vector_test(struct bit_vector *vector, int bit);
+void bit_vector_copy(struct bit_vector *vector, struct bit_vector *other);
+bool bit_vector_union(struct bit_vector *vector, struct bit_vector *other);
+bool bit_vector_intersect(struct bit_vector *vector, struct bit_vector *other);
+void bit_vector_subtract(struct bit_vector *vector, struct bit_vector *other);
+bool bit_vector_equal(struct bit_vector *vector, struct bit_vector *other);
+
+/*
+ * A gen/kill problem over the blocks of a control flow graph. The client
+ * fills in gen and kill for every block (indexed by block number), and
+ * dataflow_solve computes in and out so that, for a forward problem,
+ *
+ *   in[b]  = meet of out[p] over the predecessors p of b
+ *   out[b] = gen[b] | (in[b] - kill[b])
+ *
+ * and symmetrically for a backward problem. Nothing flows into the entry
+ * block of a forward problem or out of the exit blocks of a backward one.
+ */
+struct dataflow {
+  int direction;
+  int meet;
+  int num_bits;
+  int num_blocks;
+  struct bit_vector *gen, *kill;
+  struct bit_vector *in, *out;
+};
+
+struct dataflow *dataflow_create(struct control_flow_graph *cfg, int direction, int meet,
+                                 int num_bits);
+
+void dataflow_solve(struct dataflow *dataflow, struct control_flow_graph *cfg);
+
+void dataflow_live_transfer(struct bit_vector *live, struct ir_instruction *instruction);
+
+struct dataflow *dataflow_compute_liveness(struct control_flow_graph *cfg, int num_temporaries);
+
+#endif /* _DATAFLOW_H */
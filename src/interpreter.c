@@ -0,0 +1,780 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <string.h>
+
+#include "node.h"
+#include "symbol.h"
+#include "type.h"
+#include "ir.h"
+#include "string_pool.h"
+#include "interpreter.h"
+
+/*
+ * An interpreter for the IR of a whole program.
+ *
+ * Values are 32-bit words with the same meaning they have in the MIPS the
+ * backend emits: multiply, divide and remainder are unsigned, comparisons
+ * are signed and right shifts are arithmetic. Memory is a single block of
+ * little-endian bytes. String literals and file scope variables are placed
+ * at its bottom when they are first used, and the stack grows down from its
+ * top.
+ *
+ * Every call gets a frame laid out like the one mips_print_function builds:
+ * BEGINNING_STACK_OFFSET reserved bytes followed by the locals, so that a
+ * symbol lives at frame pointer + BEGINNING_STACK_OFFSET + stack_offset. The
+ * reserved part holds the parameter save area, where the arguments passed
+ * with IR_FUNCTION_PARAMETER are stored on entry; that is where the negative
+ * stack offsets of parameters point. A frame also has its own copy of the
+ * temporaries of the function. IR_RETURN sets a single result word, read
+ * back by the IR_RESULTWORD after the call, just like $v0.
+ *
+ * The builtins are the syscalls the backend knows about: print_int,
+ * print_string, read_int, read_string and exit.
+ */
+
+#define INTERPRETER_MEMORY_BASE      0x10000000u
+#define INTERPRETER_MEMORY_SIZE        0x400000u
+
+/* Arguments beyond these would not fit in the reserved part of the frame */
+#define INTERPRETER_MAX_PARAMETERS   16
+
+#define PARAMETER_SAVE_OFFSET(n)     (4 + 4 * (n))
+
+#define MAX_INPUT_LINE_LENGTH        1024
+
+#define BUILTIN_NONE                  0
+#define BUILTIN_PRINT_INT             1
+#define BUILTIN_PRINT_STRING          2
+#define BUILTIN_READ_INT              3
+#define BUILTIN_READ_STRING           4
+#define BUILTIN_EXIT                  5
+
+static struct {
+  char *name;
+  int builtin;
+} builtins[] = {
+  { "print_int",    BUILTIN_PRINT_INT },
+  { "print_string", BUILTIN_PRINT_STRING },
+  { "read_int",     BUILTIN_READ_INT },
+  { "read_string",  BUILTIN_READ_STRING },
+  { "exit",         BUILTIN_EXIT },
+  { NULL, BUILTIN_NONE }
+};
+
+/*
+ * A function of the program, or a builtin, found by the string pool handle
+ * of its name. The temporaries of a function are numbered from
+ * first_temporary on.
+ */
+struct interpreter_function {
+  const char *name;
+  struct ir_instruction *begin;
+  int builtin;
+  int frame_size;
+  int first_temporary;
+  int num_temporaries;
+};
+
+struct interpreter_frame {
+  struct interpreter_function *function;
+  struct ir_instruction *call;
+  unsigned int frame_pointer;
+  int temporaries;
+};
+
+/* The program being run */
+static struct interpreter_function *functions;
+static int num_functions;
+static struct ir_instruction **labels;
+static int num_labels;
+
+/* Where string literals and file scope variables were placed, by handle */
+static unsigned int *string_addresses;
+static unsigned int *global_addresses;
+static int num_addresses;
+
+static unsigned char *memory;
+static unsigned int data_size;
+static unsigned int stack_pointer;
+
+static struct interpreter_frame *frames, *frame;
+static int num_frames, max_frames;
+
+static unsigned int *temporaries;
+static int num_temporary_values, max_temporary_values;
+
+static unsigned int arguments[INTERPRETER_MAX_PARAMETERS];
+static int num_arguments;
+static unsigned int result_word;
+
+static const char *input;
+static int input_length, input_position;
+
+static struct interpreter_result *result;
+static int max_output_length;
+static bool running;
+
+/**********
+ * ERRORS *
+ **********/
+
+static void interpreter_error(int error, const char *format, ...) {
+  va_list arguments_of_format;
+
+  va_start(arguments_of_format, format);
+  vsnprintf(result->message, sizeof(result->message), format, arguments_of_format);
+  va_end(arguments_of_format);
+  result->status = INTERPRETER_RUNTIME_ERROR;
+  result->error = error;
+  running = false;
+}
+
+/*********************
+ * PREPARING THE RUN *
+ *********************/
+
+static int interpreter_name_handle(const char *name) {
+  return string_pool_intern(name, strlen(name));
+}
+
+/*
+ * The frame size and the temporaries of the function that starts at begin.
+ * Like mips_print_function, every scope of the function starts at the same
+ * offset, so the largest one decides.
+ */
+static void interpreter_scan_function(struct interpreter_function *function,
+                                      struct ir_instruction *begin) {
+  struct ir_instruction *instruction;
+  struct symbol_table *table;
+  int bytes_for_locals = 0;
+  int last_temporary = -1;
+  int i;
+
+  function->begin = begin;
+  function->first_temporary = -1;
+  for(instruction = begin->next;
+      instruction != NULL && instruction->kind != IR_FUNCTION_END;
+      instruction = instruction->next) {
+    if(instruction->kind == IR_ADDRESS_OF && instruction->operands[1].kind == OPERAND_IDENTIFIER) {
+      table = instruction->operands[1].data.symbol->owner_symbol_table;
+      if(table->type_of_symbol_table != FILE_SCOPE_SYMBOL_TABLE &&
+         table->total_stack_offset > bytes_for_locals) {
+        bytes_for_locals = table->total_stack_offset;
+      }
+    }
+    for(i = 0; i < 3; i++) {
+      if(instruction->operands[i].kind != OPERAND_TEMPORARY) {
+        continue;
+      }
+      if(function->first_temporary == -1 ||
+         instruction->operands[i].data.temporary < function->first_temporary) {
+        function->first_temporary = instruction->operands[i].data.temporary;
+      }
+      if(instruction->operands[i].data.temporary > last_temporary) {
+        last_temporary = instruction->operands[i].data.temporary;
+      }
+    }
+  }
+
+  function->frame_size = (((BEGINNING_STACK_OFFSET + bytes_for_locals + 7) >> 3) << 3);
+  if(function->first_temporary == -1) {
+    function->first_temporary = 0;
+    function->num_temporaries = 0;
+  } else {
+    function->num_temporaries = last_temporary - function->first_temporary + 1;
+  }
+}
+
+/*
+ * Finds the functions and labels of the program. The names of the functions
+ * and the builtins are interned first, so that every handle looked up during
+ * the run is covered by the tables.
+ */
+static void interpreter_prepare(struct ir_section *section) {
+  struct ir_instruction *instruction;
+  int i, handle, max_label = -1;
+
+  for(i = 0; builtins[i].name != NULL; i++) {
+    interpreter_name_handle(builtins[i].name);
+  }
+  for(instruction = section->first; instruction != section->last->next;
+      instruction = instruction->next) {
+    if(instruction->kind == IR_FUNCTION_BEGIN) {
+      interpreter_name_handle(instruction->operands[0].data.symbol->name);
+    } else if(instruction->kind == IR_GENERATED_LABEL &&
+              instruction->operands[0].data.generated_label > max_label) {
+      max_label = instruction->operands[0].data.generated_label;
+    }
+  }
+
+  num_functions = string_pool_count();
+  functions = calloc(num_functions + 1, sizeof(struct interpreter_function));
+  assert(NULL != functions);
+  num_labels = max_label + 1;
+  labels = calloc(num_labels + 1, sizeof(struct ir_instruction *));
+  assert(NULL != labels);
+
+  for(i = 0; builtins[i].name != NULL; i++) {
+    handle = interpreter_name_handle(builtins[i].name);
+    functions[handle].name = builtins[i].name;
+    functions[handle].builtin = builtins[i].builtin;
+  }
+  for(instruction = section->first; instruction != section->last->next;
+      instruction = instruction->next) {
+    if(instruction->kind == IR_FUNCTION_BEGIN) {
+      handle = interpreter_name_handle(instruction->operands[0].data.symbol->name);
+      functions[handle].name = instruction->operands[0].data.symbol->name;
+      functions[handle].builtin = BUILTIN_NONE;
+      interpreter_scan_function(&functions[handle], instruction);
+    } else if(instruction->kind == IR_GENERATED_LABEL) {
+      labels[instruction->operands[0].data.generated_label] = instruction;
+    }
+  }
+}
+
+/**********
+ * MEMORY *
+ **********/
+
+/* Returns NULL after reporting the error if the access is not allowed */
+static unsigned char *interpreter_memory(unsigned int address, unsigned int size) {
+  if(address < INTERPRETER_MEMORY_BASE ||
+     address - INTERPRETER_MEMORY_BASE > INTERPRETER_MEMORY_SIZE - size) {
+    interpreter_error(INTERPRETER_BAD_ACCESS, "bad memory access at 0x%08x in %s",
+                      address, frame->function->name);
+    return NULL;
+  }
+  if((address % size) != 0) {
+    interpreter_error(INTERPRETER_BAD_ACCESS, "unaligned memory access at 0x%08x in %s",
+                      address, frame->function->name);
+    return NULL;
+  }
+  return &memory[address - INTERPRETER_MEMORY_BASE];
+}
+
+static unsigned int interpreter_load(unsigned int address, int size, bool sign_extend) {
+  unsigned char *bytes = interpreter_memory(address, size);
+  unsigned int value = 0;
+  int i;
+
+  if(NULL == bytes) {
+    return 0;
+  }
+  for(i = size - 1; i >= 0; i--) {
+    value = (value << 8) | bytes[i];
+  }
+  if(sign_extend && size < 4 && (value & (1u << (8 * size - 1)))) {
+    value |= ~0u << (8 * size);
+  }
+  return value;
+}
+
+static void interpreter_store(unsigned int address, int size, unsigned int value) {
+  unsigned char *bytes = interpreter_memory(address, size);
+  int i;
+
+  if(NULL == bytes) {
+    return;
+  }
+  for(i = 0; i < size; i++) {
+    bytes[i] = (unsigned char)(value >> (8 * i));
+  }
+}
+
+/* Places size bytes at the bottom of memory and returns their address */
+static unsigned int interpreter_place_data(const char *bytes, unsigned int size) {
+  unsigned int address;
+
+  data_size = (data_size + 3) & ~3u;
+  if(INTERPRETER_MEMORY_BASE + data_size + size > stack_pointer) {
+    interpreter_error(INTERPRETER_OUT_OF_MEMORY, "out of memory for data");
+    return 0;
+  }
+  address = INTERPRETER_MEMORY_BASE + data_size;
+  if(NULL != bytes) {
+    memcpy(&memory[data_size], bytes, size);
+  }
+  data_size += size;
+  return address;
+}
+
+static unsigned int interpreter_string_address(int string_label) {
+  assert(string_label >= 0 && string_label < num_addresses);
+  if(0 == string_addresses[string_label]) {
+    string_addresses[string_label] =
+      interpreter_place_data(string_pool_text(string_label), string_pool_length(string_label) + 1);
+  }
+  return string_addresses[string_label];
+}
+
+static unsigned int interpreter_symbol_address(struct symbol *symbol) {
+  int handle;
+
+  if(symbol->owner_symbol_table->type_of_symbol_table != FILE_SCOPE_SYMBOL_TABLE) {
+    return frame->frame_pointer + BEGINNING_STACK_OFFSET + symbol->stack_offset;
+  }
+  handle = interpreter_name_handle(symbol->name);
+  assert(handle < num_addresses);
+  if(0 == global_addresses[handle]) {
+    global_addresses[handle] = interpreter_place_data(NULL, type_size(symbol->result.type));
+  }
+  return global_addresses[handle];
+}
+
+/*****************
+ * INPUT, OUTPUT *
+ *****************/
+
+static void interpreter_output(const char *text, int length) {
+  if(result->output_length + length > max_output_length) {
+    max_output_length = 2 * (result->output_length + length);
+    result->output = realloc(result->output, max_output_length);
+    assert(NULL != result->output);
+  }
+  memcpy(result->output + result->output_length, text, length);
+  result->output_length += length;
+}
+
+/* Reads a line of at most length - 1 characters, like fgets */
+static void interpreter_read_line(char *buffer, int length) {
+  int i = 0;
+
+  while(i < length - 1 && input_position < input_length) {
+    buffer[i] = input[input_position++];
+    if(buffer[i++] == '\n') {
+      break;
+    }
+  }
+  buffer[i] = '\0';
+}
+
+static void interpreter_call_builtin(struct interpreter_function *function) {
+  char buffer[MAX_INPUT_LINE_LENGTH];
+  unsigned int address;
+  int length, i;
+
+  switch(function->builtin) {
+    case BUILTIN_PRINT_INT:
+      length = sprintf(buffer, "%d", (int)arguments[0]);
+      interpreter_output(buffer, length);
+      break;
+    case BUILTIN_PRINT_STRING:
+      for(address = arguments[0]; running; address++) {
+        buffer[0] = (char)interpreter_load(address, 1, false);
+        if(buffer[0] == '\0') {
+          break;
+        }
+        interpreter_output(buffer, 1);
+      }
+      break;
+    case BUILTIN_READ_INT:
+      interpreter_read_line(buffer, sizeof(buffer));
+      result_word = (unsigned int)strtol(buffer, NULL, 10);
+      break;
+    case BUILTIN_READ_STRING:
+      length = (int)arguments[1] < (int)sizeof(buffer) ? (int)arguments[1] : (int)sizeof(buffer);
+      if(length <= 0) {
+        break;
+      }
+      interpreter_read_line(buffer, length);
+      for(i = 0; running && i <= (int)strlen(buffer); i++) {
+        interpreter_store(arguments[0] + i, 1, (unsigned char)buffer[i]);
+      }
+      break;
+    case BUILTIN_EXIT:
+      /* The exit syscall takes no status */
+      result->exit_code = 0;
+      running = false;
+      break;
+    default:
+      assert(0);
+      break;
+  }
+}
+
+/*********
+ * CALLS *
+ *********/
+
+static void interpreter_enter(struct interpreter_function *function, struct ir_instruction *call) {
+  int i;
+
+  if(stack_pointer - function->frame_size < INTERPRETER_MEMORY_BASE + data_size) {
+    interpreter_error(INTERPRETER_OUT_OF_MEMORY, "stack overflow in %s", function->name);
+    return;
+  }
+
+  if(num_frames == max_frames) {
+    max_frames = max_frames == 0 ? 64 : 2 * max_frames;
+    frames = realloc(frames, sizeof(struct interpreter_frame) * max_frames);
+    assert(NULL != frames);
+  }
+  if(num_temporary_values + function->num_temporaries > max_temporary_values) {
+    max_temporary_values = 2 * (num_temporary_values + function->num_temporaries);
+    temporaries = realloc(temporaries, sizeof(unsigned int) * max_temporary_values);
+    assert(NULL != temporaries);
+  }
+
+  frame = &frames[num_frames++];
+  frame->function = function;
+  frame->call = call;
+  frame->temporaries = num_temporary_values;
+  memset(&temporaries[num_temporary_values], 0, sizeof(unsigned int) * function->num_temporaries);
+  num_temporary_values += function->num_temporaries;
+
+  stack_pointer -= function->frame_size;
+  frame->frame_pointer = stack_pointer;
+  memset(&memory[stack_pointer - INTERPRETER_MEMORY_BASE], 0, function->frame_size);
+  for(i = 0; i < num_arguments; i++) {
+    interpreter_store(frame->frame_pointer + PARAMETER_SAVE_OFFSET(i), 4, arguments[i]);
+  }
+  num_arguments = 0;
+}
+
+/* Returns the call the frame was entered from, or NULL when main returns */
+static struct ir_instruction *interpreter_leave(void) {
+  struct ir_instruction *call = frame->call;
+
+  stack_pointer += frame->function->frame_size;
+  num_temporary_values = frame->temporaries;
+  num_frames--;
+  frame = num_frames > 0 ? &frames[num_frames - 1] : NULL;
+  return call;
+}
+
+/*************
+ * EXECUTION *
+ *************/
+
+static unsigned int *interpreter_temporary(struct ir_operand *operand) {
+  int temporary;
+
+  assert(OPERAND_TEMPORARY == operand->kind);
+  temporary = operand->data.temporary - frame->function->first_temporary;
+  assert(temporary >= 0 && temporary < frame->function->num_temporaries);
+  return &temporaries[frame->temporaries + temporary];
+}
+
+#define SOURCE(position)       (*interpreter_temporary(&instruction->operands[position]))
+#define SIGNED_SOURCE(position) ((int)SOURCE(position))
+#define DESTINATION            (*interpreter_temporary(&instruction->operands[0]))
+
+static struct ir_instruction *interpreter_label(struct ir_operand *operand) {
+  assert(OPERAND_GENERATED_LABEL == operand->kind);
+  assert(operand->data.generated_label < num_labels);
+  assert(NULL != labels[operand->data.generated_label]);
+  return labels[operand->data.generated_label];
+}
+
+/*
+ * Runs the program from main until main returns, exit is called, an error
+ * occurs or INTERPRETER_MAX_STEPS instructions have been executed.
+ */
+static void interpreter_execute(void) {
+  struct ir_instruction *instruction, *next, *call;
+  struct interpreter_function *function, *entered;
+  char buffer[16];
+  unsigned int value;
+  int handle, length;
+
+  handle = interpreter_name_handle("main");
+  if(handle >= num_functions || NULL == functions[handle].begin) {
+    interpreter_error(INTERPRETER_BAD_PROGRAM, "the program has no main function");
+    return;
+  }
+  entered = &functions[handle];
+  instruction = entered->begin;
+  call = NULL;
+
+  running = true;
+  while(running) {
+    if(result->num_instructions == INTERPRETER_MAX_STEPS) {
+      result->status = INTERPRETER_STEP_LIMIT;
+      snprintf(result->message, sizeof(result->message),
+               "stopped after %lu instructions", INTERPRETER_MAX_STEPS);
+      break;
+    }
+    result->num_instructions++;
+    result->counts[instruction->kind]++;
+    next = instruction->next;
+
+    switch(instruction->kind) {
+      case IR_NO_OPERATION:
+      case IR_GENERATED_LABEL:
+        break;
+
+      case IR_FUNCTION_BEGIN:
+        assert(entered->begin == instruction);
+        interpreter_enter(entered, call);
+        break;
+      case IR_FUNCTION_END:
+        next = interpreter_leave();
+        if(NULL == next) {
+          result->exit_code = (int)result_word;
+          running = false;
+        } else {
+          next = next->next;
+        }
+        break;
+      case IR_FUNCTION_PARAMETER:
+        if(instruction->operands[0].data.number >= INTERPRETER_MAX_PARAMETERS) {
+          interpreter_error(INTERPRETER_BAD_PROGRAM, "too many arguments in %s", frame->function->name);
+          break;
+        }
+        arguments[instruction->operands[0].data.number] = SOURCE(1);
+        if((int)instruction->operands[0].data.number + 1 > num_arguments) {
+          num_arguments = instruction->operands[0].data.number + 1;
+        }
+        break;
+      case IR_FUNCTION_CALL:
+        handle = interpreter_name_handle(instruction->operands[0].data.symbol->name);
+        function = handle < num_functions ? &functions[handle] : NULL;
+        if(NULL == function || (NULL == function->begin && function->builtin == BUILTIN_NONE)) {
+          interpreter_error(INTERPRETER_BAD_PROGRAM, "call to undefined function %s",
+                            instruction->operands[0].data.symbol->name);
+        } else if(function->builtin != BUILTIN_NONE) {
+          interpreter_call_builtin(function);
+          num_arguments = 0;
+        } else {
+          entered = function;
+          call = instruction;
+          next = function->begin;
+        }
+        break;
+      case IR_RESULTWORD:
+        DESTINATION = result_word;
+        break;
+      case IR_RETURN:
+        if(instruction->operands[0].kind == OPERAND_TEMPORARY) {
+          result_word = SOURCE(0);
+        }
+        break;
+
+      case IR_GOTO:
+        next = interpreter_label(&instruction->operands[0]);
+        break;
+      case IR_GOTO_IF_FALSE:
+        if(SOURCE(0) == 0) {
+          next = interpreter_label(&instruction->operands[1]);
+        }
+        break;
+      case IR_GOTO_IF_TRUE:
+        if(SOURCE(0) != 0) {
+          next = interpreter_label(&instruction->operands[1]);
+        }
+        break;
+
+      case IR_LOAD_IMMEDIATE:
+        DESTINATION = (unsigned int)instruction->operands[1].data.number;
+        break;
+      case IR_COPY:
+        DESTINATION = SOURCE(1);
+        break;
+      case IR_ADDRESS_OF:
+        if(instruction->operands[1].kind == OPERAND_IDENTIFIER) {
+          DESTINATION = interpreter_symbol_address(instruction->operands[1].data.symbol);
+        } else {
+          assert(instruction->operands[1].kind == OPERAND_STRING);
+          DESTINATION = interpreter_string_address(instruction->operands[1].data.string_label);
+        }
+        break;
+      case IR_LOAD_WORD:
+        DESTINATION = interpreter_load(SOURCE(1), 4, false);
+        break;
+      case IR_LOAD_SIGNED_HALFWORD:
+        DESTINATION = interpreter_load(SOURCE(1), 2, true);
+        break;
+      case IR_LOAD_SIGNED_BYTE:
+        DESTINATION = interpreter_load(SOURCE(1), 1, true);
+        break;
+      case IR_STORE_WORD:
+        interpreter_store(SOURCE(0), 4, SOURCE(1));
+        break;
+      case IR_STORE_SIGNED_HALFWORD:
+        interpreter_store(SOURCE(0), 2, SOURCE(1));
+        break;
+      case IR_STORE_SIGNED_BYTE:
+        interpreter_store(SOURCE(0), 1, SOURCE(1));
+        break;
+
+      case IR_PRINT_NUMBER:
+        length = sprintf(buffer, "%d\n", SIGNED_SOURCE(0));
+        interpreter_output(buffer, length);
+        break;
+
+      case IR_ADD:
+        DESTINATION = SOURCE(1) + SOURCE(2);
+        break;
+      case IR_SUBTRACT:
+        DESTINATION = SOURCE(1) - SOURCE(2);
+        break;
+      case IR_MULTIPLY:
+        DESTINATION = SOURCE(1) * SOURCE(2);
+        break;
+      case IR_MULTIPLY_HIGH:
+        DESTINATION = (unsigned int)(((unsigned long long)SOURCE(1) * SOURCE(2)) >> 32);
+        break;
+      case IR_DIVIDE:
+      case IR_REMAINDER:
+        value = SOURCE(2);
+        if(value == 0) {
+          interpreter_error(INTERPRETER_DIVISION_BY_ZERO, "division by zero in %s", frame->function->name);
+          break;
+        }
+        DESTINATION = instruction->kind == IR_DIVIDE ? SOURCE(1) / value : SOURCE(1) % value;
+        break;
+      case IR_LESS_THAN:
+        DESTINATION = SIGNED_SOURCE(1) < SIGNED_SOURCE(2);
+        break;
+      case IR_LESS_THAN_OR_EQ_TO:
+        DESTINATION = SIGNED_SOURCE(1) <= SIGNED_SOURCE(2);
+        break;
+      case IR_GREATER_THAN:
+        DESTINATION = SIGNED_SOURCE(1) > SIGNED_SOURCE(2);
+        break;
+      case IR_GREATER_THAN_OR_EQ_TO:
+        DESTINATION = SIGNED_SOURCE(1) >= SIGNED_SOURCE(2);
+        break;
+      case IR_EQUAL_TO:
+        DESTINATION = SOURCE(1) == SOURCE(2);
+        break;
+      case IR_NOT_EQUAL_TO:
+        DESTINATION = SOURCE(1) != SOURCE(2);
+        break;
+      case IR_SHIFT_LEFT:
+        DESTINATION = SOURCE(1) << (SOURCE(2) & 31);
+        break;
+      case IR_SHIFT_RIGHT:
+        DESTINATION = (unsigned int)(SIGNED_SOURCE(1) >> (SOURCE(2) & 31));
+        break;
+      case IR_SHIFT_RIGHT_LOGICAL:
+        DESTINATION = SOURCE(1) >> (SOURCE(2) & 31);
+        break;
+      case IR_BITWISE_OR:
+        DESTINATION = SOURCE(1) | SOURCE(2);
+        break;
+      case IR_BITWISE_XOR:
+        DESTINATION = SOURCE(1) ^ SOURCE(2);
+        break;
+      case IR_BITWISE_AND:
+        DESTINATION = SOURCE(1) & SOURCE(2);
+        break;
+      case IR_BITWISE_NOT:
+        DESTINATION = ~SOURCE(1);
+        break;
+      case IR_LOGICAL_NOT:
+        DESTINATION = SOURCE(1) == 0;
+        break;
+      case IR_NEGATION:
+        DESTINATION = -SOURCE(1);
+        break;
+
+      case IR_CAST_TO_U_WORD:
+      case IR_CAST_TO_S_WORD:
+        DESTINATION = SOURCE(1);
+        break;
+      case IR_CAST_TO_U_HALFWORD:
+      case IR_CAST_HWORD_TO_U_WORD:
+      case IR_CAST_WORD_TO_U_HWORD:
+        DESTINATION = SOURCE(1) & 0xffffu;
+        break;
+      case IR_CAST_TO_S_HALFWORD:
+      case IR_CAST_HWORD_TO_S_WORD:
+      case IR_CAST_WORD_TO_S_HWORD:
+        DESTINATION = (unsigned int)(int)(short)SOURCE(1);
+        break;
+      case IR_CAST_TO_U_BYTE:
+      case IR_CAST_WORD_TO_U_BYTE:
+      case IR_CAST_HWORD_TO_U_BYTE:
+      case IR_CAST_BYTE_TO_U_WORD:
+      case IR_CAST_BYTE_TO_U_HWORD:
+        DESTINATION = SOURCE(1) & 0xffu;
+        break;
+      case IR_CAST_TO_S_BYTE:
+      case IR_CAST_WORD_TO_S_BYTE:
+      case IR_CAST_HWORD_TO_S_BYTE:
+      case IR_CAST_BYTE_TO_S_WORD:
+      case IR_CAST_BYTE_TO_S_HWORD:
+        DESTINATION = (unsigned int)(int)(signed char)SOURCE(1);
+        break;
+
+      default:
+        interpreter_error(INTERPRETER_BAD_PROGRAM, "unsupported instruction %s in %s", ir_opcode_name(instruction->kind),
+                          frame->function->name);
+        break;
+    }
+    instruction = next;
+  }
+}
+
+/*
+ * Runs the program and fills in result, which interpreter_release_result
+ * frees again. Nothing the program does can stop the compiler; errors are
+ * reported through the status and message of the result.
+ */
+void interpreter_run(struct ir_section *section, const char *input_of_program,
+                     int length_of_input, struct interpreter_result *result_of_run) {
+  memset(result_of_run, 0, sizeof(struct interpreter_result));
+  result = result_of_run;
+  result->status = INTERPRETER_OK;
+  max_output_length = 0;
+
+  input = input_of_program;
+  input_length = length_of_input;
+  input_position = 0;
+
+  interpreter_prepare(section);
+  num_addresses = string_pool_count();
+  string_addresses = calloc(num_addresses + 1, sizeof(unsigned int));
+  global_addresses = calloc(num_addresses + 1, sizeof(unsigned int));
+  memory = calloc(INTERPRETER_MEMORY_SIZE, 1);
+  assert(NULL != string_addresses && NULL != global_addresses && NULL != memory);
+  data_size = 0;
+  stack_pointer = INTERPRETER_MEMORY_BASE + INTERPRETER_MEMORY_SIZE;
+  frame = NULL;
+  num_frames = 0;
+  num_temporary_values = 0;
+  num_arguments = 0;
+  result_word = 0;
+
+  interpreter_execute();
+
+  free(functions);
+  free(labels);
+  free(string_addresses);
+  free(global_addresses);
+  free(memory);
+  free(frames);
+  free(temporaries);
+  functions = NULL;
+  labels = NULL;
+  string_addresses = global_addresses = NULL;
+  memory = NULL;
+  frames = frame = NULL;
+  temporaries = NULL;
+  max_frames = max_temporary_values = 0;
+  result = NULL;
+}
+
+/*
+ * True if two runs printed the same output and stopped the same way, down
+ * to the kind of error that stopped them.
+ */
+bool interpreter_same_behavior(struct interpreter_result *left, struct interpreter_result *right) {
+  return left->status == right->status && left->error == right->error &&
+    left->exit_code == right->exit_code &&
+    left->output_length == right->output_length &&
+    (left->output_length == 0 || 0 == memcmp(left->output, right->output, left->output_length));
+}
+
+bool interpreter_is_comparable(struct interpreter_result *reference) {
+  return reference->status == INTERPRETER_OK;
+}
+
+void interpreter_release_result(struct interpreter_result *result_of_run) {
+  free(result_of_run->output);
+  result_of_run->output = NULL;
+  result_of_run->output_length = 0;
+}
@@ -0,0 +1,54 @@
+#ifndef _INTERPRETER_H
+#define _INTERPRETER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "ir.h"
+
+/*
+ * Executes the IR of a whole program, starting at main, without going through
+ * the MIPS backend. The program reads its input from a buffer and its output
+ * is collected in another one, so the same program can be run after every
+ * optimization pass and the runs compared.
+ */
+
+#define INTERPRETER_OK              0
+#define INTERPRETER_RUNTIME_ERROR   1
+#define INTERPRETER_STEP_LIMIT      2
+
+/* What stopped a run with INTERPRETER_RUNTIME_ERROR */
+#define INTERPRETER_NO_ERROR          0
+#define INTERPRETER_BAD_ACCESS        1
+#define INTERPRETER_DIVISION_BY_ZERO  2
+#define INTERPRETER_OUT_OF_MEMORY     3
+#define INTERPRETER_BAD_PROGRAM       4
+
+/* Runs stop with INTERPRETER_STEP_LIMIT after this many instructions */
+#define INTERPRETER_MAX_STEPS       100000000UL
+
+struct interpreter_result {
+  int status;
+  int error;
+  int exit_code;
+  char message[128];
+
+  /* Everything the program printed; not NUL-terminated */
+  char *output;
+  int output_length;
+
+  unsigned long num_instructions;
+  unsigned long counts[IR_NUM_KINDS];
+};
+
+void interpreter_run(struct ir_section *section, const char *input, int input_length,
+                     struct interpreter_result *result);
+
+bool interpreter_same_behavior(struct interpreter_result *left, struct interpreter_result *right);
+
+/* Only a run that exited normally can tell whether another one behaves the same */
+bool interpreter_is_comparable(struct interpreter_result *reference);
+
+void interpreter_release_result(struct interpreter_result *result);
+
+#endif /* _INTERPRETER_H */
@@ -7,8 +7,11 @@
 #include "symbol.h"
 #include "type.h"
 #include "ir.h"
+#include "string_pool.h"
+#include "arena.h"
 
 int ir_generation_num_errors;
+unsigned long ir_num_instructions_created;
 
 int next_temporary;
 
@@ -30,7 +33,7 @@ int next_temporary;
  */
 struct ir_section *ir_section(struct ir_instruction *first, struct ir_instruction *last) {
   struct ir_section *code;
-  code = malloc(sizeof(struct ir_section));
+  code = arena_allocate(&ir_arena, sizeof(struct ir_section));
   assert(NULL != code);
 
   code->first = first;
@@ -38,6 +41,30 @@ struct ir_section *ir_section(struct ir_instruction *first, struct ir_instructio
   return code;
 }
 
+/*
+ * Returns true if the operand at the given position is written by the
+ * instruction rather than read. Only operand 0 is ever a destination.
+ */
+bool ir_is_destination_operand(struct ir_instruction *instruction, int position) {
+  if(position != 0 || instruction->operands[0].kind != OPERAND_TEMPORARY) {
+    return false;
+  }
+  switch(instruction->kind) {
+    case IR_STORE_WORD:
+    case IR_STORE_SIGNED_BYTE:
+    case IR_STORE_SIGNED_HALFWORD:
+    case IR_GOTO_IF_FALSE:
+    case IR_GOTO_IF_TRUE:
+    case IR_BIFEQZ:
+    case IR_BIFNOTEQZ:
+    case IR_RETURN:
+    case IR_PRINT_NUMBER:
+      return false;
+    default:
+      return true;
+  }
+}
+
 struct ir_section *ir_copy(struct ir_section *orig) {
   return ir_section(orig->first, orig->last);
 }
@@ -84,8 +111,9 @@ static struct ir_section *ir_append(struct ir_section *section,
 struct ir_instruction *ir_instruction(int kind) {
   struct ir_instruction *instruction;
 
-  instruction = malloc(sizeof(struct ir_instruction));
+  instruction = arena_allocate(&ir_arena, sizeof(struct ir_instruction));
   assert(NULL != instruction);
+  ir_num_instructions_created++;
 
   instruction->kind = kind;
 
@@ -134,11 +162,9 @@ static void assign_stack_offsets_to_variables(struct node *identifier) {
 }
 
 static void ir_operand_identifier(struct ir_instruction *instruction, int position, struct node *identifier) {
+  assert(NULL != identifier->data.identifier.symbol);
   instruction->operands[position].kind = OPERAND_IDENTIFIER;
-  strncpy(instruction->operands[position].data.identifier.identifier_name, identifier->data.identifier.name,
-          MAX_IDENTIFIER_LENGTH);
-
-  instruction->operands[position].data.identifier.symbol = identifier->data.identifier.symbol;
+  instruction->operands[position].data.symbol = identifier->data.identifier.symbol;
   assign_stack_offsets_to_variables(identifier);
 }
 
@@ -155,12 +181,9 @@ static void ir_generate_label(struct ir_instruction *instruction) {
 
 static void ir_generate_string_label(struct ir_instruction **instruction,
                                      struct node *string) {
-  static int next_generated_string_label;
   ir_operand_temporary((*instruction), 0);
   (*instruction)->operands[1].kind = OPERAND_STRING;
-  (*instruction)->operands[1].data.string_label.generated_label = next_generated_string_label++;
-  strncpy((*instruction)->operands[1].data.string_label.name, string->data.string.name,
-      MAX_STRING_LENGTH);
+  (*instruction)->operands[1].data.string_label = string->data.string.name;
 }
 
 /* static void ir_operand_generated_label(struct ir_instruction *instruction, int position) { */
@@ -513,124 +536,108 @@ void ir_generate_for_ternary_operation(struct node *ternary_operation) {
     ternary_operation->data.ternary_operation.result.ir_operand->lvalue = false;
 }
 
+/*
+ * Generates the IR that branches to label when the condition is true, for
+ * IR_GOTO_IF_TRUE, or false, for IR_GOTO_IF_FALSE, and falls through
+ * otherwise. &&, || and ! become branches between their operands, so a
+ * condition never materializes a boolean for them: in a && b that branches
+ * when false, either operand alone can take the branch, while a && b that
+ * branches when true has to skip the test of b as soon as a is false.
+ */
+static struct ir_section *ir_generate_for_condition(struct node *condition, int branch_kind,
+                                                    struct ir_instruction *label) {
+    struct ir_section *section;
+    struct ir_instruction *branch_instruction, *skip_label_instruction;
+    struct node *left, *right;
+    int operation, inverse_kind;
+
+    assert((branch_kind == IR_GOTO_IF_TRUE) || (branch_kind == IR_GOTO_IF_FALSE));
+    inverse_kind = (branch_kind == IR_GOTO_IF_TRUE) ? IR_GOTO_IF_FALSE : IR_GOTO_IF_TRUE;
+
+    if(NODE_UNARY_OPERATION == condition->kind &&
+       UNARYOP_LOGICAL_NOT == condition->data.unary_operation.operation) {
+        return ir_generate_for_condition(condition->data.unary_operation.the_operand,
+                                         inverse_kind, label);
+    }
+
+    if(NODE_BINARY_OPERATION == condition->kind) {
+        operation = condition->data.binary_operation.operation;
+        left = condition->data.binary_operation.left_operand;
+        right = condition->data.binary_operation.right_operand;
+
+        if((operation == BINOP_LOGICAL_AND_EXPR && branch_kind == IR_GOTO_IF_FALSE) ||
+           (operation == BINOP_LOGICAL_OR_EXPR && branch_kind == IR_GOTO_IF_TRUE)) {
+            section = ir_generate_for_condition(left, branch_kind, label);
+            return ir_concatenate(section, ir_generate_for_condition(right, branch_kind, label));
+        }
+        if(operation == BINOP_LOGICAL_AND_EXPR || operation == BINOP_LOGICAL_OR_EXPR) {
+            skip_label_instruction = ir_instruction(IR_GENERATED_LABEL);
+            ir_generate_label(skip_label_instruction);
+
+            section = ir_generate_for_condition(left, inverse_kind, skip_label_instruction);
+            section = ir_concatenate(section, ir_generate_for_condition(right, branch_kind, label));
+            ir_append(section, skip_label_instruction);
+            return section;
+        }
+    }
+
+    ir_generate_for_expression(condition, NULL, NULL);
+    if(node_get_result(condition)->ir_operand->lvalue) {
+        ir_generate_for_conversion_to_rvalue(condition);
+    }
+    branch_instruction = ir_instruction(branch_kind);
+    ir_generate_gotoFalseOrTrue(branch_instruction, node_get_result(condition)->ir_operand, label);
+
+    section = ir_copy(condition->ir);
+    ir_append(section, branch_instruction);
+    return section;
+}
+
+/*
+ * The value of && and || is the condition itself, branching to the code
+ * that loads 0 when it is false.
+ */
 void ir_generate_for_logical_binary_operation(int kind, struct node *binary_operation) {
-    struct ir_instruction *storeword_instruction1, *storeword_instruction2;
     struct ir_instruction *label_instruction1, *label_instruction2;
-    struct ir_instruction *gotoIf_instruction1, *gotoIf_instruction2, *goto_instruction;
     struct ir_instruction *constant_instruction1, *constant_instruction2;
-
-    struct node *left = binary_operation->data.binary_operation.left_operand;
-    struct node *right = binary_operation->data.binary_operation.right_operand;
+    struct ir_instruction *goto_instruction;
 
     assert(NODE_BINARY_OPERATION == binary_operation->kind);
-    printf("Kind is %d\n", kind);
 
     assert((kind == BINOP_LOGICAL_OR_EXPR) || (kind == BINOP_LOGICAL_AND_EXPR));
 
-    ir_generate_for_expression(left, NULL, NULL);
-    if(node_get_result(left)->ir_operand->lvalue) {
-        ir_generate_for_conversion_to_rvalue(left);
-    }
-
     label_instruction1 = ir_instruction(IR_GENERATED_LABEL);
     ir_generate_label(label_instruction1);
 
     label_instruction2 = ir_instruction(IR_GENERATED_LABEL);
     ir_generate_label(label_instruction2);
 
-    ir_generate_for_expression(right, NULL, NULL);
-    if(node_get_result(right)->ir_operand->lvalue) {
-        ir_generate_for_conversion_to_rvalue(right);
-    }
+    binary_operation->ir = ir_generate_for_condition(binary_operation, IR_GOTO_IF_FALSE,
+                                                     label_instruction1);
 
+    /* Both constants are loaded into the same result temporary */
     constant_instruction1 = ir_instruction(IR_LOAD_IMMEDIATE);
-    constant_instruction2 = ir_instruction(IR_LOAD_IMMEDIATE);
-
-    switch (kind) {
-      case BINOP_LOGICAL_OR_EXPR:
-        /* For the OR Expr, we need to branch if the first
-         * expr is true. Otherwise, we need to evaluate the
-         * second expr
-         */
-        gotoIf_instruction1 = ir_instruction(IR_GOTO_IF_TRUE);
-
-        gotoIf_instruction2 = ir_instruction(IR_GOTO_IF_TRUE);
-
-        /* Create the constInt instruction for the number 0 */
-        ir_operand_temporary(constant_instruction1, 0);
-        constant_instruction1->operands[1].kind = OPERAND_NUMBER;
-        constant_instruction1->operands[1].data.number = 0;
-        constant_instruction1->operands[1].lvalue = false;
-
-        /* Create the constInt instruction for the number 1 */
-        ir_operand_temporary(constant_instruction2, 0);
-        constant_instruction2->operands[1].kind = OPERAND_NUMBER;
-        constant_instruction2->operands[1].data.number = 1;
-        constant_instruction2->operands[1].lvalue = false;
-
-        break;
-      case BINOP_LOGICAL_AND_EXPR:
-        /* For the AND Expr, we need to branch if the first
-         * expr is false. Otherwise, we need to evaluate the
-         * second expr
-         */
-        gotoIf_instruction1 = ir_instruction(IR_GOTO_IF_FALSE);
-
-        gotoIf_instruction2 = ir_instruction(IR_GOTO_IF_FALSE);
-
-        /* Create the constInt instruction for the number 0 */
-        ir_operand_temporary(constant_instruction1, 0);
-        constant_instruction1->operands[1].kind = OPERAND_NUMBER;
-        constant_instruction1->operands[1].data.number = 1;
-        constant_instruction1->operands[1].lvalue = false;
-
-        /* Create the constInt instruction for the number 1 */
-        ir_operand_temporary(constant_instruction2, 0);
-        constant_instruction2->operands[1].kind = OPERAND_NUMBER;
-        constant_instruction2->operands[1].data.number = 0;
-        constant_instruction2->operands[1].lvalue = false;
-        break;
-      default:
-        assert(0);
-        break;
-    }
-
-    /* We have prepared the branching instructions and the constInts based upon
-     * whether the operation is && or ||.  Now crate the instructions completely
-     * by using the labels etc. This is the same irrespective of && or ||
-     */
-    ir_generate_gotoFalseOrTrue(gotoIf_instruction1, node_get_result(left)->ir_operand, label_instruction1);
+    ir_operand_temporary(constant_instruction1, 0);
+    constant_instruction1->operands[1].kind = OPERAND_NUMBER;
+    constant_instruction1->operands[1].data.number = 1;
+    constant_instruction1->operands[1].lvalue = false;
 
-    ir_generate_gotoFalseOrTrue(gotoIf_instruction2, node_get_result(right)->ir_operand, label_instruction1);
-
-    storeword_instruction1 = ir_instruction(IR_COPY);
-    ir_operand_temporary(storeword_instruction1, 0);
-    ir_operand_copy(storeword_instruction1, 1,
-                    &constant_instruction1->operands[0]);
+    constant_instruction2 = ir_instruction(IR_LOAD_IMMEDIATE);
+    ir_operand_copy(constant_instruction2, 0, &constant_instruction1->operands[0]);
+    constant_instruction2->operands[1].kind = OPERAND_NUMBER;
+    constant_instruction2->operands[1].data.number = 0;
+    constant_instruction2->operands[1].lvalue = false;
 
     goto_instruction = ir_instruction(IR_GOTO);
     ir_generate_goto(goto_instruction, label_instruction2);
 
-    storeword_instruction2 = ir_instruction(IR_COPY);
-    ir_operand_copy(storeword_instruction2, 0,
-                    &storeword_instruction1->operands[0]);
-    ir_operand_copy(storeword_instruction2, 1,
-                    &constant_instruction2->operands[0]);
-
-    /* Create the IR by adding up all the instructions */
-    binary_operation->ir = ir_copy(left->ir);
-    ir_append(binary_operation->ir, gotoIf_instruction1);
-    binary_operation->ir = ir_concatenate(binary_operation->ir, right->ir);
-    ir_append(binary_operation->ir, gotoIf_instruction2);
     ir_append(binary_operation->ir, constant_instruction1);
-    ir_append(binary_operation->ir, storeword_instruction1);
     ir_append(binary_operation->ir, goto_instruction);
     ir_append(binary_operation->ir, label_instruction1);
     ir_append(binary_operation->ir, constant_instruction2);
-    ir_append(binary_operation->ir, storeword_instruction2);
     ir_append(binary_operation->ir, label_instruction2);
 
-    binary_operation->data.binary_operation.result.ir_operand = &storeword_instruction2->operands[0];
+    binary_operation->data.binary_operation.result.ir_operand = &constant_instruction2->operands[0];
     binary_operation->data.binary_operation.result.ir_operand->lvalue = false;
 }
 
@@ -1152,7 +1159,8 @@ void ir_generate_for_while_statement(struct node *while_statement,
                                      struct ir_instruction *function_end_label) {
   struct node *expression = while_statement->data.statement.expression;
   struct ir_instruction *label_instruction1, *label_instruction2;
-  struct ir_instruction *gotoIfFalse_instruction, *goto_instruction;
+  struct ir_instruction *goto_instruction;
+  struct ir_section *condition_ir;
   struct node *statement_within = while_statement->data.statement.statement;
 
   assert(NODE_STATEMENT == while_statement->kind);
@@ -1162,10 +1170,7 @@ void ir_generate_for_while_statement(struct node *while_statement,
   label_instruction2 = ir_instruction(IR_GENERATED_LABEL);
   ir_generate_label(label_instruction2);
 
-  ir_generate_for_expression(expression, function_end_label, label_instruction2);
-
-  gotoIfFalse_instruction = ir_instruction(IR_GOTO_IF_FALSE);
-  ir_generate_gotoFalseOrTrue(gotoIfFalse_instruction, node_get_result(expression)->ir_operand, label_instruction2);
+  condition_ir = ir_generate_for_condition(expression, IR_GOTO_IF_FALSE, label_instruction2);
 
   ir_generate_for_expression(statement_within, function_end_label, label_instruction2);
 
@@ -1173,8 +1178,7 @@ void ir_generate_for_while_statement(struct node *while_statement,
   ir_generate_goto(goto_instruction, label_instruction1);
 
   while_statement->ir = ir_section(label_instruction1, label_instruction1);
-  while_statement->ir = ir_concatenate(while_statement->ir, expression->ir);
-  ir_append(while_statement->ir, gotoIfFalse_instruction);
+  while_statement->ir = ir_concatenate(while_statement->ir, condition_ir);
   while_statement->ir = ir_concatenate(while_statement->ir, statement_within->ir);
   ir_append(while_statement->ir, goto_instruction);
   ir_append(while_statement->ir, label_instruction2);
@@ -1244,7 +1248,7 @@ struct ir_section * ir_generate_for_for_expr(struct node *for_expr,
     struct node *expr1 = for_expr->data.for_expr.expr1;
     struct node *expr2 = for_expr->data.for_expr.expr2;
 
-    struct ir_instruction *gotoIfFalse_instruction;
+    struct ir_section *condition_ir = NULL;
     assert(NODE_FOR_EXPR == for_expr->kind);
 
     if(initial_clause != NULL) {
@@ -1252,9 +1256,7 @@ struct ir_section * ir_generate_for_for_expr(struct node *for_expr,
     }
 
     if(expr1 != NULL) {
-        ir_generate_for_expression(expr1, NULL, NULL);
-        gotoIfFalse_instruction = ir_instruction(IR_GOTO_IF_FALSE);
-        ir_generate_gotoFalseOrTrue(gotoIfFalse_instruction, node_get_result(expr1)->ir_operand, label_instruction_conditional);
+        condition_ir = ir_generate_for_condition(expr1, IR_GOTO_IF_FALSE, label_instruction_conditional);
     }
     if(expr2 != NULL) {
         ir_generate_for_expression(expr2, NULL, NULL);
@@ -1268,8 +1270,7 @@ struct ir_section * ir_generate_for_for_expr(struct node *for_expr,
     }
 
     if(expr1 != NULL) {
-        for_expr->ir = ir_concatenate(for_expr->ir, expr1->ir);
-        ir_append(for_expr->ir, gotoIfFalse_instruction);
+        for_expr->ir = ir_concatenate(for_expr->ir, condition_ir);
     }
     if(expr2 != NULL) {
       return expr2->ir;
@@ -1278,15 +1279,14 @@ struct ir_section * ir_generate_for_for_expr(struct node *for_expr,
     }
 }
 
-void ir_generate_for_expression_list(struct node *expression_list, int *num_of_parameters) {
-    struct node *expression_list_within = expression_list->data.expression_list.expression_list;
-    struct node *assignment_expr = expression_list->data.expression_list.assignment_expr;
+/*
+ * Appends the code that evaluates one argument of a call and passes it as
+ * the next parameter to the IR of the expression list.
+ */
+static void ir_generate_for_argument(struct node *expression_list, struct node *assignment_expr,
+                                     int *num_of_parameters) {
     struct ir_instruction *instruction;
 
-    if(expression_list_within != NULL) {
-        ir_generate_for_expression_list(expression_list_within, num_of_parameters);
-        expression_list->ir = ir_copy(expression_list_within->ir);
-    }
     ir_generate_for_expression(assignment_expr, NULL, NULL);
     if((node_get_result(assignment_expr)->type->kind != TYPE_POINTER) &&
        (node_get_result(assignment_expr)->type->kind != TYPE_ARRAY)) {
@@ -1310,6 +1310,18 @@ void ir_generate_for_expression_list(struct node *expression_list, int *num_of_p
     }
 }
 
+void ir_generate_for_expression_list(struct node *expression_list, int *num_of_parameters) {
+    struct node **elements;
+    int num_elements, i;
+
+    elements = node_list_elements(expression_list, &num_elements);
+    expression_list->ir = NULL;
+    for(i = 0; i < num_elements; i++) {
+      ir_generate_for_argument(expression_list, elements[i], num_of_parameters);
+    }
+    free(elements);
+}
+
 void ir_generate_for_function_call(struct node *function_call) {
     struct node *postfix_expr = function_call->data.function_call.postfix_expr;
     struct node *expression_list = function_call->data.function_call.expression_list;
@@ -1378,7 +1390,6 @@ void ir_generate_for_do_statement(struct node *do_statement,
                                   struct ir_instruction *function_end_label) {
   struct node *expression = do_statement->data.statement.expression;
   struct ir_instruction *label_instruction1, *label_instruction2;
-  struct ir_instruction *gotoIfFalse_instruction, *goto_instruction;
   struct node *statement_within = do_statement->data.statement.statement;
 
   assert(NODE_STATEMENT == do_statement->kind);
@@ -1390,19 +1401,12 @@ void ir_generate_for_do_statement(struct node *do_statement,
 
   ir_generate_for_expression(statement_within, function_end_label, label_instruction2);
 
-  ir_generate_for_expression(expression, NULL, NULL);
-  ir_generate_for_conversion_to_rvalue(expression);
-  gotoIfFalse_instruction = ir_instruction(IR_GOTO_IF_FALSE);
-  ir_generate_gotoFalseOrTrue(gotoIfFalse_instruction, node_get_result(expression)->ir_operand, label_instruction2);
-
-  goto_instruction = ir_instruction(IR_GOTO);
-  ir_generate_goto(goto_instruction, label_instruction1);
-
+  /* Loop back while the condition holds */
   do_statement->ir = ir_section(label_instruction1, label_instruction1);
   do_statement->ir = ir_concatenate(do_statement->ir, statement_within->ir);
-  do_statement->ir = ir_concatenate(do_statement->ir, expression->ir);
-  ir_append(do_statement->ir, gotoIfFalse_instruction);
-  ir_append(do_statement->ir, goto_instruction);
+  do_statement->ir = ir_concatenate(do_statement->ir,
+                                    ir_generate_for_condition(expression, IR_GOTO_IF_TRUE,
+                                                              label_instruction1));
   ir_append(do_statement->ir, label_instruction2);
 }
 
@@ -1412,24 +1416,23 @@ void ir_generate_for_if_statement(struct node *if_statement,
     struct node *expr = if_statement->data.if_statement.expr;
     struct node *if_statement_within = if_statement->data.if_statement.if_statement;
     struct node *else_statement_within = if_statement->data.if_statement.else_statement;
-    struct ir_instruction *label_instruction, *gotoIfFalse_instruction;
+    struct ir_instruction *label_instruction;
     struct ir_instruction *goto_instruction1, *goto_instruction2;
     struct ir_instruction *end_of_if_else_statement;
+    struct ir_section *condition_ir;
 
     assert(NODE_IF_STATEMENT == if_statement->kind);
     if(expr == NULL) {
         ir_generation_num_errors++;
         printf("ERROR: the Expression inside the if statement is empty. Not allowed\n");
     }
-    ir_generate_for_expression(expr, NULL, NULL);
     label_instruction = ir_instruction(IR_GENERATED_LABEL);
     ir_generate_label(label_instruction);
 
     end_of_if_else_statement = ir_instruction(IR_GENERATED_LABEL);
     ir_generate_label(end_of_if_else_statement);
 
-    gotoIfFalse_instruction = ir_instruction(IR_GOTO_IF_FALSE);
-    ir_generate_gotoFalseOrTrue(gotoIfFalse_instruction, node_get_result(expr)->ir_operand, label_instruction);
+    condition_ir = ir_generate_for_condition(expr, IR_GOTO_IF_FALSE, label_instruction);
     if(if_statement_within != NULL) {
         ir_generate_for_expression(if_statement_within, function_end_label, inner_loop_end_label);
 	goto_instruction1 = ir_instruction(IR_GOTO);
@@ -1440,8 +1443,7 @@ void ir_generate_for_if_statement(struct node *if_statement,
 	goto_instruction2 = ir_instruction(IR_GOTO);
 	ir_generate_goto(goto_instruction2, end_of_if_else_statement);
     }
-    if_statement->ir = ir_copy(expr->ir);
-    ir_append(if_statement->ir, gotoIfFalse_instruction);
+    if_statement->ir = condition_ir;
     if(if_statement_within != NULL) {
         if_statement->ir = ir_concatenate(if_statement->ir, if_statement_within->ir);
 	ir_append(if_statement->ir, goto_instruction1);
@@ -1466,8 +1468,6 @@ void ir_generate_for_goto_statement(struct node *goto_statement) {
 void ir_generate_for_statement(struct node *statement,
                                    struct ir_instruction *function_end_label,
                                    struct ir_instruction *inner_loop_end_label) {
-    /* Reset temporaries for every statement */
-
   assert(NODE_STATEMENT == statement->kind);
   switch(statement->data.statement.type_of_statement) {
     case EXPRESSION_STATEMENT_TYPE:
@@ -1506,19 +1506,22 @@ void ir_generate_for_statement(struct node *statement,
 void ir_generate_for_statement_list(struct node *statement_list,
                                    struct ir_instruction *function_end_label,
                                    struct ir_instruction *inner_loop_end_label) {
-  struct node *init = statement_list->data.statement_list.init;
-  struct node *statement = statement_list->data.statement_list.statement;
+  struct node **elements;
+  int num_elements, i;
 
   assert(NODE_STATEMENT_LIST == statement_list->kind);
 
-  if (NULL != init) {
-      ir_generate_for_expression(init, function_end_label, inner_loop_end_label);
-      ir_generate_for_expression(statement, function_end_label, inner_loop_end_label);
-    statement_list->ir = ir_concatenate(init->ir, statement->ir);
-  } else {
-      ir_generate_for_expression(statement, function_end_label, inner_loop_end_label);
-    statement_list->ir = statement->ir;
+  elements = node_list_elements(statement_list, &num_elements);
+  statement_list->ir = NULL;
+  for (i = 0; i < num_elements; i++) {
+    ir_generate_for_expression(elements[i], function_end_label, inner_loop_end_label);
+    if (NULL == statement_list->ir) {
+      statement_list->ir = elements[i]->ir;
+    } else {
+      statement_list->ir = ir_concatenate(statement_list->ir, elements[i]->ir);
+    }
   }
+  free(elements);
 }
 
 void ir_generate_for_expression(struct node *expression,
@@ -1554,6 +1557,8 @@ void ir_generate_for_expression(struct node *expression,
       break;
     case NODE_FUNCTION_DEFINITION:
       ir_generate_for_function_definition(expression);
+      /* Temporaries are numbered per function; the register allocator
+       * works out which of them can share a register. */
       next_temporary = 0;
       break;
    case NODE_COMPOUND_STATEMENT:
@@ -1561,7 +1566,6 @@ void ir_generate_for_expression(struct node *expression,
       break;
     case NODE_STATEMENT:
       ir_generate_for_statement(expression, function_end_label, inner_loop_end_label);
-      next_temporary = 0;
       break;
     case NODE_STATEMENT_LIST:
       ir_generate_for_statement_list(expression, function_end_label, inner_loop_end_label);
@@ -1594,18 +1598,21 @@ void ir_generate_for_expression(struct node *expression,
 }
 
 void ir_generate_for_translation_unit(struct node *translation_unit) {
-  struct node *top_level_decl = translation_unit->data.translation_unit.top_level_decl;
-  struct node *translation_unit_within = translation_unit->data.translation_unit.translation_unit;
+  struct node **elements;
+  int num_elements, i;
 
   assert(NODE_TRANSLATION_UNIT == translation_unit->kind);
-  if (NULL != translation_unit_within) {
-    ir_generate_for_translation_unit(translation_unit_within);
-    ir_generate_for_expression(top_level_decl, NULL, NULL);
-    translation_unit->ir = ir_concatenate(translation_unit_within->ir, top_level_decl->ir);
-  } else {
-      ir_generate_for_expression(top_level_decl, NULL, NULL);
-    translation_unit->ir = top_level_decl->ir;
+  elements = node_list_elements(translation_unit, &num_elements);
+  translation_unit->ir = NULL;
+  for (i = 0; i < num_elements; i++) {
+    ir_generate_for_expression(elements[i], NULL, NULL);
+    if (NULL == translation_unit->ir) {
+      translation_unit->ir = elements[i]->ir;
+    } else {
+      translation_unit->ir = ir_concatenate(translation_unit->ir, elements[i]->ir);
+    }
   }
+  free(elements);
 }
 
 void ir_generate_for_program(struct node *program) {
@@ -1623,94 +1630,101 @@ void ir_generate_for_program(struct node *program) {
  * PRINT INSTRUCTIONS *
  **********************/
 
-static void ir_print_opcode(FILE *output, int kind) {
-  static char *instruction_names[] = {
-    NULL,
-    "NOP",
-    "MULT",
-    "DIV",
-    "ADD",
-    "SUB",
-    "REM",
-    "LI",
-    "COPY",
-    "PNUM",
-    "GENLABEL",
-    "GOTO",
-    "FCNCALL",
-    "ADDRESSOF",
-    "LOADWORD",
-    "LESSTHAN",
-    "LTOREQTO",
-    "GRTHAN",
-    "GTOREQTO",
-    "SHIFLEFT",
-    "SHIFRIGHT",
-    "EQTO",
-    "NOTEQTO",
-    "BITOR",
-    "BITXOR",
-    "BITAND",
-    "BIFEQZ",
-    "BIFNOTEQZ",
-    "STORWORD",
-    "SIZEOF",
-    "BITWISENOT",
-    "LOGICALNOT",
-    "NEGATION",
-    "GOTOIFALSE",
-    "RETURNWORD",
-    "PROCBEGIN",
-    "PROCEND",
-    "GOTOIFTRUE",
-    "CASTUWORD",
-    "CASTSWORD",
-    "CASTUHWORD",
-    "CASTSHWORD",
-    "CASTUBYTE",
-    "CASTSBYTE",
-    "PARAMETER",
-    "RESULWORD",
-    "CASTWTOUB",
-    "CASTWTOSB",
-    "CASTHWTOUB",
-    "CASTHWTOSB",
-    "CASTHWTOUW",
-    "CASTHWTOSW",
-    "CASTBTOUW",
-    "CASTBTOSW",
-    "CASTWTOUHW",
-    "CASTWTOSHW",
-    "CASTBTOUHW",
-    "CASTBTOSHW",
-    "LOADSBYTE",
-    "LOADSHWORD",
-    "STORSBYTE",
-    "STORSHWORD",
-    NULL
-  };
+static char *instruction_names[] = {
+  NULL,
+  "NOP",
+  "MULT",
+  "DIV",
+  "ADD",
+  "SUB",
+  "REM",
+  "LI",
+  "COPY",
+  "PNUM",
+  "GENLABEL",
+  "GOTO",
+  "FCNCALL",
+  "ADDRESSOF",
+  "LOADWORD",
+  "LESSTHAN",
+  "LTOREQTO",
+  "GRTHAN",
+  "GTOREQTO",
+  "SHIFLEFT",
+  "SHIFRIGHT",
+  "EQTO",
+  "NOTEQTO",
+  "BITOR",
+  "BITXOR",
+  "BITAND",
+  "BIFEQZ",
+  "BIFNOTEQZ",
+  "STORWORD",
+  "SIZEOF",
+  "BITWISENOT",
+  "LOGICALNOT",
+  "NEGATION",
+  "GOTOIFALSE",
+  "RETURNWORD",
+  "PROCBEGIN",
+  "PROCEND",
+  "GOTOIFTRUE",
+  "CASTUWORD",
+  "CASTSWORD",
+  "CASTUHWORD",
+  "CASTSHWORD",
+  "CASTUBYTE",
+  "CASTSBYTE",
+  "PARAMETER",
+  "RESULWORD",
+  "CASTWTOUB",
+  "CASTWTOSB",
+  "CASTHWTOUB",
+  "CASTHWTOSB",
+  "CASTHWTOUW",
+  "CASTHWTOSW",
+  "CASTBTOUW",
+  "CASTBTOSW",
+  "CASTWTOUHW",
+  "CASTWTOSHW",
+  "CASTBTOUHW",
+  "CASTBTOSHW",
+  "LOADSBYTE",
+  "LOADSHWORD",
+  "STORSBYTE",
+  "STORSHWORD",
+  "SHIFRIGHTL",
+  "MULTHI",
+  NULL
+};
+
+const char *ir_opcode_name(int kind) {
+  assert(kind > 0 && kind < IR_NUM_KINDS);
+  return instruction_names[kind];
+}
 
+static void ir_print_opcode(FILE *output, int kind) {
   fprintf(output, "%-10s", instruction_names[kind]);
 }
 
 static void ir_print_operand(FILE *output, struct ir_operand *operand) {
   switch (operand->kind) {
     case OPERAND_NUMBER:
-      fprintf(output, "%10hu", (unsigned short)operand->data.number);
+      fprintf(output, "%10u", (unsigned int)operand->data.number);
       break;
 
     case OPERAND_TEMPORARY:
       fprintf(output, "     t%04d", operand->data.temporary);
       break;
     case OPERAND_IDENTIFIER:
-      fprintf(output, "     %p     %s", (void *)operand->data.identifier.symbol,
-              operand->data.identifier.identifier_name);
+      fprintf(output, "     %p     %s", (void *)operand->data.symbol,
+              operand->data.symbol->name);
       break;
     case OPERAND_GENERATED_LABEL:
       fprintf(output, "     __GeneratedLabel_%04d", operand->data.generated_label);
       break;
     case OPERAND_STRING:
-      fprintf(output, "     __GeneratedStringLabel_%04d", operand->data.string_label.generated_label);
+      fprintf(output, "     __GeneratedStringLabel_%04d", operand->data.string_label);
       break;
     case OPERAND_NULL:
       break;
@@ -1735,12 +1749,14 @@ void ir_print_instruction(FILE *output, struct ir_instruction *instruction) {
     case IR_GREATER_THAN_OR_EQ_TO:
     case IR_SHIFT_LEFT:
     case IR_SHIFT_RIGHT:
+    case IR_SHIFT_RIGHT_LOGICAL:
     case IR_EQUAL_TO:
     case IR_NOT_EQUAL_TO:
     case IR_BITWISE_OR:
     case IR_BITWISE_XOR:
     case IR_BITWISE_AND:
     case IR_REMAINDER:
+    case IR_MULTIPLY_HIGH:
       ir_print_operand(output, &instruction->operands[0]);
       fprintf(output, ", ");
       ir_print_operand(output, &instruction->operands[1]);
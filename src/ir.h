@@ -19,18 +19,16 @@ struct ir_operand {
   int kind;
   bool lvalue;
 
+  /*
+   * An identifier is named through its symbol and a string literal by its
+   * handle in the string pool, which also numbers its label.
+   */
   union {
       unsigned long number;
       int temporary;
-      struct {
-          char identifier_name[MAX_IDENTIFIER_LENGTH+1];
-          struct symbol *symbol;
-      } identifier;
+      struct symbol *symbol;
       int generated_label;
-      struct {
-          int generated_label;
-          char name[MAX_STRING_LENGTH];
-      } string_label;
+      int string_label;
   } data;
 };
 
@@ -95,7 +93,11 @@ struct ir_operand {
 #define IR_LOAD_SIGNED_HALFWORD   59
 #define IR_STORE_SIGNED_BYTE      60
 #define IR_STORE_SIGNED_HALFWORD  61
+#define IR_SHIFT_RIGHT_LOGICAL    62
+#define IR_MULTIPLY_HIGH          63
 
+/* One more than the largest instruction kind */
+#define IR_NUM_KINDS              64
 
 struct ir_instruction {
   int kind;
@@ -109,12 +111,21 @@ struct ir_section {
 
 void ir_generate_for_program(struct node *program);
 
+const char *ir_opcode_name(int kind);
+
 void ir_print_section(FILE *output, struct ir_section *section);
 
 void ir_print_section_reverse(FILE *output, struct ir_section *section);
 
 struct ir_section *ir_section(struct ir_instruction *first, struct ir_instruction *last);
 
+struct ir_instruction *ir_instruction(int kind);
+
+bool ir_is_destination_operand(struct ir_instruction *instruction, int position);
+
 extern FILE *error_output;
 extern int ir_generation_num_errors;
+
+/* Number of IR instructions created over the whole compilation */
+extern unsigned long ir_num_instructions_created;
 #endif
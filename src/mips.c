@@ -7,31 +7,100 @@
 #include "type.h"
 #include "symbol.h"
 #include "ir.h"
+#include "string_pool.h"
+#include "arena.h"
+#include "register_allocation.h"
 #include "mips.h"
 
-#define REG_EXHAUSTED   -1
-
-#define FIRST_USABLE_REGISTER  8
-#define LAST_USABLE_REGISTER  23
-#define NUM_REGISTERS         32
-
 /*
  * Change the IR to print the address of an identifier, not the name of the identifier
  * Create IR_NO_OPERATION instruction if we see an error
- * Simple optimization: multiply power of 2 - shiftleft that many bits
- * load immediate can be replaced by 'binary operation immediate'
- * add of 0(multiply of 1) can be replaced by no-op (need to remember the register correctly)
- * multiply of 0 can be replaced by no-op
  */
 
+/*
+ * Register allocation of the function being printed. It is computed when the
+ * IR_FUNCTION_BEGIN instruction is printed and released at IR_FUNCTION_END.
+ */
+static struct register_allocation *register_allocation;
+
+/* Size of the current stack frame, and where its spill slots begin */
+static int frame_size;
+static int spill_area_offset;
+
+/*
+ * Leaf functions (no calls other than syscall builtins) never save $ra or
+ * $fp and address their frame off $sp; if they need no stack at all the
+ * frame is left out entirely.
+ */
+static bool function_is_leaf;
+static char *frame_register = "$fp";
+
+/* The $s registers the function body writes, and the parameters it reads */
+static unsigned int callee_saved_registers;
+static unsigned int parameters_used;
+
+/*
+ * The loads at the top of the function that read a parameter through its
+ * save slot, indexed by parameter. Nothing has touched $a0 to $a3 yet when
+ * they run, so they are printed as copies of the registers and the
+ * parameter needs no slot.
+ */
+#define MAX_REGISTER_PARAMETERS           4
+static struct ir_instruction *parameter_reads[MAX_REGISTER_PARAMETERS];
+
+/* Spilled temporaries of the instruction being printed, and the scratch
+ * registers they have been loaded into. */
+static int num_spilled_operands;
+static int spilled_temporaries[3];
+static int spilled_registers[3];
+
+/*
+ * Temporaries of the current function that only ever hold the constant of
+ * their single load immediate, and whose every use can encode that constant
+ * in the instruction itself. Their load is never printed and they get no
+ * register. Both arrays are indexed by temporary number.
+ */
+static bool *is_immediate;
+static unsigned int *immediate_values;
+
+/* How many instructions of the current function write and read each temporary */
+static int *num_definitions;
+static int *num_uses;
+
 /****************************
  * MIPS TEXT SECTION OUTPUT *
  ****************************/
 
-void mips_print_temporary_operand(FILE *output, struct ir_operand *operand) {
+static int mips_register_for_temporary(struct ir_operand *operand) {
+  int temporary, i;
   assert(OPERAND_TEMPORARY == operand->kind);
+  assert(NULL != register_allocation);
+
+  temporary = operand->data.temporary;
+  assert(temporary < register_allocation->num_temporaries);
+  if(register_allocation->registers[temporary] != REG_EXHAUSTED) {
+    return register_allocation->registers[temporary];
+  }
+  for(i = 0; i < num_spilled_operands; i++) {
+    if(spilled_temporaries[i] == temporary) {
+      return spilled_registers[i];
+    }
+  }
+  assert(0);
+  return REG_EXHAUSTED;
+}
+
+static int mips_spill_slot_offset(int temporary) {
+  return spill_area_offset + 4 * register_allocation->spill_slots[temporary];
+}
+
+void mips_print_temporary_operand(FILE *output, struct ir_operand *operand) {
+  fprintf(output, "%8s%02d", "$", mips_register_for_temporary(operand));
+}
 
-  fprintf(output, "%8s%02d", "$", operand->data.temporary + FIRST_USABLE_REGISTER);
+static bool mips_is_immediate(struct ir_operand *operand) {
+  return NULL != is_immediate && OPERAND_TEMPORARY == operand->kind &&
+         is_immediate[operand->data.temporary];
 }
 
 void mips_print_number_operand(FILE *output, struct ir_operand *operand) {
@@ -43,7 +112,7 @@ void mips_print_number_operand(FILE *output, struct ir_operand *operand) {
 void mips_print_identifier_operand(FILE *output, struct ir_operand *operand) {
   assert(OPERAND_IDENTIFIER == operand->kind);
 
-  fprintf(output, "%s", operand->data.identifier.identifier_name);
+  fprintf(output, "%s", operand->data.symbol->name);
 }
 
 void mips_print_generated_label(FILE *output, struct ir_operand *operand) {
@@ -55,7 +124,198 @@ void mips_print_generated_label(FILE *output, struct ir_operand *operand) {
 void mips_print_generated_string_label(FILE *output, struct ir_operand *operand) {
   assert(OPERAND_STRING == operand->kind);
 
-  fprintf(output, "__GeneratedStringLabel_%04d", operand->data.string_label.generated_label);
+  fprintf(output, "__GeneratedStringLabel_%04d", operand->data.string_label);
+}
+
+/**********************
+ * IMMEDIATE OPERANDS *
+ **********************/
+
+static bool mips_fits_signed_immediate(unsigned int value) {
+    return (int)value >= -32768 && (int)value <= 32767;
+}
+
+static bool mips_fits_unsigned_immediate(unsigned int value) {
+    return value <= 0xffff;
+}
+
+/*
+ * Whether the instruction can take the constant value of the source operand
+ * at position as an immediate. Only the second operand of an operation that
+ * does not commute can, and the comparisons are rewritten onto slti:
+ * x <= c is x < c + 1, x > c is !(x < c + 1) and x >= c is !(x < c).
+ */
+static bool mips_can_take_immediate(struct ir_instruction *instruction, int position,
+                                    unsigned int value) {
+    switch(instruction->kind) {
+        case IR_ADD:
+            return mips_fits_signed_immediate(value);
+        case IR_SUBTRACT:
+            return position == 2 && mips_fits_signed_immediate(0u - value);
+        case IR_BITWISE_AND:
+        case IR_BITWISE_OR:
+        case IR_BITWISE_XOR:
+        case IR_EQUAL_TO:
+        case IR_NOT_EQUAL_TO:
+            return mips_fits_unsigned_immediate(value);
+        case IR_SHIFT_LEFT:
+        case IR_SHIFT_RIGHT:
+        case IR_SHIFT_RIGHT_LOGICAL:
+            return position == 2;
+        case IR_LESS_THAN:
+        case IR_GREATER_THAN_OR_EQ_TO:
+            return position == 2 && mips_fits_signed_immediate(value);
+        case IR_LESS_THAN_OR_EQ_TO:
+        case IR_GREATER_THAN:
+            return position == 2 && value != 0x7fffffffu && mips_fits_signed_immediate(value + 1);
+        default:
+            return false;
+    }
+}
+
+/*
+ * Counts the definitions and uses of the temporaries of the function and
+ * finds those that can be printed as immediates. An instruction takes at
+ * most one immediate, so when both of its sources are candidates the first
+ * one has to stay in a register.
+ */
+static void mips_scan_temporaries(struct ir_instruction *function_begin) {
+    struct ir_instruction *instruction;
+    int num_temporaries, temporary, i;
+
+    num_temporaries = 0;
+    for(instruction = function_begin->next; instruction->kind != IR_FUNCTION_END;
+        instruction = instruction->next) {
+        for(i = 0; i < 3; i++) {
+            if(instruction->operands[i].kind == OPERAND_TEMPORARY &&
+               instruction->operands[i].data.temporary >= num_temporaries) {
+                num_temporaries = instruction->operands[i].data.temporary + 1;
+            }
+        }
+    }
+
+    is_immediate = arena_allocate(&optimizer_arena, sizeof(bool) * (num_temporaries + 1));
+    immediate_values = arena_allocate(&optimizer_arena, sizeof(unsigned int) * (num_temporaries + 1));
+    num_definitions = arena_allocate(&optimizer_arena, sizeof(int) * (num_temporaries + 1));
+    num_uses = arena_allocate(&optimizer_arena, sizeof(int) * (num_temporaries + 1));
+
+    for(instruction = function_begin->next; instruction->kind != IR_FUNCTION_END;
+        instruction = instruction->next) {
+        if(ir_is_destination_operand(instruction, 0)) {
+            temporary = instruction->operands[0].data.temporary;
+            num_definitions[temporary]++;
+            if(instruction->kind == IR_LOAD_IMMEDIATE) {
+                is_immediate[temporary] = true;
+                immediate_values[temporary] = (unsigned int)instruction->operands[1].data.number;
+            }
+        }
+        for(i = 0; i < 3; i++) {
+            if(instruction->operands[i].kind == OPERAND_TEMPORARY &&
+               !ir_is_destination_operand(instruction, i)) {
+                num_uses[instruction->operands[i].data.temporary]++;
+            }
+        }
+    }
+    for(temporary = 0; temporary < num_temporaries; temporary++) {
+        if(num_definitions[temporary] != 1) {
+            is_immediate[temporary] = false;
+        }
+    }
+
+    for(instruction = function_begin->next; instruction->kind != IR_FUNCTION_END;
+        instruction = instruction->next) {
+        for(i = 0; i < 3; i++) {
+            if(!mips_is_immediate(&instruction->operands[i]) ||
+               ir_is_destination_operand(instruction, i)) {
+                continue;
+            }
+            temporary = instruction->operands[i].data.temporary;
+            if(!mips_can_take_immediate(instruction, i, immediate_values[temporary]) ||
+               (i == 1 && mips_is_immediate(&instruction->operands[2]))) {
+                is_immediate[temporary] = false;
+            }
+        }
+    }
+}
+
+static void mips_print_immediate_instruction(FILE *output, char *opcode,
+                                             struct ir_operand *destination,
+                                             struct ir_operand *source, int immediate) {
+    fprintf(output, "%10s ", opcode);
+    mips_print_temporary_operand(output, destination);
+    fputs(", ", output);
+    mips_print_temporary_operand(output, source);
+    fprintf(output, ", %10d\n", immediate);
+}
+
+/*
+ * Prints the operation with the given constant in place of one of its
+ * sources; source is the operand that stays in a register.
+ */
+static void mips_print_arithmetic_immediate(FILE *output, struct ir_instruction *instruction,
+                                            struct ir_operand *source, unsigned int value) {
+    struct ir_operand *destination = &instruction->operands[0];
+
+    switch(instruction->kind) {
+        case IR_ADD:
+            mips_print_immediate_instruction(output, "addiu", destination, source, (int)value);
+            break;
+        case IR_SUBTRACT:
+            mips_print_immediate_instruction(output, "addiu", destination, source, (int)(0u - value));
+            break;
+        case IR_BITWISE_AND:
+            mips_print_immediate_instruction(output, "andi", destination, source, (int)value);
+            break;
+        case IR_BITWISE_OR:
+            mips_print_immediate_instruction(output, "ori", destination, source, (int)value);
+            break;
+        case IR_BITWISE_XOR:
+            mips_print_immediate_instruction(output, "xori", destination, source, (int)value);
+            break;
+        case IR_SHIFT_LEFT:
+            mips_print_immediate_instruction(output, "sll", destination, source, (int)(value & 31));
+            break;
+        case IR_SHIFT_RIGHT:
+            mips_print_immediate_instruction(output, "sra", destination, source, (int)(value & 31));
+            break;
+        case IR_SHIFT_RIGHT_LOGICAL:
+            mips_print_immediate_instruction(output, "srl", destination, source, (int)(value & 31));
+            break;
+        case IR_LESS_THAN:
+            mips_print_immediate_instruction(output, "slti", destination, source, (int)value);
+            break;
+        case IR_LESS_THAN_OR_EQ_TO:
+            mips_print_immediate_instruction(output, "slti", destination, source, (int)value + 1);
+            break;
+        case IR_GREATER_THAN:
+            mips_print_immediate_instruction(output, "slti", destination, source, (int)value + 1);
+            mips_print_immediate_instruction(output, "xori", destination, destination, 1);
+            break;
+        case IR_GREATER_THAN_OR_EQ_TO:
+            mips_print_immediate_instruction(output, "slti", destination, source, (int)value);
+            mips_print_immediate_instruction(output, "xori", destination, destination, 1);
+            break;
+        case IR_EQUAL_TO:
+        case IR_NOT_EQUAL_TO:
+            /* Compare the bits that differ from the constant against zero */
+            if(value != 0) {
+                mips_print_immediate_instruction(output, "xori", destination, source, (int)value);
+                source = destination;
+            }
+            if(IR_EQUAL_TO == instruction->kind) {
+                mips_print_immediate_instruction(output, "sltiu", destination, source, 1);
+            } else {
+                fprintf(output, "%10s ", "sltu");
+                mips_print_temporary_operand(output, destination);
+                fprintf(output, ", %10s, ", "$0");
+                mips_print_temporary_operand(output, source);
+                fputs("\n", output);
+            }
+            break;
+        default:
+            assert(0);
+            break;
+    }
 }
 
 void mips_print_arithmetic(FILE *output, struct ir_instruction *instruction) {
@@ -141,7 +401,7 @@ void mips_print_arithmetic(FILE *output, struct ir_instruction *instruction) {
     NULL,
     NULL,
     NULL,
-    "sltu",
+    "slt",
     "sle",
     "sgt",
     "sge",
@@ -154,7 +414,22 @@ void mips_print_arithmetic(FILE *output, struct ir_instruction *instruction) {
     "and",
     NULL
   };
-  fprintf(output, "%10s ", opcodes[instruction->kind]);
+  if(mips_is_immediate(&instruction->operands[2])) {
+    mips_print_arithmetic_immediate(output, instruction, &instruction->operands[1],
+                                    immediate_values[instruction->operands[2].data.temporary]);
+    return;
+  }
+  if(mips_is_immediate(&instruction->operands[1])) {
+    mips_print_arithmetic_immediate(output, instruction, &instruction->operands[2],
+                                    immediate_values[instruction->operands[1].data.temporary]);
+    return;
+  }
+
+  if(IR_SHIFT_RIGHT_LOGICAL == instruction->kind) {
+    fprintf(output, "%10s ", "srl");
+  } else {
+    fprintf(output, "%10s ", opcodes[instruction->kind]);
+  }
   mips_print_temporary_operand(output, &instruction->operands[0]);
   fputs(", ", output);
   mips_print_temporary_operand(output, &instruction->operands[1]);
@@ -171,12 +446,30 @@ void mips_print_copy(FILE *output, struct ir_instruction *instruction) {
   fprintf(output, ", %10s\n", "$0");
 }
 
+/*
+ * The native instructions the assembler would pick for li, except that a
+ * constant whose low half is zero needs only its lui.
+ */
 void mips_print_load_immediate(FILE *output, struct ir_instruction *instruction) {
-  fprintf(output, "%10s ", "li");
-  mips_print_temporary_operand(output, &instruction->operands[0]);
-  fputs(", ", output);
-  mips_print_number_operand(output, &instruction->operands[1]);
-  fputs("\n", output);
+  unsigned int value = (unsigned int)instruction->operands[1].data.number;
+
+  if(mips_fits_signed_immediate(value)) {
+    fprintf(output, "%10s ", "addiu");
+    mips_print_temporary_operand(output, &instruction->operands[0]);
+    fprintf(output, ", %10s, %10d\n", "$0", (int)value);
+  } else if(mips_fits_unsigned_immediate(value)) {
+    fprintf(output, "%10s ", "ori");
+    mips_print_temporary_operand(output, &instruction->operands[0]);
+    fprintf(output, ", %10s, %10u\n", "$0", value);
+  } else {
+    fprintf(output, "%10s ", "lui");
+    mips_print_temporary_operand(output, &instruction->operands[0]);
+    fprintf(output, ", %10u\n", value >> 16);
+    if((value & 0xffff) != 0) {
+      mips_print_immediate_instruction(output, "ori", &instruction->operands[0],
+                                       &instruction->operands[0], (int)(value & 0xffff));
+    }
+  }
 }
 
 void mips_print_print_number(FILE *output, struct ir_instruction *instruction) {
@@ -211,33 +504,143 @@ bool need_to_allocate_memory_for_identifier(char local_variables[10][MAX_IDENTIF
     return !string_already_present;
 }
 
+/* Offsets of the fixed part of the frame */
+#define PARAMETER_SAVE_OFFSET(n)         (4 + 4 * (n))
+#define CALLEE_SAVE_OFFSET(reg)          (20 + 4 * ((reg) - FIRST_CALLEE_SAVED_REGISTER))
+#define FRAME_POINTER_SAVE_OFFSET        52
+#define RETURN_ADDRESS_SAVE_OFFSET       56
+
+/* The parameter a local symbol is passed in, or -1 if it is not a register parameter */
+static int mips_register_parameter(struct symbol *symbol) {
+    int parameter;
+
+    if(symbol->owner_symbol_table->type_of_symbol_table == FILE_SCOPE_SYMBOL_TABLE ||
+       symbol->stack_offset >= 0 || symbol->stack_offset == STACK_OFFSET_NOT_YET_DEFINED) {
+        return -1;
+    }
+    parameter = (BEGINNING_STACK_OFFSET + symbol->stack_offset - PARAMETER_SAVE_OFFSET(0)) / 4;
+    if(parameter < 0 || parameter >= MAX_REGISTER_PARAMETERS) {
+        return -1;
+    }
+    return parameter;
+}
+
+/*
+ * Finds the parameter reads among the address and load pairs that open the
+ * function, which is where promotion puts them. The address must have no
+ * other use.
+ */
+static void mips_find_parameter_reads(struct ir_instruction *function_begin) {
+    struct ir_instruction *address, *load;
+    int parameter;
+
+    for(parameter = 0; parameter < MAX_REGISTER_PARAMETERS; parameter++) {
+        parameter_reads[parameter] = NULL;
+    }
+    for(address = function_begin->next; address->kind == IR_ADDRESS_OF; address = load->next) {
+        load = address->next;
+        if(address->operands[1].kind != OPERAND_IDENTIFIER || load->kind != IR_LOAD_WORD ||
+           load->operands[1].kind != OPERAND_TEMPORARY ||
+           load->operands[1].data.temporary != address->operands[0].data.temporary ||
+           num_uses[address->operands[0].data.temporary] != 1) {
+            return;
+        }
+        parameter = mips_register_parameter(address->operands[1].data.symbol);
+        if(parameter == -1 || parameter_reads[parameter] != NULL) {
+            return;
+        }
+        parameter_reads[parameter] = load;
+    }
+}
+
+static int mips_parameter_read(struct ir_instruction *instruction) {
+    int parameter;
+
+    for(parameter = 0; parameter < MAX_REGISTER_PARAMETERS; parameter++) {
+        if(parameter_reads[parameter] != NULL && parameter_reads[parameter] == instruction) {
+            return parameter;
+        }
+    }
+    return -1;
+}
+
+static void mips_print_parameter_read(FILE *output, struct ir_instruction *instruction,
+                                      int parameter) {
+    int temporary = instruction->operands[0].data.temporary;
+    char location[16];
+
+    if(register_allocation->registers[temporary] == REG_EXHAUSTED) {
+        sprintf(location, "%d(%s)", mips_spill_slot_offset(temporary), frame_register);
+        fprintf(output, "%10s %9s%d, %10s\n", "sw", "$a", parameter, location);
+    } else {
+        fprintf(output, "%10s %8s%02d, %9s%d, %10s\n", "or", "$", register_allocation->registers[temporary],
+                "$a", parameter, "$0");
+    }
+}
+
 void mips_print_function(FILE *output, struct ir_instruction *instruction) {
     struct ir_instruction *temp_instruction = instruction;
 
-    /* To start off, we need storage space for:
-     * s0 to s7 (32 bytes),
-     * a0 - a3 (16 bytes)
-     * t0 - t9 (40 bytes),
-     * the old stack frame pointer $fp (4 bytes)
-     * the return address $ra (4 bytes)
-     * one reserved word (4 bytes)
-     * The minimum space needed = 100 bytes
+    /* The frame, at offsets from $sp:
+     *   0 .. 3     a reserved word
+     *   4 .. 19    $a0 to $a3, for the parameters read from memory
+     *   20 .. 51   $s0 to $s7, for those the body writes
+     *   52, 56     the old $fp and $ra, in functions that make calls
+     *   60 .. 91   $t0 to $t7, for those live across a call
+     *   100 ..     the locals, then the spill slots
+     * Only the registers the function actually uses are stored.
      */
-    int number_of_bytes_for_frame = BEGINNING_STACK_OFFSET;
+    int number_of_bytes_for_locals = 0;
     int word_aligned_number_of_bytes;
+    char location[16];
+    int reg;
+
+    mips_scan_temporaries(instruction);
+    register_allocation = register_allocate_for_function(instruction, is_immediate);
+
+    function_is_leaf = (register_allocation->num_call_sites == 0);
+    frame_register = function_is_leaf ? "$sp" : "$fp";
+    callee_saved_registers = 0;
+    for(reg = FIRST_CALLEE_SAVED_REGISTER; reg <= LAST_CALLEE_SAVED_REGISTER; reg++) {
+        callee_saved_registers |= register_allocation->used_registers & (1u << reg);
+    }
+    parameters_used = 0;
+    mips_find_parameter_reads(instruction);
 
-    /* Now, find out the additional of memory needed for the function */
+    /* Now, find out the additional of memory needed for the locals. Every
+     * scope of the function starts at the same offset, so the largest one
+     * decides. Parameters live at negative offsets in the $a save area. */
     while(temp_instruction->kind != IR_FUNCTION_END) {
         temp_instruction = temp_instruction->next;
         if((temp_instruction->kind == IR_ADDRESS_OF) &&
            (temp_instruction->operands[1].kind == OPERAND_IDENTIFIER)) {
-	  number_of_bytes_for_frame +=
-	    temp_instruction->operands[1].data.identifier.symbol->owner_symbol_table->total_stack_offset;
-	  break;
+          struct symbol *symbol = temp_instruction->operands[1].data.symbol;
+          struct symbol_table *table = symbol->owner_symbol_table;
+          int parameter;
+          if(table->type_of_symbol_table == FILE_SCOPE_SYMBOL_TABLE ||
+             mips_parameter_read(temp_instruction->next) != -1) {
+            continue;
+          }
+          parameter = mips_register_parameter(symbol);
+          if(parameter != -1) {
+            parameters_used |= 1u << parameter;
+          }
+          if(table->total_stack_offset > number_of_bytes_for_locals) {
+            number_of_bytes_for_locals = table->total_stack_offset;
+          }
         }
     }
 
-    word_aligned_number_of_bytes = (((number_of_bytes_for_frame + 7) >> 3) << 3);
+    /* The spill slots of the register allocator follow the locals */
+    spill_area_offset = BEGINNING_STACK_OFFSET + (((number_of_bytes_for_locals + 3) >> 2) << 2);
+    word_aligned_number_of_bytes =
+      (((spill_area_offset + 4 * register_allocation->num_spill_slots + 7) >> 3) << 3);
+    frame_size = word_aligned_number_of_bytes;
+    if(function_is_leaf && number_of_bytes_for_locals == 0 &&
+       register_allocation->num_spill_slots == 0 &&
+       callee_saved_registers == 0 && parameters_used == 0) {
+        frame_size = 0;
+    }
 
     /* First, print out the label corresponding to this function name in the
      * mips file */
@@ -245,40 +648,39 @@ void mips_print_function(FILE *output, struct ir_instruction *instruction) {
     mips_print_identifier_operand(output, &instruction->operands[0]);
     fputs(":\n", output);
 
-    fprintf(output, "\t#To start off, we need storage space for\n");
-    fprintf(output, "\t# s0 to s7 (32 bytes), \n");
-    fprintf(output, "\t# a0 - a3 (16 bytes), \n");
-    fprintf(output, "\t# t0 - t9 (40 bytes), \n");
-    fprintf(output, "\t# the old stack frame pointer $fp (4 bytes), \n");
-    fprintf(output, "\t# the return address $ra (4 bytes), \n");
-    fprintf(output, "\t# one reserved word (4 bytes). \n");
-    fprintf(output, "\t# The minimum space needed = 100 bytes \n");
-
+    if(frame_size == 0) {
+        fprintf(output, "\t# Leaf function without a stack frame\n");
+        return;
+    }
 
     /* Print all the stack frame related instructions */
-    fprintf(output, "%10s %10s, %10s, %10d\n", "addi", "$sp", "$sp", -(word_aligned_number_of_bytes));
-    /* Store the old frame pointer */
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$fp", "52($sp)");
-    /* Save the return address */
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$ra", "56($sp)");
-    /* Set the new frame pointer */
-    fprintf(output, "%10s %10s, %10s, %10s\n", "or", "$fp", "$sp", "$0");
-    /* Save the passed in parameters */
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$a0", "4($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$a1", "8($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$a2", "12($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$a3", "16($fp)");
-
-    /* Save the s-registers */
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$s0", "20($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$s1", "24($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$s2", "28($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$s3", "32($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$s4", "36($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$s5", "40($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$s6", "44($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$s7", "48($fp)");
+    fprintf(output, "%10s %10s, %10s, %10d\n", "addi", "$sp", "$sp", -(frame_size));
+    if(!function_is_leaf) {
+        /* Store the old frame pointer */
+        sprintf(location, "%d($sp)", FRAME_POINTER_SAVE_OFFSET);
+        fprintf(output, "%10s %10s, %10s\n", "sw", "$fp", location);
+        /* Save the return address */
+        sprintf(location, "%d($sp)", RETURN_ADDRESS_SAVE_OFFSET);
+        fprintf(output, "%10s %10s, %10s\n", "sw", "$ra", location);
+        /* Set the new frame pointer */
+        fprintf(output, "%10s %10s, %10s, %10s\n", "or", "$fp", "$sp", "$0");
+    }
+
+    /* Save the passed in parameters that the body reads */
+    for(reg = 0; reg < MAX_REGISTER_PARAMETERS; reg++) {
+        if(parameters_used & (1u << reg)) {
+            sprintf(location, "%d(%s)", PARAMETER_SAVE_OFFSET(reg), frame_register);
+            fprintf(output, "%10s %9s%d, %10s\n", "sw", "$a", reg, location);
+        }
+    }
 
+    /* Save the s-registers the body writes */
+    for(reg = FIRST_CALLEE_SAVED_REGISTER; reg <= LAST_CALLEE_SAVED_REGISTER; reg++) {
+        if(callee_saved_registers & (1u << reg)) {
+            sprintf(location, "%d(%s)", CALLEE_SAVE_OFFSET(reg), frame_register);
+            fprintf(output, "%10s %9s%d, %10s\n", "sw", "$s", reg - FIRST_CALLEE_SAVED_REGISTER, location);
+        }
+    }
 }
 
 void mips_print_load_address(FILE *output, struct ir_instruction *instruction) {
@@ -287,8 +689,8 @@ void mips_print_load_address(FILE *output, struct ir_instruction *instruction) {
   mips_print_temporary_operand(output, &instruction->operands[0]);
   fputs(", ", output);
   if(instruction->operands[1].kind == OPERAND_IDENTIFIER) {
-      stack_offset += instruction->operands[1].data.identifier.symbol->stack_offset;
-      fprintf(output, "   %d($fp)\n", stack_offset);
+      stack_offset += instruction->operands[1].data.symbol->stack_offset;
+      fprintf(output, "   %d(%s)\n", stack_offset, frame_register);
   } else {
       assert(instruction->operands[1].kind == OPERAND_STRING);
       mips_print_generated_string_label(output, &instruction->operands[1]);
@@ -314,7 +716,7 @@ void mips_print_load_word_byte_or_halfword(FILE *output, struct ir_instruction *
   mips_print_temporary_operand(output, &instruction->operands[0]);
   assert(OPERAND_TEMPORARY == instruction->operands[1].kind);
   fputs(", ", output);
-  fprintf(output, "%9s%02d", "0($", instruction->operands[1].data.temporary + FIRST_USABLE_REGISTER);
+  fprintf(output, "%9s%02d", "0($", mips_register_for_temporary(&instruction->operands[1]));
   fprintf(output, ")\n");
 }
 
@@ -336,7 +738,7 @@ void mips_print_store_word_byte_or_halfword(FILE *output, struct ir_instruction
   mips_print_temporary_operand(output, &instruction->operands[1]);
   assert(OPERAND_TEMPORARY == instruction->operands[1].kind);
   fputs(", ", output);
-  fprintf(output, "%8s%02d", "0($", instruction->operands[0].data.temporary + FIRST_USABLE_REGISTER);
+  fprintf(output, "%8s%02d", "0($", mips_register_for_temporary(&instruction->operands[0]));
   fprintf(output, ")\n");
 }
 
@@ -348,27 +750,33 @@ void mips_print_function_parameter(FILE *output, struct ir_instruction *instruct
   fprintf(output, ", %10s\n", "$0");
 }
 
+/* Frame offset where caller-saved register $N is kept across a call */
+#define CALLER_SAVE_OFFSET(reg)   (60 + 4 * ((reg) - FIRST_USABLE_REGISTER))
+
+/* The caller-saved registers stored by the last call, restored by its RESULTWORD */
+static unsigned int caller_saved_registers;
+
 void mips_print_function_call(FILE *output, struct ir_instruction *instruction) {
-  /* Save all the t registers*/
-    char *function_name = instruction->operands[0].data.identifier.identifier_name;
-    bool isSysFcnCall = (!strcmp(function_name, "print_int") ||
-                         !strcmp(function_name, "read_int") ||
-                         !strcmp(function_name, "read_string") ||
-                         !strcmp(function_name, "print_string") ||
-			 !strcmp(function_name, "exit"));
-
-    /* Save the t-registers */
-    fprintf(output, "\n\t #Save the t-registers \n");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$t0", "60($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$t1", "64($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$t2", "68($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$t3", "72($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$t4", "76($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$t5", "80($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$t6", "84($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$t7", "88($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$t8", "92($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "sw", "$t9", "96($fp)");
+    char *function_name = instruction->operands[0].data.symbol->name;
+    bool isSysFcnCall = register_is_syscall_builtin(instruction);
+    char location[16];
+    int reg;
+
+    /* Save the t-registers that are still needed after the call. The
+     * syscall builtins do not touch them. */
+    caller_saved_registers = 0;
+    if(!isSysFcnCall) {
+        caller_saved_registers = register_live_across_call(register_allocation, instruction);
+    }
+    if(caller_saved_registers != 0) {
+        fprintf(output, "\n\t #Save the live t-registers \n");
+    }
+    for(reg = 0; reg < NUM_REGISTERS; reg++) {
+        if(caller_saved_registers & (1u << reg)) {
+            sprintf(location, "%d(%s)", CALLER_SAVE_OFFSET(reg), frame_register);
+            fprintf(output, "%10s %8s%02d, %10s\n", "sw", "$", reg, location);
+        }
+    }
 
     if(!isSysFcnCall) {
 
@@ -383,7 +791,9 @@ void mips_print_function_call(FILE *output, struct ir_instruction *instruction)
             fprintf(output, "%10s ", "$v0, ");
             fprintf(output, "%10s ", "4");
         } else if(!strcmp(function_name, "read_string")) {
-            /* xxx: The reads have more work to be done */
+            /* The buffer and its length are already in $a0 and $a1 */
+            fprintf(output, "%10s ", "$v0, ");
+            fprintf(output, "%10s ", "8");
         } else if(!strcmp(function_name, "read_int")) {
             fprintf(output, "%10s ", "$v0, ");
             fprintf(output, "%10s ", "5");
@@ -400,20 +810,21 @@ void mips_print_function_call(FILE *output, struct ir_instruction *instruction)
 }
 
 void mips_print_result_word(FILE *output, struct ir_instruction *instruction) {
+    char location[16];
+    int reg;
     assert(IR_RESULTWORD == instruction->kind);
 
-    /* Restore the t-registers */
-    fprintf(output, "\n\t #Restore the t-registers\n");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$t9", "96($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$t8", "92($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$t7", "88($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$t6", "84($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$t5", "80($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$t4", "76($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$t3", "72($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$t2", "68($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$t1", "64($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$t0", "60($fp)");
+    /* Restore the t-registers saved by the call */
+    if(caller_saved_registers != 0) {
+        fprintf(output, "\n\t #Restore the live t-registers\n");
+    }
+    for(reg = NUM_REGISTERS - 1; reg >= 0; reg--) {
+        if(caller_saved_registers & (1u << reg)) {
+            sprintf(location, "%d(%s)", CALLER_SAVE_OFFSET(reg), frame_register);
+            fprintf(output, "%10s %8s%02d, %10s\n", "lw", "$", reg, location);
+        }
+    }
+    caller_saved_registers = 0;
 
     fprintf(output, "%10s ", "or");
     mips_print_temporary_operand(output, &instruction->operands[0]);
@@ -440,6 +851,185 @@ void mips_print_goto_if_true(FILE *output, struct ir_instruction *instruction) {
     fprintf(output, "\n");
 }
 
+/**********************
+ * COMPARE AND BRANCH *
+ **********************/
+
+static bool mips_is_comparison(int kind) {
+    switch(kind) {
+        case IR_LESS_THAN:
+        case IR_LESS_THAN_OR_EQ_TO:
+        case IR_GREATER_THAN:
+        case IR_GREATER_THAN_OR_EQ_TO:
+        case IR_EQUAL_TO:
+        case IR_NOT_EQUAL_TO:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * Whether the comparison only computes the condition of the conditional
+ * branch right after it. The two are then printed together as one compare
+ * and branch, and the 0/1 result of the comparison is never materialized.
+ */
+static bool mips_is_fused_comparison(struct ir_instruction *instruction) {
+    struct ir_instruction *branch = instruction->next;
+    int temporary;
+
+    if(NULL == num_uses || !mips_is_comparison(instruction->kind) || NULL == branch ||
+       (IR_GOTO_IF_FALSE != branch->kind && IR_GOTO_IF_TRUE != branch->kind)) {
+        return false;
+    }
+    temporary = instruction->operands[0].data.temporary;
+    return OPERAND_TEMPORARY == branch->operands[0].kind &&
+           temporary == branch->operands[0].data.temporary &&
+           1 == num_definitions[temporary] && 1 == num_uses[temporary];
+}
+
+static int mips_negate_comparison(int kind) {
+    switch(kind) {
+        case IR_LESS_THAN:
+            return IR_GREATER_THAN_OR_EQ_TO;
+        case IR_LESS_THAN_OR_EQ_TO:
+            return IR_GREATER_THAN;
+        case IR_GREATER_THAN:
+            return IR_LESS_THAN_OR_EQ_TO;
+        case IR_GREATER_THAN_OR_EQ_TO:
+            return IR_LESS_THAN;
+        case IR_EQUAL_TO:
+            return IR_NOT_EQUAL_TO;
+        default:
+            assert(IR_NOT_EQUAL_TO == kind);
+            return IR_EQUAL_TO;
+    }
+}
+
+static void mips_print_branch_on_register(FILE *output, char *opcode,
+                                          struct ir_operand *operand,
+                                          struct ir_operand *label) {
+    fprintf(output, "%10s ", opcode);
+    mips_print_temporary_operand(output, operand);
+    fprintf(output, ",");
+    mips_print_generated_label(output, label);
+    fprintf(output, "\n");
+}
+
+static void mips_print_branch_on_registers(FILE *output, char *opcode,
+                                           struct ir_operand *left, struct ir_operand *right,
+                                           struct ir_operand *label) {
+    fprintf(output, "%10s ", opcode);
+    mips_print_temporary_operand(output, left);
+    fprintf(output, ",");
+    mips_print_temporary_operand(output, right);
+    fprintf(output, ",");
+    mips_print_generated_label(output, label);
+    fprintf(output, "\n");
+}
+
+static void mips_print_set_on_less_than(FILE *output, struct ir_operand *destination,
+                                        struct ir_operand *left, struct ir_operand *right) {
+    fprintf(output, "%10s ", "slt");
+    mips_print_temporary_operand(output, destination);
+    fputs(", ", output);
+    mips_print_temporary_operand(output, left);
+    fputs(", ", output);
+    mips_print_temporary_operand(output, right);
+    fputs("\n", output);
+}
+
+/*
+ * Prints a comparison and the conditional branch on its result as a branch
+ * on the comparison itself: beq and bne for equality, the branches against
+ * zero for a comparison with 0 and otherwise slt or slti into the result
+ * register followed by beqz or bnez. A branch taken when the condition is
+ * false is a branch on the negated condition.
+ */
+static void mips_print_compare_and_branch(FILE *output, struct ir_instruction *comparison,
+                                          struct ir_instruction *branch) {
+    struct ir_operand *destination = &comparison->operands[0];
+    struct ir_operand *left = &comparison->operands[1];
+    struct ir_operand *right = &comparison->operands[2];
+    struct ir_operand *label = &branch->operands[1];
+    unsigned int value;
+    int kind;
+
+    kind = comparison->kind;
+    if(IR_GOTO_IF_FALSE == branch->kind) {
+        kind = mips_negate_comparison(kind);
+    }
+
+    /* Only == and != may have their constant first */
+    if(mips_is_immediate(left)) {
+        left = &comparison->operands[2];
+        right = &comparison->operands[1];
+    }
+
+    if(!mips_is_immediate(right)) {
+        switch(kind) {
+            case IR_EQUAL_TO:
+                mips_print_branch_on_registers(output, "beq", left, right, label);
+                break;
+            case IR_NOT_EQUAL_TO:
+                mips_print_branch_on_registers(output, "bne", left, right, label);
+                break;
+            case IR_LESS_THAN:
+                mips_print_set_on_less_than(output, destination, left, right);
+                mips_print_branch_on_register(output, "bnez", destination, label);
+                break;
+            case IR_GREATER_THAN_OR_EQ_TO:
+                mips_print_set_on_less_than(output, destination, left, right);
+                mips_print_branch_on_register(output, "beqz", destination, label);
+                break;
+            case IR_GREATER_THAN:
+                mips_print_set_on_less_than(output, destination, right, left);
+                mips_print_branch_on_register(output, "bnez", destination, label);
+                break;
+            case IR_LESS_THAN_OR_EQ_TO:
+                mips_print_set_on_less_than(output, destination, right, left);
+                mips_print_branch_on_register(output, "beqz", destination, label);
+                break;
+        }
+        return;
+    }
+
+    value = immediate_values[right->data.temporary];
+    switch(kind) {
+        case IR_EQUAL_TO:
+        case IR_NOT_EQUAL_TO:
+            if(value != 0) {
+                mips_print_immediate_instruction(output, "xori", destination, left, (int)value);
+                left = destination;
+            }
+            mips_print_branch_on_register(output, IR_EQUAL_TO == kind ? "beqz" : "bnez",
+                                          left, label);
+            break;
+        case IR_LESS_THAN:
+        case IR_GREATER_THAN_OR_EQ_TO:
+            if(value == 0) {
+                mips_print_branch_on_register(output, IR_LESS_THAN == kind ? "bltz" : "bgez",
+                                              left, label);
+                break;
+            }
+            mips_print_immediate_instruction(output, "slti", destination, left, (int)value);
+            mips_print_branch_on_register(output, IR_LESS_THAN == kind ? "bnez" : "beqz",
+                                          destination, label);
+            break;
+        case IR_LESS_THAN_OR_EQ_TO:
+        case IR_GREATER_THAN:
+            if(value == 0) {
+                mips_print_branch_on_register(output, IR_GREATER_THAN == kind ? "bgtz" : "blez",
+                                              left, label);
+                break;
+            }
+            mips_print_immediate_instruction(output, "slti", destination, left, (int)value + 1);
+            mips_print_branch_on_register(output, IR_LESS_THAN_OR_EQ_TO == kind ? "bnez" : "beqz",
+                                          destination, label);
+            break;
+    }
+}
+
 void mips_print_goto(FILE *output, struct ir_instruction *instruction) {
     assert(IR_GOTO == instruction->kind);
     fprintf(output, "%10s ", "b");
@@ -464,52 +1054,50 @@ void mips_print_return(FILE *output, struct ir_instruction *instruction) {
 }
 
 void mips_print_function_end(FILE *output, struct ir_instruction *instruction) {
-    struct ir_instruction *temp_instruction = instruction;
-    int number_of_bytes_for_frame = BEGINNING_STACK_OFFSET;
-    int word_aligned_number_of_bytes;
+    char location[16];
+    int reg;
     assert(IR_FUNCTION_END == instruction->kind);
 
-    /* Restore the s-registers */
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$s7", "48($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$s6", "44($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$s5", "40($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$s4", "36($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$s3", "32($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$s2", "28($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$s1", "24($fp)");
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$s0", "20($fp)");
-
-    /* Restore the return address */
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$ra", "56($sp)");
-
-    /* Restore the old frame pointer */
-    fprintf(output, "%10s %10s, %10s\n", "lw", "$fp", "52($sp)");
-
-    /* Now, find out the additional of memory needed for the function */
-    while(temp_instruction->kind != IR_FUNCTION_BEGIN) {
-        temp_instruction = temp_instruction->prev;
-        if(temp_instruction == NULL) {
-            printf("There should be a procbegin instruction here\n");
-            assert(0);
+    if(frame_size != 0) {
+        /* Restore the s-registers */
+        for(reg = LAST_CALLEE_SAVED_REGISTER; reg >= FIRST_CALLEE_SAVED_REGISTER; reg--) {
+            if(callee_saved_registers & (1u << reg)) {
+                sprintf(location, "%d(%s)", CALLEE_SAVE_OFFSET(reg), frame_register);
+                fprintf(output, "%10s %9s%d, %10s\n", "lw", "$s", reg - FIRST_CALLEE_SAVED_REGISTER, location);
+            }
         }
-        if((temp_instruction->kind == IR_ADDRESS_OF) &&
-           (temp_instruction->operands[1].kind == OPERAND_IDENTIFIER)) {
-            number_of_bytes_for_frame +=
-                temp_instruction->operands[1].data.identifier.symbol->owner_symbol_table->total_stack_offset;
-            break;
+
+        if(!function_is_leaf) {
+            /* Restore the return address */
+            sprintf(location, "%d($sp)", RETURN_ADDRESS_SAVE_OFFSET);
+            fprintf(output, "%10s %10s, %10s\n", "lw", "$ra", location);
+
+            /* Restore the old frame pointer */
+            sprintf(location, "%d($sp)", FRAME_POINTER_SAVE_OFFSET);
+            fprintf(output, "%10s %10s, %10s\n", "lw", "$fp", location);
         }
-    }
-    word_aligned_number_of_bytes = (((number_of_bytes_for_frame + 7) >> 3) << 3);
 
-    /* Pop off the stack frame */
-    fprintf(output, "%10s %10s, %10s, %10d\n", "addi", "$sp", "$sp", (word_aligned_number_of_bytes));
+        /* Pop off the stack frame */
+        fprintf(output, "%10s %10s, %10s, %10d\n", "addi", "$sp", "$sp", frame_size);
+    }
 
     /* Return to caller */
     fprintf(output, "%10s %10s\n\n", "jr", "$ra");
+
+    /* The register allocation was scratch data for this function */
+    arena_reset(&optimizer_arena);
+    register_allocation = NULL;
+    for(reg = 0; reg < MAX_REGISTER_PARAMETERS; reg++) {
+        parameter_reads[reg] = NULL;
+    }
+    is_immediate = NULL;
+    immediate_values = NULL;
+    num_definitions = NULL;
+    num_uses = NULL;
 }
 
 void mips_print_multiply_or_divide(FILE *output, struct ir_instruction *instruction) {
-    if(IR_MULTIPLY == instruction->kind) {
+    if(IR_MULTIPLY == instruction->kind || IR_MULTIPLY_HIGH == instruction->kind) {
         fprintf(output, "%10s ", "multu");
     } else if(IR_DIVIDE == instruction->kind) {
         fprintf(output, "%10s ", "divu");
@@ -540,6 +1128,13 @@ void mips_print_multiply_or_divide(FILE *output, struct ir_instruction *instruct
         fprintf(output, "\n");
     }
 
+    if(instruction->kind == IR_MULTIPLY_HIGH) {
+        /* The upper 32 bits of the product are in the HI register */
+        fprintf(output, "%10s ", "mfhi");
+        mips_print_temporary_operand(output, &instruction->operands[0]);
+        fprintf(output, "\n");
+    }
+
     if(instruction->kind == IR_REMAINDER) {
         /* The quotient is stored in the HI register */
         fprintf(output, "%10s ", "mfhi");
@@ -567,7 +1162,7 @@ void mips_print_negation(FILE *output, struct ir_instruction *instruction) {
     mips_print_temporary_operand(output, &instruction->operands[0]);
     fprintf(output, ",");
     mips_print_temporary_operand(output, &instruction->operands[0]);
-    fprintf(output, ", %10d\n", -1);
+    fprintf(output, ", %10d\n", 1);
     fprintf(output, "\n");
 }
 
@@ -581,7 +1176,102 @@ void mips_print_logical_not(FILE *output, struct ir_instruction *instruction) {
     fprintf(output, "\n");
 }
 
+/*
+ * Spilled temporaries are loaded into $t8/$t9 before the instruction that uses
+ * them and a spilled destination is written back right after it. The printers
+ * read all of their sources before they write the destination, so the
+ * destination may share a scratch register with a source.
+ */
+static void mips_load_spilled_operands(FILE *output, struct ir_instruction *instruction) {
+  int i, j, temporary;
+  int next_scratch_register = FIRST_SPILL_REGISTER;
+
+  num_spilled_operands = 0;
+  if(NULL == register_allocation) {
+    return;
+  }
+  for(i = 0; i < 3; i++) {
+    if(instruction->operands[i].kind != OPERAND_TEMPORARY ||
+       ir_is_destination_operand(instruction, i) ||
+       mips_is_immediate(&instruction->operands[i])) {
+      continue;
+    }
+    temporary = instruction->operands[i].data.temporary;
+    if(register_allocation->registers[temporary] != REG_EXHAUSTED) {
+      continue;
+    }
+    for(j = 0; j < num_spilled_operands; j++) {
+      if(spilled_temporaries[j] == temporary) {
+        break;
+      }
+    }
+    if(j < num_spilled_operands) {
+      continue;
+    }
+    assert(next_scratch_register <= SECOND_SPILL_REGISTER);
+    spilled_temporaries[num_spilled_operands] = temporary;
+    spilled_registers[num_spilled_operands] = next_scratch_register;
+    num_spilled_operands++;
+    fprintf(output, "%10s %8s%02d, %6d(%s)\n", "lw", "$", next_scratch_register,
+            mips_spill_slot_offset(temporary), frame_register);
+    next_scratch_register++;
+  }
+
+  if(ir_is_destination_operand(instruction, 0)) {
+    temporary = instruction->operands[0].data.temporary;
+    if(register_allocation->registers[temporary] == REG_EXHAUSTED) {
+      for(j = 0; j < num_spilled_operands; j++) {
+        if(spilled_temporaries[j] == temporary) {
+          return;
+        }
+      }
+      spilled_temporaries[num_spilled_operands] = temporary;
+      spilled_registers[num_spilled_operands] = FIRST_SPILL_REGISTER;
+      num_spilled_operands++;
+    }
+  }
+}
+
+static void mips_store_spilled_destination(FILE *output, struct ir_instruction *instruction) {
+  int temporary;
+  if(NULL == register_allocation || !ir_is_destination_operand(instruction, 0)) {
+    return;
+  }
+  temporary = instruction->operands[0].data.temporary;
+  if(register_allocation->registers[temporary] == REG_EXHAUSTED) {
+    fprintf(output, "%10s %8s%02d, %6d(%s)\n", "sw", "$",
+            mips_register_for_temporary(&instruction->operands[0]),
+            mips_spill_slot_offset(temporary), frame_register);
+  }
+}
+
 void mips_print_instruction(FILE *output, struct ir_instruction *instruction) {
+  int parameter;
+
+  /* The users of an immediate temporary print its constant themselves */
+  if(IR_LOAD_IMMEDIATE == instruction->kind && mips_is_immediate(&instruction->operands[0])) {
+    return;
+  }
+  /* A parameter read takes its register, so the address is never printed */
+  if(IR_ADDRESS_OF == instruction->kind && mips_parameter_read(instruction->next) != -1) {
+    return;
+  }
+  parameter = mips_parameter_read(instruction);
+  if(parameter != -1) {
+    mips_print_parameter_read(output, instruction, parameter);
+    return;
+  }
+  /* A comparison that only decides the branch after it is printed with it */
+  if(mips_is_fused_comparison(instruction)) {
+    mips_load_spilled_operands(output, instruction);
+    mips_print_compare_and_branch(output, instruction, instruction->next);
+    return;
+  }
+  if(NULL != instruction->prev && mips_is_fused_comparison(instruction->prev)) {
+    return;
+  }
+  mips_load_spilled_operands(output, instruction);
+
   switch (instruction->kind) {
     case IR_ADD:
     case IR_SUBTRACT:
@@ -591,6 +1281,7 @@ void mips_print_instruction(FILE *output, struct ir_instruction *instruction) {
     case IR_GREATER_THAN_OR_EQ_TO:
     case IR_SHIFT_LEFT:
     case IR_SHIFT_RIGHT:
+    case IR_SHIFT_RIGHT_LOGICAL:
     case IR_EQUAL_TO:
     case IR_NOT_EQUAL_TO:
     case IR_BITWISE_OR:
@@ -602,6 +1293,7 @@ void mips_print_instruction(FILE *output, struct ir_instruction *instruction) {
     case IR_MULTIPLY:
     case IR_DIVIDE:
     case IR_REMAINDER:
+    case IR_MULTIPLY_HIGH:
       mips_print_multiply_or_divide(output, instruction);
       break;
     case IR_COPY:
@@ -679,9 +1371,11 @@ void mips_print_instruction(FILE *output, struct ir_instruction *instruction) {
       assert(0);
       break;
   }
+
+  mips_store_spilled_destination(output, instruction);
 }
 
-void print_string(FILE *output, char *str) {
+void print_string(FILE *output, const char *str) {
     int i = 0;
     fputs("\"", output);
     do {
@@ -699,16 +1393,27 @@ void print_string(FILE *output, char *str) {
     fputs("\"", output);
 }
 
+/* Identical literals share a pooled string, so each label is printed once */
 void mips_print_string_labels(FILE *output, struct ir_section *section) {
     struct ir_instruction *instruction;
+    bool *printed;
+    int string_label;
+
+    printed = calloc(string_pool_count() + 1, sizeof(bool));
+    assert(NULL != printed);
     for (instruction = section->first; instruction != section->last->next; instruction = instruction->next) {
         if(instruction->operands[1].kind == OPERAND_STRING) {
-          fprintf(output, "\n__GeneratedStringLabel_%04d: .asciiz ",
-                  instruction->operands[1].data.string_label.generated_label);
-          print_string(output, instruction->operands[1].data.string_label.name);
+          string_label = instruction->operands[1].data.string_label;
+          if(printed[string_label]) {
+              continue;
+          }
+          printed[string_label] = true;
+          fprintf(output, "\n__GeneratedStringLabel_%04d: .asciiz ", string_label);
+          print_string(output, string_pool_text(string_label));
       }
     }
     fputs("\n", output);
+    free(printed);
 }
 
 void mips_print_text_section(FILE *output, struct ir_section *section) {
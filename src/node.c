@@ -9,9 +9,13 @@
 #include "node.h"
 #include "symbol.h"
 #include "type.h"
+#include "string_pool.h"
+#include "arena.h"
 
 extern int yylineno;
 
+unsigned long node_num_created;
+
 /****************
  * CREATE NODES *
  ****************/
@@ -20,8 +24,9 @@ extern int yylineno;
 struct node *node_create(int node_kind) {
   struct node *n;
 
-  n = malloc(sizeof(struct node));
+  n = arena_allocate(&parse_tree_arena, sizeof(struct node));
   assert(NULL != n);
+  node_num_created++;
 
   n->kind = node_kind;
   n->line_number = yylineno;
@@ -29,17 +34,6 @@ struct node *node_create(int node_kind) {
   return n;
 }
 
-/* Allocate and initialize a generic type. */
-struct type *type_create(int type_kind) {
-  struct type *n;
-
-  n = malloc(sizeof(struct type));
-  assert(NULL != n);
-
-  n->kind = type_kind;
-  return n;
-}
-
 /*
  * node_identifier - allocate a node to represent an identifier
  *
@@ -54,8 +48,11 @@ struct type *type_create(int type_kind) {
 struct node *node_identifier(char *text, int length)
 {
   struct node *node = node_create(NODE_IDENTIFIER);
-  memset(node->data.identifier.name, 0, MAX_IDENTIFIER_LENGTH + 1);
-  strncpy(node->data.identifier.name, text, length);
+  /* Only the first MAX_IDENTIFIER_LENGTH characters are significant */
+  if(length > MAX_IDENTIFIER_LENGTH) {
+    length = MAX_IDENTIFIER_LENGTH;
+  }
+  node->data.identifier.name = string_pool_intern(text, length);
 
   node->data.identifier.symbol = NULL;
   return node;
@@ -69,8 +66,7 @@ struct node *node_identifier(char *text, int length)
  *   text - string - contains the entire string
  *   length - integer - the length of text (not including terminating NUL)
  *
- * Returns a NUL-terminated string in newly allocated memory, containing the
- *   string. Returns NULL if memory could not be allocated.
+ * Returns the node; the text of the string is interned in the string pool.
  *
  * Side-effects:
  *   Memory may be allocated on the heap.
@@ -78,9 +74,7 @@ struct node *node_identifier(char *text, int length)
  */
 struct node *node_string(char *text, int length)
 {
-  int i;
   struct node *node = node_create(NODE_STRING);
-  memset(node->data.string.name, 0, MAX_STRING_LENGTH + 1);
   if(length > MAX_STRING_LENGTH) {
     fprintf(stderr, "String length is greater than Maximum length allowed.. \n");
     /* If string length > Max String length, only display the string
@@ -88,15 +82,8 @@ struct node *node_string(char *text, int length)
      */
     length = MAX_STRING_LENGTH;
   }
-  node->data.string.length = length;
-  /* The following loop is to ensure we copy over the
-   * \0 character properly
-   */
-  for(i = 0; i < length; i++) {
-    node->data.string.name[i] = text[i];
-  }
-  /* Wrap up the string with the NULL character at the end */
-  node->data.string.name[length] = 0;
+  /* The length is passed along so that \0 characters are kept */
+  node->data.string.name = string_pool_intern(text, length);
   node->data.string.result.type = NULL;
   node->data.string.result.ir_operand = NULL;
   return node;
@@ -120,7 +107,6 @@ struct node *node_number(char *text)
   errno = 0;
   node->data.number.value = strtoul(text, NULL, 10);
   node->data.number.overflow = false;
-  node->data.number.result.type = type_create(TYPE_BASIC);
 
   if (node->data.number.value == ULONG_MAX && ERANGE == errno) {
     /* Strtoul indicated overflow. */
@@ -128,14 +114,13 @@ struct node *node_number(char *text)
   } else if (node->data.number.value > 4294967295ul) {
     /* Value is too large for 32-bit unsigned long type. */
     node->data.number.overflow = true;
-  } else if (node->data.number.value < 2147483648ul) {
-    struct type *type = node->data.number.result.type;
-    type->data.basic.width = TYPE_WIDTH_INT;
-    type->data.basic.is_unsigned = false;
+  }
+
+  /* Types are shared, so they are asked for complete rather than filled in */
+  if (node->data.number.value < 2147483648ul) {
+    node->data.number.result.type = type_basic(false, TYPE_WIDTH_INT, CONVERSION_RANK_INT);
   } else {
-    struct type *type = node->data.number.result.type;
-    type->data.basic.width = TYPE_WIDTH_LONG;
-    type->data.basic.is_unsigned = true;
+    node->data.number.result.type = type_basic(true, TYPE_WIDTH_LONG, CONVERSION_RANK_LONG);
   }
 
   node->data.number.result.ir_operand = NULL;
@@ -157,7 +142,7 @@ struct node *node_character(char text)
   errno = 0;
   /* We know that the text being passed in is a single character */
   node->data.number.value = (int)text;
-  node->data.number.result.type = type_create(TYPE_BASIC);
+  node->data.number.result.type = type_basic(false, TYPE_WIDTH_CHAR, CONVERSION_RANK_CHAR);
   /* if(text < 0) { */
   /*   /\* Take 2's complement of the number *\/ */
   /*   node->data.number.value = 256 + text;  */
@@ -165,8 +150,6 @@ struct node *node_character(char text)
   /* The number is less than 256 since text is a 1 byte character */
   node->data.number.overflow = false;
 
-  node->data.number.result.type->data.basic.width = TYPE_WIDTH_CHAR;
-  node->data.number.result.type->data.basic.is_unsigned = false;
   node->data.number.result.ir_operand = NULL;
   return node;
 }
@@ -442,6 +425,77 @@ struct result *node_get_result(struct node *expression) {
   }
 }
 
+/*
+ * The grammar builds translation units, statement lists and expression
+ * lists left-recursively, so the first element sits at the bottom of a
+ * chain of list nodes as long as the list. Stores the elements that the
+ * given list node holds itself in own, in source order, and returns the
+ * list node below it.
+ */
+static struct node *node_list_split(struct node *list, struct node **own, int *num_own) {
+  struct node *init;
+
+  *num_own = 0;
+  switch (list->kind) {
+    case NODE_TRANSLATION_UNIT:
+      if (NULL != list->data.translation_unit.top_level_decl) {
+        own[(*num_own)++] = list->data.translation_unit.top_level_decl;
+      }
+      return list->data.translation_unit.translation_unit;
+    case NODE_STATEMENT_LIST:
+      init = list->data.statement_list.init;
+      if (NULL != init && NODE_STATEMENT_LIST != init->kind) {
+        /* The first statement of the list */
+        own[(*num_own)++] = init;
+        init = NULL;
+      }
+      if (NULL != list->data.statement_list.statement) {
+        own[(*num_own)++] = list->data.statement_list.statement;
+      }
+      return init;
+    case NODE_EXPRESSION_LIST:
+      if (NULL != list->data.expression_list.assignment_expr) {
+        own[(*num_own)++] = list->data.expression_list.assignment_expr;
+      }
+      return list->data.expression_list.expression_list;
+    default:
+      assert(0);
+      return NULL;
+  }
+}
+
+/*
+ * Returns the elements of a translation unit, statement list or expression
+ * list in source order, so that the phases can walk long lists in a loop
+ * instead of recursing once per element. The array comes from malloc and
+ * has to be freed by the caller.
+ */
+struct node **node_list_elements(struct node *list, int *num_elements) {
+  struct node **elements;
+  struct node *own[2];
+  struct node *iter;
+  int num_own, count, i;
+
+  count = 0;
+  for (iter = list; NULL != iter; iter = node_list_split(iter, own, &num_own)) {
+    node_list_split(iter, own, &num_own);
+    count += num_own;
+  }
+
+  elements = malloc(sizeof(struct node *) * (count + 1));
+  assert(NULL != elements);
+  *num_elements = count;
+  for (iter = list; NULL != iter; ) {
+    struct node *inner = node_list_split(iter, own, &num_own);
+    for (i = num_own - 1; i >= 0; i--) {
+      elements[--count] = own[i];
+    }
+    iter = inner;
+  }
+  assert(0 == count);
+  return elements;
+}
+
 /***************************************
  * PARSE TREE PRETTY PRINTER FUNCTIONS *
  ***************************************/
@@ -544,9 +598,9 @@ void node_print_number(FILE *output, struct node *number) {
 }
 
 void node_print_string(FILE *output, struct node *string) {
-    int length = string->data.string.length;
+    int length = string_pool_length(string->data.string.name);
 
-    char *str = string->data.string.name;
+    const char *str = string_pool_text(string->data.string.name);
     int i;
     fputs("\"", output);
     for (i = 0; i < length; i++) {
@@ -582,7 +636,7 @@ void node_print_ternary_operation(FILE *output, struct node *ternary_operation)
 void node_print_identifier(FILE *output, struct node *identifier) {
   assert(NULL != identifier);
   assert(NODE_IDENTIFIER == identifier->kind);
-  fputs(identifier->data.identifier.name, output);
+  fputs(string_pool_text(identifier->data.identifier.name), output);
   fprintf(output, " /* %p */ ", (void *)identifier->data.identifier.symbol);
   /* fprintf(output, " /\* %d *\/ ", identifier->data.identifier.symbol->result.type->kind); */
 }
@@ -888,13 +942,15 @@ void node_print_function_call(FILE *output, struct node *function_call) {
 }
 
 void node_print_expression_list(FILE *output, struct node *expression_list) {
-  if(expression_list->data.expression_list.expression_list != NULL) {
-    node_print_handler(output, expression_list->data.expression_list.expression_list);
-  }
+  struct node **elements;
+  int num_elements, i;
+
+  elements = node_list_elements(expression_list, &num_elements);
+  for (i = 0; i < num_elements; i++) {
     fputs(", ", output);
-    if(NULL != expression_list->data.expression_list.assignment_expr) {
-      node_print_handler(output, expression_list->data.expression_list.assignment_expr);
-    }
+    node_print_handler(output, elements[i]);
+  }
+  free(elements);
 }
 
 void node_print_if_statement(FILE *output, struct node *statement) {
@@ -913,13 +969,17 @@ void node_print_if_statement(FILE *output, struct node *statement) {
 }
 
 void node_print_statement_list(FILE *output, struct node *statement_list) {
+  struct node **elements;
+  int num_elements, i;
+
   assert(NODE_STATEMENT_LIST == statement_list->kind);
 
-  if (NULL != statement_list->data.statement_list.init) {
-    node_print_handler(output, statement_list->data.statement_list.init);
+  elements = node_list_elements(statement_list, &num_elements);
+  for (i = 0; i < num_elements; i++) {
+    node_print_handler(output, elements[i]);
+    fputs("\n", output);
   }
-  node_print_handler(output, statement_list->data.statement_list.statement);
-  fputs("\n", output);
+  free(elements);
 }
 
 void node_print_comma_expr(FILE *output, struct node *comma_expr) {
@@ -1048,12 +1108,13 @@ void node_print_handler(FILE *output, struct node *expression) {
 }
 
 void node_print_translation_unit(FILE *output, struct node *translation_unit) {
+  struct node **elements;
+  int num_elements, i;
+
   assert(NODE_TRANSLATION_UNIT == translation_unit->kind);
-  if(translation_unit->data.translation_unit.translation_unit != NULL) {
-    assert(NODE_TRANSLATION_UNIT == translation_unit->data.translation_unit.translation_unit->kind);
-    node_print_translation_unit(output, translation_unit->data.translation_unit.translation_unit);
-  }
-  if(translation_unit->data.translation_unit.top_level_decl != NULL) {
-    node_print_handler(output, translation_unit->data.translation_unit.top_level_decl);
+  elements = node_list_elements(translation_unit, &num_elements);
+  for (i = 0; i < num_elements; i++) {
+    node_print_handler(output, elements[i]);
   }
+  free(elements);
 }
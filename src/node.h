@@ -75,13 +75,13 @@ struct node {
       bool overflow;
       struct result result;
     } number;
+    /* The text of identifiers and strings is kept in the string pool */
     struct {
-      char name[MAX_IDENTIFIER_LENGTH + 1];
+      int name;
       struct symbol *symbol;
     } identifier;
     struct {
-      char name[MAX_STRING_LENGTH + 1];
-      int length;
+      int name;
       struct result result;
     } string;
     struct {
@@ -389,5 +389,10 @@ struct node *node_initialized_decl_list(struct node *initialized_decl_list,
 
 struct result *node_get_result(struct node *expression);
 
+struct node **node_list_elements(struct node *list, int *num_elements);
+
 void node_print_translation_unit(FILE *output, struct node *translation_unit);
+
+/* Number of nodes created over the whole compilation */
+extern unsigned long node_num_created;
 #endif
@@ -0,0 +1,442 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "node.h"
+#include "symbol.h"
+#include "ir.h"
+#include "basic_blocks.h"
+#include "dataflow.h"
+#include "register_allocation.h"
+#include "arena.h"
+
+/*
+ * Linear scan register allocation (Poletto and Sarkar).
+ *
+ * Each temporary gets a single live interval over the instructions of the
+ * function, numbered in list order, from the first to the last position where
+ * it occurs or is live. Liveness is computed over the control flow graph, so
+ * a value carried around a loop keeps its register for the whole loop even
+ * when it is read before it is written. The intervals are then scanned in
+ * order of their start points; a register becomes free again as soon as the
+ * interval holding it has ended, and when no register is free the interval
+ * that ends last is spilled to a slot in the stack frame. Intervals that span
+ * a call prefer the callee-saved $s registers so that the call does not have
+ * to save them.
+ *
+ * Once registers are assigned, the same liveness finds the temporaries that
+ * are live across each call, which gives the set of $t registers the caller
+ * has to save and restore around it.
+ */
+
+static const char *syscall_builtins[] = {
+  "print_int",
+  "print_string",
+  "read_int",
+  "read_string",
+  "exit",
+  NULL
+};
+
+/*
+ * The builtins are implemented with a syscall in place of the call, which
+ * leaves every temporary register alone.
+ */
+bool register_is_syscall_builtin(struct ir_instruction *call) {
+  int i;
+  assert(IR_FUNCTION_CALL == call->kind);
+  for(i = 0; NULL != syscall_builtins[i]; i++) {
+    if(!strcmp(call->operands[0].data.symbol->name, syscall_builtins[i])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/****************************
+ * LIVE INTERVAL COMPUTATION *
+ ****************************/
+
+static void register_scan_function(struct ir_instruction *function_begin,
+                                   struct ir_instruction **function_end,
+                                   int *num_temporaries) {
+  struct ir_instruction *instruction;
+  int i;
+
+  *num_temporaries = 0;
+  for(instruction = function_begin->next;
+      instruction != NULL && instruction->kind != IR_FUNCTION_END;
+      instruction = instruction->next) {
+    for(i = 0; i < 3; i++) {
+      if(instruction->operands[i].kind == OPERAND_TEMPORARY &&
+         instruction->operands[i].data.temporary >= *num_temporaries) {
+        *num_temporaries = instruction->operands[i].data.temporary + 1;
+      }
+    }
+  }
+  assert(NULL != instruction);
+  *function_end = instruction;
+}
+
+/* Widens the interval of every temporary in the set to cover the position */
+static void register_extend_intervals(struct bit_vector *temporaries, int position,
+                                      int *starts, int *ends) {
+  int word, bit, temporary;
+
+  for(word = 0; word < temporaries->num_words; word++) {
+    if(temporaries->words[word] == 0) {
+      continue;
+    }
+    for(bit = 0; bit < 32; bit++) {
+      temporary = word * 32 + bit;
+      if(!(temporaries->words[word] & (1u << bit)) || starts[temporary] == -1) {
+        continue;
+      }
+      if(position < starts[temporary]) {
+        starts[temporary] = position;
+      }
+      if(position > ends[temporary]) {
+        ends[temporary] = position;
+      }
+    }
+  }
+}
+
+/*
+ * Whether a call lies strictly inside the interval. The call positions are
+ * in program order, so the first call after start is found by bisection.
+ */
+static bool register_crosses_call(int *call_positions, int num_calls, int start, int end) {
+  int low = 0, high = num_calls, middle;
+
+  while(low < high) {
+    middle = (low + high) / 2;
+    if(call_positions[middle] <= start) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low < num_calls && call_positions[low] < end;
+}
+
+/*
+ * Fills in one interval per temporary that occurs in the function and
+ * returns how many there are.
+ */
+static int register_compute_live_intervals(struct control_flow_graph *cfg,
+                                           struct dataflow *liveness,
+                                           int num_temporaries, bool *is_immediate,
+                                           struct live_interval *intervals) {
+  struct ir_instruction *instruction;
+  int *starts, *ends, *call_positions;
+  int position, i, number, num_intervals, num_calls;
+
+  starts = arena_allocate(&optimizer_arena, sizeof(int) * (num_temporaries + 1));
+  ends = arena_allocate(&optimizer_arena, sizeof(int) * (num_temporaries + 1));
+
+  num_calls = 0;
+  for(instruction = cfg->function_begin->next; instruction != cfg->function_end;
+      instruction = instruction->next) {
+    if(instruction->kind == IR_FUNCTION_CALL) {
+      num_calls++;
+    }
+  }
+  call_positions = arena_allocate(&optimizer_arena, sizeof(int) * (num_calls + 1));
+  num_calls = 0;
+  for(i = 0; i < num_temporaries; i++) {
+    starts[i] = -1;
+    ends[i] = -1;
+  }
+
+  position = 0;
+  for(instruction = cfg->function_begin->next; instruction != cfg->function_end;
+      instruction = instruction->next) {
+    position++;
+    for(i = 0; i < 3; i++) {
+      if(instruction->operands[i].kind == OPERAND_TEMPORARY) {
+        int temporary = instruction->operands[i].data.temporary;
+        if(starts[temporary] == -1) {
+          starts[temporary] = position;
+        }
+        ends[temporary] = position;
+      }
+    }
+    if(instruction->kind == IR_FUNCTION_CALL && !register_is_syscall_builtin(instruction)) {
+      call_positions[num_calls++] = position;
+    }
+  }
+
+  /* A temporary can be live where it does not occur, around a loop or from
+   * a definition further down to a use the branches lead back to, so the
+   * interval also covers every block it is live into or out of. The blocks
+   * are laid out in program order from the IR_FUNCTION_BEGIN at position 0. */
+  position = 0;
+  instruction = cfg->function_begin;
+  for(number = 0; number < cfg->num_blocks; number++) {
+    assert(instruction == cfg->blocks[number]->beginning);
+    register_extend_intervals(&liveness->in[number], position, starts, ends);
+    while(instruction != cfg->blocks[number]->end) {
+      instruction = instruction->next;
+      position++;
+    }
+    register_extend_intervals(&liveness->out[number], position, starts, ends);
+    instruction = instruction->next;
+    position++;
+  }
+
+  num_intervals = 0;
+  for(i = 0; i < num_temporaries; i++) {
+    if(starts[i] != -1 && (NULL == is_immediate || !is_immediate[i])) {
+      intervals[num_intervals].temporary = i;
+      intervals[num_intervals].start = starts[i];
+      intervals[num_intervals].end = ends[i];
+      intervals[num_intervals].crosses_call =
+        register_crosses_call(call_positions, num_calls, starts[i], ends[i]);
+      num_intervals++;
+    }
+  }
+
+  return num_intervals;
+}
+
+static int register_compare_interval_starts(const void *a, const void *b) {
+  const struct live_interval *left = a, *right = b;
+  if(left->start != right->start) {
+    return left->start - right->start;
+  }
+  return left->temporary - right->temporary;
+}
+
+/******************
+ * LINEAR SCAN *
+ ******************/
+
+static void register_spill(struct register_allocation *allocation, int temporary) {
+  allocation->registers[temporary] = REG_EXHAUSTED;
+  allocation->spill_slots[temporary] = allocation->num_spill_slots++;
+}
+
+/* Inserts an interval into the active list, which is kept sorted by end point. */
+static void register_add_active(struct live_interval **active, int *num_active,
+                                struct live_interval *interval) {
+  int i = *num_active;
+  while(i > 0 && active[i - 1]->end > interval->end) {
+    active[i] = active[i - 1];
+    i--;
+  }
+  active[i] = interval;
+  (*num_active)++;
+}
+
+/*
+ * Picks a free register, trying the callee-saved ones first for values that
+ * have to survive a call and last for everything else.
+ */
+static int register_choose_free(bool *register_is_free, bool crosses_call) {
+  int reg;
+  if(crosses_call) {
+    for(reg = FIRST_CALLEE_SAVED_REGISTER; reg <= LAST_CALLEE_SAVED_REGISTER; reg++) {
+      if(register_is_free[reg]) {
+        return reg;
+      }
+    }
+  }
+  for(reg = FIRST_USABLE_REGISTER; reg <= LAST_USABLE_REGISTER; reg++) {
+    if(register_is_free[reg]) {
+      return reg;
+    }
+  }
+  return REG_EXHAUSTED;
+}
+
+static void register_linear_scan(struct register_allocation *allocation,
+                                 struct live_interval *intervals, int num_intervals) {
+  struct live_interval *active[LAST_USABLE_REGISTER - FIRST_USABLE_REGISTER + 1];
+  bool register_is_free[NUM_REGISTERS];
+  int num_active = 0;
+  int i, j, reg;
+
+  for(reg = 0; reg < NUM_REGISTERS; reg++) {
+    register_is_free[reg] = (reg >= FIRST_USABLE_REGISTER && reg <= LAST_USABLE_REGISTER);
+  }
+
+  qsort(intervals, num_intervals, sizeof(struct live_interval), register_compare_interval_starts);
+
+  for(i = 0; i < num_intervals; i++) {
+    struct live_interval *interval = &intervals[i];
+
+    /* Expire the intervals that ended before this one starts. An interval
+     * ending at this very instruction keeps its register, so a destination
+     * never shares a register with one of its sources. */
+    for(j = 0; j < num_active && active[j]->end < interval->start; j++) {
+      register_is_free[allocation->registers[active[j]->temporary]] = true;
+    }
+    if(j > 0) {
+      memmove(&active[0], &active[j], sizeof(struct live_interval *) * (num_active - j));
+      num_active -= j;
+    }
+
+    reg = register_choose_free(register_is_free, interval->crosses_call);
+    if(reg != REG_EXHAUSTED) {
+      register_is_free[reg] = false;
+      allocation->registers[interval->temporary] = reg;
+      register_add_active(active, &num_active, interval);
+    } else {
+      /* Out of registers: spill whichever of the active intervals and this
+       * one reaches furthest. */
+      struct live_interval *last = active[num_active - 1];
+      if(last->end > interval->end) {
+        allocation->registers[interval->temporary] = allocation->registers[last->temporary];
+        register_spill(allocation, last->temporary);
+        num_active--;
+        register_add_active(active, &num_active, interval);
+      } else {
+        register_spill(allocation, interval->temporary);
+      }
+    }
+  }
+}
+
+/******************************
+ * LIVENESS ACROSS CALL SITES *
+ ******************************/
+
+/* The caller-saved registers that hold the temporaries in the set */
+static unsigned int register_caller_saved_in(struct register_allocation *allocation,
+                                             struct bit_vector *temporaries) {
+  unsigned int live_registers = 0;
+  int word, bit, reg;
+
+  for(word = 0; word < temporaries->num_words; word++) {
+    if(temporaries->words[word] == 0) {
+      continue;
+    }
+    for(bit = 0; bit < 32; bit++) {
+      if(!(temporaries->words[word] & (1u << bit))) {
+        continue;
+      }
+      reg = allocation->registers[word * 32 + bit];
+      if(reg != REG_EXHAUSTED &&
+         (reg < FIRST_CALLEE_SAVED_REGISTER || reg > LAST_CALLEE_SAVED_REGISTER)) {
+        live_registers |= 1u << reg;
+      }
+    }
+  }
+  return live_registers;
+}
+
+/*
+ * The live-out set of each block is stepped backwards to every call in it; the temporaries live
+ * right after a call give its caller-saved registers.
+ */
+static void register_compute_call_sites(struct register_allocation *allocation,
+                                       struct control_flow_graph *cfg,
+                                       struct dataflow *liveness) {
+  struct ir_instruction *instruction;
+  struct bit_vector live;
+  int num_call_sites, call_site, number;
+
+  num_call_sites = 0;
+  for(instruction = allocation->function_begin->next; instruction != allocation->function_end;
+      instruction = instruction->next) {
+    if(instruction->kind == IR_FUNCTION_CALL && !register_is_syscall_builtin(instruction)) {
+      num_call_sites++;
+    }
+  }
+  allocation->num_call_sites = num_call_sites;
+  allocation->next_call_site = 0;
+  allocation->call_sites = arena_allocate(&optimizer_arena, sizeof(struct call_site) * (num_call_sites + 1));
+  if(num_call_sites == 0) {
+    return;
+  }
+
+  bit_vector_initialize(&live, allocation->num_temporaries);
+
+  /* Walk the blocks backwards so the call sites come out in program order */
+  call_site = num_call_sites;
+  for(number = cfg->num_blocks - 1; number >= 0; number--) {
+    bit_vector_copy(&live, &liveness->out[number]);
+    for(instruction = cfg->blocks[number]->end; ; instruction = instruction->prev) {
+      if(instruction->kind == IR_FUNCTION_CALL && !register_is_syscall_builtin(instruction)) {
+        call_site--;
+        allocation->call_sites[call_site].call = instruction;
+        allocation->call_sites[call_site].live_registers =
+          register_caller_saved_in(allocation, &live);
+      }
+      dataflow_live_transfer(&live, instruction);
+      if(instruction == cfg->blocks[number]->beginning) {
+        break;
+      }
+    }
+  }
+  assert(call_site == 0);
+}
+
+/*
+ * Returns the caller-saved registers that have to be preserved around the
+ * given call. Calls to syscall builtins never need any. The backend asks
+ * about the calls in program order, which is the order of the call sites,
+ * so the next one is always the call asked about.
+ */
+unsigned int register_live_across_call(struct register_allocation *allocation,
+                                       struct ir_instruction *call) {
+  struct call_site *call_site;
+
+  if(register_is_syscall_builtin(call)) {
+    return 0;
+  }
+  assert(allocation->next_call_site < allocation->num_call_sites);
+  call_site = &allocation->call_sites[allocation->next_call_site++];
+  assert(call_site->call == call);
+  return call_site->live_registers;
+}
+
+/*
+ * Allocates registers for the temporaries of the function starting at the
+ * given IR_FUNCTION_BEGIN instruction. The temporaries marked in is_immediate,
+ * which may be NULL, are constants that the backend never keeps in a register;
+ * they get neither a register nor a spill slot.
+ */
+struct register_allocation *register_allocate_for_function(struct ir_instruction *function_begin,
+                                                           bool *is_immediate) {
+  struct register_allocation *allocation;
+  struct live_interval *intervals;
+  struct control_flow_graph *cfg;
+  struct dataflow *liveness;
+  int num_intervals, i;
+
+  assert(IR_FUNCTION_BEGIN == function_begin->kind);
+
+  allocation = arena_allocate(&optimizer_arena, sizeof(struct register_allocation));
+  allocation->function_begin = function_begin;
+  register_scan_function(function_begin, &allocation->function_end,
+                         &allocation->num_temporaries);
+
+  allocation->registers = arena_allocate(&optimizer_arena, sizeof(int) * (allocation->num_temporaries + 1));
+  allocation->spill_slots = arena_allocate(&optimizer_arena, sizeof(int) * (allocation->num_temporaries + 1));
+  for(i = 0; i < allocation->num_temporaries; i++) {
+    allocation->registers[i] = REG_EXHAUSTED;
+    allocation->spill_slots[i] = -1;
+  }
+  allocation->num_spill_slots = 0;
+
+  intervals = arena_allocate(&optimizer_arena, sizeof(struct live_interval) * (allocation->num_temporaries + 1));
+  cfg = cfg_build_for_function(function_begin);
+  liveness = dataflow_compute_liveness(cfg, allocation->num_temporaries);
+  num_intervals = register_compute_live_intervals(cfg, liveness, allocation->num_temporaries,
+                                                  is_immediate, intervals);
+  register_linear_scan(allocation, intervals, num_intervals);
+
+  allocation->used_registers = 0;
+  for(i = 0; i < allocation->num_temporaries; i++) {
+    if(allocation->registers[i] != REG_EXHAUSTED) {
+      allocation->used_registers |= 1u << allocation->registers[i];
+    }
+  }
+
+  register_compute_call_sites(allocation, cfg, liveness);
+
+  return allocation;
+}
@@ -0,0 +1,68 @@
+#ifndef _REGISTER_ALLOCATION_H
+#define _REGISTER_ALLOCATION_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+struct ir_instruction;
+
+#define REG_EXHAUSTED              -1
+
+#define FIRST_USABLE_REGISTER       8
+#define LAST_USABLE_REGISTER       23
+#define NUM_REGISTERS              32
+
+/* $s0..$s7 are preserved by the callee, $t0..$t7 have to be saved by the caller */
+#define FIRST_CALLEE_SAVED_REGISTER  16
+#define LAST_CALLEE_SAVED_REGISTER   23
+
+/* $t8 and $t9 are never handed out; they hold spilled temporaries
+ * for the duration of a single instruction. */
+#define FIRST_SPILL_REGISTER       24
+#define SECOND_SPILL_REGISTER      25
+
+struct live_interval {
+  int temporary;
+  int start, end;
+  bool crosses_call;
+};
+
+/*
+ * A call to a function other than a syscall builtin, and the caller-saved
+ * registers (bit N for $N) that hold temporaries still live after it.
+ */
+struct call_site {
+  struct ir_instruction *call;
+  unsigned int live_registers;
+};
+
+/*
+ * The result of allocating registers for one function. Both arrays are
+ * indexed by the temporary number; a temporary that does not occur in the
+ * function has register REG_EXHAUSTED and spill slot -1. used_registers has
+ * bit N set if $N is handed out to some temporary. The call sites are in
+ * program order, and next_call_site is the one register_live_across_call
+ * answers for next.
+ */
+struct register_allocation {
+  struct ir_instruction *function_begin, *function_end;
+  int num_temporaries;
+  int *registers;
+  int *spill_slots;
+  int num_spill_slots;
+  unsigned int used_registers;
+  struct call_site *call_sites;
+  int num_call_sites;
+  int next_call_site;
+};
+
+bool register_is_syscall_builtin(struct ir_instruction *call);
+
+unsigned int register_live_across_call(struct register_allocation *allocation,
+                                       struct ir_instruction *call);
+
+/* The allocation lives in optimizer_arena until it is reset */
+struct register_allocation *register_allocate_for_function(struct ir_instruction *function_begin,
+                                                           bool *is_immediate);
+
+#endif /* _REGISTER_ALLOCATION_H */
@@ -0,0 +1,1145 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+/*
+ * A small MIPS32 simulator for the assembly that mips_print_program emits.
+ *
+ * It understands the subset of SPIM syntax the backend produces (.data,
+ * .text, .globl, .asciiz, .word, .space, labels, numeric and symbolic register
+ * names, the usual pseudo-instructions) and the print_int, print_string,
+ * read_int, read_string and exit syscalls. After the program exits it reports
+ * dynamic instruction counts and a simple cycle estimate so that changes to
+ * the compiler can be measured without an external SPIM.
+ *
+ * Cycle model: every native instruction costs one cycle. Loads cost one
+ * extra cycle, taken branches and jumps cost one extra cycle (no delay
+ * slots are simulated), mult/multu cost 4 extra cycles and div/divu cost 32.
+ * Pseudo-instructions are charged as the number of native instructions the
+ * assembler would expand them into.
+ */
+
+#define MAX_LINE_LENGTH            1024
+#define MAX_LABEL_LENGTH            128
+
+#define TEXT_BASE           0x00400000u
+#define DATA_BASE           0x10010000u
+#define DATA_SIZE             0x100000u
+#define STACK_TOP           0x7ffffffcu
+#define STACK_SIZE            0x400000u
+#define EXIT_ADDRESS        0x00000004u
+
+#define MAX_OPERANDS                  3
+
+#define SIM_OPERAND_NONE                  0
+#define SIM_OPERAND_REGISTER              1
+#define SIM_OPERAND_IMMEDIATE             2
+#define SIM_OPERAND_LABEL                 3
+#define SIM_OPERAND_MEMORY                4
+
+/* Opcodes the mnemonics are decoded into when the program is loaded */
+#define SIM_OP_UNKNOWN              0
+#define SIM_OP_ADD                  1
+#define SIM_OP_SUB                  2
+#define SIM_OP_AND                  3
+#define SIM_OP_OR                   4
+#define SIM_OP_XOR                  5
+#define SIM_OP_NOR                  6
+#define SIM_OP_NOT                  7
+#define SIM_OP_NEG                  8
+#define SIM_OP_MOVE                 9
+#define SIM_OP_SLT                 10
+#define SIM_OP_SLTU                11
+#define SIM_OP_SLE                 12
+#define SIM_OP_SLEU                13
+#define SIM_OP_SGT                 14
+#define SIM_OP_SGTU                15
+#define SIM_OP_SGE                 16
+#define SIM_OP_SGEU                17
+#define SIM_OP_SEQ                 18
+#define SIM_OP_SNE                 19
+#define SIM_OP_SLL                 20
+#define SIM_OP_SRL                 21
+#define SIM_OP_SRA                 22
+#define SIM_OP_LI                  23
+#define SIM_OP_LUI                 24
+#define SIM_OP_LA                  25
+#define SIM_OP_LW                  26
+#define SIM_OP_LH                  27
+#define SIM_OP_LHU                 28
+#define SIM_OP_LB                  29
+#define SIM_OP_LBU                 30
+#define SIM_OP_SW                  31
+#define SIM_OP_SH                  32
+#define SIM_OP_SB                  33
+#define SIM_OP_MULT                34
+#define SIM_OP_MULTU               35
+#define SIM_OP_DIV                 36
+#define SIM_OP_DIVU                37
+#define SIM_OP_MFLO                38
+#define SIM_OP_MFHI                39
+#define SIM_OP_BEQ                 40
+#define SIM_OP_BNE                 41
+#define SIM_OP_BEQZ                42
+#define SIM_OP_BNEZ                43
+#define SIM_OP_BLEZ                44
+#define SIM_OP_BGTZ                45
+#define SIM_OP_BLTZ                46
+#define SIM_OP_BGEZ                47
+#define SIM_OP_BLT                 48
+#define SIM_OP_BLE                 49
+#define SIM_OP_BGT                 50
+#define SIM_OP_BGE                 51
+#define SIM_OP_BLTU                52
+#define SIM_OP_BLEU                53
+#define SIM_OP_BGTU                54
+#define SIM_OP_BGEU                55
+#define SIM_OP_JUMP                56
+#define SIM_OP_JAL                 57
+#define SIM_OP_JALR                58
+#define SIM_OP_JR                  59
+#define SIM_OP_SYSCALL             60
+#define SIM_OP_NOP                 61
+
+/* Label operands are resolved to addresses, kept in immediate, after loading */
+struct sim_operand {
+  int kind;
+  int reg;
+  long immediate;
+  char label[MAX_LABEL_LENGTH];
+};
+
+struct sim_instruction {
+  char mnemonic[16];
+  int opcode;
+  int num_operands;
+  struct sim_operand operands[MAX_OPERANDS];
+  int line_number;
+};
+
+struct sim_label {
+  char name[MAX_LABEL_LENGTH];
+  unsigned int address;
+  struct sim_label *next;
+};
+
+struct sim_statistics {
+  unsigned long instructions;
+  unsigned long native_instructions;
+  unsigned long loads;
+  unsigned long stores;
+  unsigned long branches;
+  unsigned long branches_taken;
+  unsigned long jumps;
+  unsigned long calls;
+  unsigned long multiplies;
+  unsigned long divides;
+  unsigned long syscalls;
+  unsigned long cycles;
+};
+
+static struct sim_instruction *text;
+static int text_size, text_capacity;
+
+static unsigned char *data;
+static unsigned int data_size;
+
+static unsigned char *stack;
+
+static struct sim_label *labels;
+
+static unsigned int registers[32];
+static unsigned int hi, lo;
+
+static struct sim_statistics statistics;
+
+static int simulator_num_errors;
+
+/************************
+ * REGISTERS AND LABELS *
+ ************************/
+
+static const char *register_names[32] = {
+  "zero", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+  "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+  "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+  "t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra"
+};
+
+static int sim_parse_register(const char *text_of_register) {
+  int i;
+  assert('$' == text_of_register[0]);
+  text_of_register++;
+  if(isdigit((unsigned char)text_of_register[0])) {
+    i = atoi(text_of_register);
+    return (i >= 0 && i < 32) ? i : -1;
+  }
+  if(!strcmp(text_of_register, "0")) {
+    return 0;
+  }
+  if(!strcmp(text_of_register, "s8")) {
+    return 30;
+  }
+  for(i = 0; i < 32; i++) {
+    if(!strcmp(text_of_register, register_names[i])) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void sim_add_label(const char *name, unsigned int address) {
+  struct sim_label *label = malloc(sizeof(struct sim_label));
+  assert(NULL != label);
+  strncpy(label->name, name, MAX_LABEL_LENGTH - 1);
+  label->name[MAX_LABEL_LENGTH - 1] = 0;
+  label->address = address;
+  label->next = labels;
+  labels = label;
+}
+
+static bool sim_find_label(const char *name, unsigned int *address) {
+  struct sim_label *label;
+  for(label = labels; NULL != label; label = label->next) {
+    if(!strcmp(label->name, name)) {
+      *address = label->address;
+      return true;
+    }
+  }
+  return false;
+}
+
+/********************
+ * ASSEMBLY PARSING *
+ ********************/
+
+static void sim_error(int line_number, const char *message, const char *detail) {
+  fprintf(stderr, "simulator: line %d: %s %s\n", line_number, message, detail);
+  simulator_num_errors++;
+}
+
+static char *sim_skip_spaces(char *p) {
+  while(*p != '\0' && isspace((unsigned char)*p)) {
+    p++;
+  }
+  return p;
+}
+
+/* Strips a '#' comment, taking care not to cut a string literal short. */
+static void sim_strip_comment(char *line) {
+  bool in_string = false;
+  char *p;
+  for(p = line; *p != '\0'; p++) {
+    if(in_string && *p == '\\' && p[1] != '\0') {
+      p++;
+    } else if(*p == '"') {
+      in_string = !in_string;
+    } else if(!in_string && *p == '#') {
+      *p = '\0';
+      return;
+    }
+  }
+}
+
+static void sim_ensure_data(unsigned int size) {
+  if(data_size + size > DATA_SIZE) {
+    fprintf(stderr, "simulator: data segment overflow\n");
+    exit(1);
+  }
+}
+
+static void sim_parse_asciiz(char *p, int line_number) {
+  p = sim_skip_spaces(p);
+  if(*p != '"') {
+    sim_error(line_number, "expected a string after", ".asciiz");
+    return;
+  }
+  p++;
+  while(*p != '\0' && *p != '"') {
+    int c = (unsigned char)*p++;
+    if(c == '\\') {
+      c = (unsigned char)*p++;
+      switch(c) {
+        case 'n': c = '\n'; break;
+        case 't': c = '\t'; break;
+        case 'r': c = '\r'; break;
+        case '0': c = '\0'; break;
+        case '\\': c = '\\'; break;
+        case '"': c = '"'; break;
+        case '\0': p--; c = '\\'; break;
+        default: break;
+      }
+    }
+    sim_ensure_data(1);
+    data[data_size++] = (unsigned char)c;
+  }
+  sim_ensure_data(1);
+  data[data_size++] = 0;
+}
+
+static void sim_parse_operand(char *token, struct sim_operand *operand, int line_number) {
+  char *paren;
+  memset(operand, 0, sizeof(struct sim_operand));
+  token = sim_skip_spaces(token);
+  paren = strchr(token, '(');
+  if(NULL != paren) {
+    char *close = strchr(paren, ')');
+    operand->kind = SIM_OPERAND_MEMORY;
+    *paren = '\0';
+    if(NULL != close) {
+      *close = '\0';
+    }
+    operand->immediate = (*sim_skip_spaces(token) == '\0') ? 0 : strtol(token, NULL, 0);
+    operand->reg = sim_parse_register(sim_skip_spaces(paren + 1));
+    if(operand->reg < 0) {
+      sim_error(line_number, "unknown register", paren + 1);
+    }
+  } else if(token[0] == '$') {
+    operand->kind = SIM_OPERAND_REGISTER;
+    operand->reg = sim_parse_register(token);
+    if(operand->reg < 0) {
+      sim_error(line_number, "unknown register", token);
+    }
+  } else if(isdigit((unsigned char)token[0]) || token[0] == '-' || token[0] == '+') {
+    operand->kind = SIM_OPERAND_IMMEDIATE;
+    operand->immediate = strtol(token, NULL, 0);
+  } else {
+    operand->kind = SIM_OPERAND_LABEL;
+    strncpy(operand->label, token, MAX_LABEL_LENGTH - 1);
+  }
+}
+
+static void sim_add_instruction(char *p, int line_number) {
+  struct sim_instruction *instruction;
+  char *mnemonic_end, *token;
+  int length;
+
+  if(text_size == text_capacity) {
+    text_capacity = (text_capacity == 0) ? 256 : text_capacity * 2;
+    text = realloc(text, text_capacity * sizeof(struct sim_instruction));
+    assert(NULL != text);
+  }
+  instruction = &text[text_size++];
+  memset(instruction, 0, sizeof(struct sim_instruction));
+  instruction->line_number = line_number;
+
+  mnemonic_end = p;
+  while(*mnemonic_end != '\0' && !isspace((unsigned char)*mnemonic_end)) {
+    mnemonic_end++;
+  }
+  length = mnemonic_end - p;
+  if(length >= (int)sizeof(instruction->mnemonic)) {
+    length = sizeof(instruction->mnemonic) - 1;
+  }
+  memcpy(instruction->mnemonic, p, length);
+
+  p = sim_skip_spaces(mnemonic_end);
+  while(*p != '\0' && instruction->num_operands < MAX_OPERANDS) {
+    char *end;
+    token = p;
+    end = strchr(p, ',');
+    if(NULL != end) {
+      *end = '\0';
+      p = end + 1;
+    } else {
+      p += strlen(p);
+    }
+    /* trim trailing spaces */
+    end = token + strlen(token);
+    while(end > token && isspace((unsigned char)end[-1])) {
+      *--end = '\0';
+    }
+    token = sim_skip_spaces(token);
+    if(*token != '\0') {
+      sim_parse_operand(token, &instruction->operands[instruction->num_operands++], line_number);
+    }
+    p = sim_skip_spaces(p);
+  }
+}
+
+static void sim_load_program(FILE *input) {
+  char line[MAX_LINE_LENGTH];
+  bool in_data = false;
+  int line_number = 0;
+
+  while(NULL != fgets(line, sizeof(line), input)) {
+    char *p, *colon;
+    line_number++;
+    sim_strip_comment(line);
+    p = sim_skip_spaces(line);
+
+    /* Labels, possibly followed by a directive or instruction */
+    colon = strchr(p, ':');
+    while(NULL != colon && (strchr(p, '"') == NULL || colon < strchr(p, '"'))) {
+      char name[MAX_LABEL_LENGTH];
+      int length = colon - p;
+      if(length >= MAX_LABEL_LENGTH) {
+        length = MAX_LABEL_LENGTH - 1;
+      }
+      memcpy(name, p, length);
+      name[length] = '\0';
+      if(in_data) {
+        sim_add_label(name, DATA_BASE + data_size);
+      } else {
+        sim_add_label(name, TEXT_BASE + 4 * text_size);
+      }
+      p = sim_skip_spaces(colon + 1);
+      colon = strchr(p, ':');
+    }
+
+    if(*p == '\0') {
+      continue;
+    }
+
+    if(*p == '.') {
+      if(!strncmp(p, ".data", 5)) {
+        in_data = true;
+      } else if(!strncmp(p, ".text", 5)) {
+        in_data = false;
+      } else if(!strncmp(p, ".asciiz", 7)) {
+        sim_parse_asciiz(p + 7, line_number);
+      } else if(!strncmp(p, ".word", 5)) {
+        long value = strtol(p + 5, NULL, 0);
+        data_size = (data_size + 3) & ~3u;
+        sim_ensure_data(4);
+        memcpy(&data[data_size], &value, 4);
+        data_size += 4;
+      } else if(!strncmp(p, ".space", 6)) {
+        long size = strtol(p + 6, NULL, 0);
+        sim_ensure_data(size);
+        data_size += size;
+      } else if(!strncmp(p, ".align", 6)) {
+        data_size = (data_size + 3) & ~3u;
+      }
+      /* .globl and anything else is ignored */
+      continue;
+    }
+
+    if(in_data) {
+      sim_error(line_number, "instruction in data segment:", p);
+      continue;
+    }
+    sim_add_instruction(p, line_number);
+  }
+}
+
+/*
+ * Replaces every label operand by the address of the label, so that
+ * executing a branch or a load does not search the labels.
+ */
+static void sim_resolve_labels(void) {
+  struct sim_operand *operand;
+  unsigned int address;
+  int i, j;
+
+  for(i = 0; i < text_size; i++) {
+    for(j = 0; j < text[i].num_operands; j++) {
+      operand = &text[i].operands[j];
+      if(operand->kind != SIM_OPERAND_LABEL) {
+        continue;
+      }
+      if(!sim_find_label(operand->label, &address)) {
+        sim_error(text[i].line_number, "undefined label", operand->label);
+        continue;
+      }
+      operand->immediate = address;
+    }
+  }
+}
+
+static const struct {
+  const char *mnemonic;
+  int opcode;
+} opcodes[] = {
+  { "addu",     SIM_OP_ADD },
+  { "add",      SIM_OP_ADD },
+  { "addi",     SIM_OP_ADD },
+  { "addiu",    SIM_OP_ADD },
+  { "subu",     SIM_OP_SUB },
+  { "sub",      SIM_OP_SUB },
+  { "and",      SIM_OP_AND },
+  { "andi",     SIM_OP_AND },
+  { "or",       SIM_OP_OR },
+  { "ori",      SIM_OP_OR },
+  { "xor",      SIM_OP_XOR },
+  { "xori",     SIM_OP_XOR },
+  { "nor",      SIM_OP_NOR },
+  { "not",      SIM_OP_NOT },
+  { "neg",      SIM_OP_NEG },
+  { "negu",     SIM_OP_NEG },
+  { "move",     SIM_OP_MOVE },
+  { "slt",      SIM_OP_SLT },
+  { "slti",     SIM_OP_SLT },
+  { "sltu",     SIM_OP_SLTU },
+  { "sltiu",    SIM_OP_SLTU },
+  { "sle",      SIM_OP_SLE },
+  { "sleu",     SIM_OP_SLEU },
+  { "sgt",      SIM_OP_SGT },
+  { "sgtu",     SIM_OP_SGTU },
+  { "sge",      SIM_OP_SGE },
+  { "sgeu",     SIM_OP_SGEU },
+  { "seq",      SIM_OP_SEQ },
+  { "sne",      SIM_OP_SNE },
+  { "sll",      SIM_OP_SLL },
+  { "sllv",     SIM_OP_SLL },
+  { "srl",      SIM_OP_SRL },
+  { "srlv",     SIM_OP_SRL },
+  { "sra",      SIM_OP_SRA },
+  { "srav",     SIM_OP_SRA },
+  { "li",       SIM_OP_LI },
+  { "lui",      SIM_OP_LUI },
+  { "la",       SIM_OP_LA },
+  { "lw",       SIM_OP_LW },
+  { "lh",       SIM_OP_LH },
+  { "lhu",      SIM_OP_LHU },
+  { "lb",       SIM_OP_LB },
+  { "lbu",      SIM_OP_LBU },
+  { "sw",       SIM_OP_SW },
+  { "sh",       SIM_OP_SH },
+  { "sb",       SIM_OP_SB },
+  { "mult",     SIM_OP_MULT },
+  { "multu",    SIM_OP_MULTU },
+  { "div",      SIM_OP_DIV },
+  { "divu",     SIM_OP_DIVU },
+  { "mflo",     SIM_OP_MFLO },
+  { "mfhi",     SIM_OP_MFHI },
+  { "beq",      SIM_OP_BEQ },
+  { "bne",      SIM_OP_BNE },
+  { "beqz",     SIM_OP_BEQZ },
+  { "bnez",     SIM_OP_BNEZ },
+  { "blez",     SIM_OP_BLEZ },
+  { "bgtz",     SIM_OP_BGTZ },
+  { "bltz",     SIM_OP_BLTZ },
+  { "bgez",     SIM_OP_BGEZ },
+  { "blt",      SIM_OP_BLT },
+  { "ble",      SIM_OP_BLE },
+  { "bgt",      SIM_OP_BGT },
+  { "bge",      SIM_OP_BGE },
+  { "bltu",     SIM_OP_BLTU },
+  { "bleu",     SIM_OP_BLEU },
+  { "bgtu",     SIM_OP_BGTU },
+  { "bgeu",     SIM_OP_BGEU },
+  { "b",        SIM_OP_JUMP },
+  { "j",        SIM_OP_JUMP },
+  { "jal",      SIM_OP_JAL },
+  { "jalr",     SIM_OP_JALR },
+  { "jr",       SIM_OP_JR },
+  { "syscall",  SIM_OP_SYSCALL },
+  { "nop",      SIM_OP_NOP },
+  { NULL,       SIM_OP_UNKNOWN }
+};
+
+/*
+ * Decodes every mnemonic into its opcode, so that executing an instruction
+ * does not compare strings. Unknown mnemonics are only reported if they run.
+ */
+static void sim_decode_mnemonics(void) {
+  int i, j;
+
+  for(i = 0; i < text_size; i++) {
+    text[i].opcode = SIM_OP_UNKNOWN;
+    for(j = 0; opcodes[j].mnemonic != NULL; j++) {
+      if(!strcmp(opcodes[j].mnemonic, text[i].mnemonic)) {
+        text[i].opcode = opcodes[j].opcode;
+        break;
+      }
+    }
+  }
+}
+
+/*******************
+ * MEMORY ACCESSES *
+ *******************/
+
+static unsigned char *sim_memory(unsigned int address, unsigned int size, int line_number) {
+  if(address >= DATA_BASE && address + size <= DATA_BASE + DATA_SIZE) {
+    return &data[address - DATA_BASE];
+  }
+  if(address > STACK_TOP - STACK_SIZE && address + size <= STACK_TOP + 4) {
+    return &stack[address - (STACK_TOP + 4 - STACK_SIZE)];
+  }
+  fprintf(stderr, "simulator: line %d: bad memory access at 0x%08x\n", line_number, address);
+  exit(1);
+}
+
+static unsigned int sim_load(unsigned int address, int size, bool sign_extend, int line_number) {
+  unsigned char *p = sim_memory(address, size, line_number);
+  unsigned int value = 0;
+  int i;
+  if((address % size) != 0) {
+    fprintf(stderr, "simulator: line %d: unaligned load at 0x%08x\n", line_number, address);
+    exit(1);
+  }
+  for(i = size - 1; i >= 0; i--) {
+    value = (value << 8) | p[i];
+  }
+  if(sign_extend && size < 4 && (value & (1u << (8 * size - 1)))) {
+    value |= ~0u << (8 * size);
+  }
+  return value;
+}
+
+static void sim_store(unsigned int address, int size, unsigned int value, int line_number) {
+  unsigned char *p = sim_memory(address, size, line_number);
+  int i;
+  if((address % size) != 0) {
+    fprintf(stderr, "simulator: line %d: unaligned store at 0x%08x\n", line_number, address);
+    exit(1);
+  }
+  for(i = 0; i < size; i++) {
+    p[i] = (unsigned char)(value >> (8 * i));
+  }
+}
+
+/*************
+ * EXECUTION *
+ *************/
+
+static unsigned int sim_address_of(struct sim_instruction *instruction, struct sim_operand *operand) {
+  switch(operand->kind) {
+    case SIM_OPERAND_MEMORY:
+      return registers[operand->reg] + (unsigned int)operand->immediate;
+    case SIM_OPERAND_LABEL:
+    case SIM_OPERAND_IMMEDIATE:
+      return (unsigned int)operand->immediate;
+    default:
+      fprintf(stderr, "simulator: line %d: bad address operand for %s\n",
+              instruction->line_number, instruction->mnemonic);
+      exit(1);
+  }
+}
+
+/* The value of a source operand: a register or an immediate. */
+static unsigned int sim_value(struct sim_instruction *instruction, int position) {
+  struct sim_operand *operand = &instruction->operands[position];
+  if(position >= instruction->num_operands) {
+    fprintf(stderr, "simulator: line %d: missing operand for %s\n",
+            instruction->line_number, instruction->mnemonic);
+    exit(1);
+  }
+  if(operand->kind == SIM_OPERAND_REGISTER) {
+    return registers[operand->reg];
+  }
+  if(operand->kind == SIM_OPERAND_IMMEDIATE) {
+    return (unsigned int)operand->immediate;
+  }
+  return sim_address_of(instruction, operand);
+}
+
+static void sim_set(struct sim_instruction *instruction, int position, unsigned int value) {
+  struct sim_operand *operand = &instruction->operands[position];
+  if(operand->kind != SIM_OPERAND_REGISTER) {
+    fprintf(stderr, "simulator: line %d: destination of %s must be a register\n",
+            instruction->line_number, instruction->mnemonic);
+    exit(1);
+  }
+  if(operand->reg != 0) {
+    registers[operand->reg] = value;
+  }
+}
+
+/* Number of native instructions needed to load a 32-bit constant. */
+static int sim_constant_cost(unsigned int value) {
+  int signed_value = (int)value;
+  return (signed_value >= -32768 && signed_value <= 65535) ? 1 : 2;
+}
+
+/* Charges a three operand ALU instruction whose last operand may be an
+ * immediate the assembler has to materialize in $at first. */
+static int sim_alu_cost(struct sim_instruction *instruction, int base) {
+  if(instruction->num_operands == 3 && instruction->operands[2].kind == SIM_OPERAND_IMMEDIATE) {
+    return base + sim_constant_cost((unsigned int)instruction->operands[2].immediate) - 1;
+  }
+  return base;
+}
+
+static void sim_read_line(char *buffer, int length) {
+  if(length <= 0) {
+    return;
+  }
+  if(NULL == fgets(buffer, length, stdin)) {
+    buffer[0] = '\0';
+  }
+}
+
+/* Returns false when the program asked to exit. */
+static bool sim_syscall(int line_number) {
+  unsigned int service = registers[2];
+  char buffer[MAX_LINE_LENGTH];
+  unsigned int i;
+
+  statistics.syscalls++;
+  switch(service) {
+    case 1:
+      printf("%d", (int)registers[4]);
+      break;
+    case 4:
+      for(i = registers[4]; ; i++) {
+        unsigned char c = *sim_memory(i, 1, line_number);
+        if(c == 0) {
+          break;
+        }
+        putchar(c);
+      }
+      break;
+    case 5:
+      sim_read_line(buffer, sizeof(buffer));
+      registers[2] = (unsigned int)strtol(buffer, NULL, 10);
+      break;
+    case 8:
+      sim_read_line(buffer, ((int)registers[5] < (int)sizeof(buffer)) ? (int)registers[5] : (int)sizeof(buffer));
+      for(i = 0; i < strlen(buffer) + 1; i++) {
+        *sim_memory(registers[4] + i, 1, line_number) = (unsigned char)buffer[i];
+      }
+      break;
+    case 10:
+      return false;
+    case 11:
+      putchar((int)(registers[4] & 0xff));
+      break;
+    default:
+      fprintf(stderr, "simulator: line %d: unsupported syscall %u\n", line_number, service);
+      exit(1);
+  }
+  return true;
+}
+
+static int sim_instruction_index(unsigned int address, int line_number) {
+  if(address < TEXT_BASE || address >= TEXT_BASE + 4 * (unsigned int)text_size || (address & 3) != 0) {
+    fprintf(stderr, "simulator: line %d: jump to bad address 0x%08x\n", line_number, address);
+    exit(1);
+  }
+  return (address - TEXT_BASE) / 4;
+}
+
+static int sim_run(unsigned long max_instructions) {
+  unsigned int main_address;
+  int pc;
+
+  if(!sim_find_label("main", &main_address)) {
+    fprintf(stderr, "simulator: no main label\n");
+    return 1;
+  }
+  pc = sim_instruction_index(main_address, 0);
+  registers[31] = EXIT_ADDRESS;
+
+  for(;;) {
+    struct sim_instruction *instruction;
+    unsigned int a, b;
+    int cost = 1;
+    int extra_cycles = 0;
+    bool branch = false, taken = false;
+    unsigned int target = 0;
+    int next_pc = pc + 1;
+
+    if(pc < 0 || pc >= text_size) {
+      fprintf(stderr, "simulator: fell off the end of the text segment\n");
+      return 1;
+    }
+    if(max_instructions != 0 && statistics.instructions >= max_instructions) {
+      fprintf(stderr, "simulator: instruction limit reached\n");
+      return 1;
+    }
+    instruction = &text[pc];
+    statistics.instructions++;
+
+    switch(instruction->opcode) {
+      case SIM_OP_ADD:
+        cost = sim_alu_cost(instruction, 1);
+        sim_set(instruction, 0, sim_value(instruction, 1) + sim_value(instruction, 2));
+        break;
+      case SIM_OP_SUB:
+        cost = sim_alu_cost(instruction, 1);
+        sim_set(instruction, 0, sim_value(instruction, 1) - sim_value(instruction, 2));
+        break;
+      case SIM_OP_AND:
+        cost = sim_alu_cost(instruction, 1);
+        sim_set(instruction, 0, sim_value(instruction, 1) & sim_value(instruction, 2));
+        break;
+      case SIM_OP_OR:
+        cost = sim_alu_cost(instruction, 1);
+        sim_set(instruction, 0, sim_value(instruction, 1) | sim_value(instruction, 2));
+        break;
+      case SIM_OP_XOR:
+        cost = sim_alu_cost(instruction, 1);
+        sim_set(instruction, 0, sim_value(instruction, 1) ^ sim_value(instruction, 2));
+        break;
+      case SIM_OP_NOR:
+        sim_set(instruction, 0, ~(sim_value(instruction, 1) | sim_value(instruction, 2)));
+        break;
+      case SIM_OP_NOT:
+        sim_set(instruction, 0, ~sim_value(instruction, 1));
+        break;
+      case SIM_OP_NEG:
+        sim_set(instruction, 0, -sim_value(instruction, 1));
+        break;
+      case SIM_OP_MOVE:
+        sim_set(instruction, 0, sim_value(instruction, 1));
+        break;
+      case SIM_OP_SLT:
+        cost = sim_alu_cost(instruction, 1);
+        sim_set(instruction, 0, (int)sim_value(instruction, 1) < (int)sim_value(instruction, 2));
+        break;
+      case SIM_OP_SLTU:
+        cost = sim_alu_cost(instruction, 1);
+        sim_set(instruction, 0, sim_value(instruction, 1) < sim_value(instruction, 2));
+        break;
+      case SIM_OP_SLE:
+      case SIM_OP_SLEU:
+        /* slt + xori (+ $at materialization) */
+        cost = sim_alu_cost(instruction, 2);
+        a = sim_value(instruction, 1);
+        b = sim_value(instruction, 2);
+        sim_set(instruction, 0, (instruction->opcode == SIM_OP_SLEU) ? (a <= b) : ((int)a <= (int)b));
+        break;
+      case SIM_OP_SGT:
+      case SIM_OP_SGTU:
+        cost = sim_alu_cost(instruction, 1);
+        a = sim_value(instruction, 1);
+        b = sim_value(instruction, 2);
+        sim_set(instruction, 0, (instruction->opcode == SIM_OP_SGTU) ? (a > b) : ((int)a > (int)b));
+        break;
+      case SIM_OP_SGE:
+      case SIM_OP_SGEU:
+        cost = sim_alu_cost(instruction, 2);
+        a = sim_value(instruction, 1);
+        b = sim_value(instruction, 2);
+        sim_set(instruction, 0, (instruction->opcode == SIM_OP_SGEU) ? (a >= b) : ((int)a >= (int)b));
+        break;
+      case SIM_OP_SEQ:
+        /* xor + sltiu */
+        cost = sim_alu_cost(instruction, 2);
+        sim_set(instruction, 0, sim_value(instruction, 1) == sim_value(instruction, 2));
+        break;
+      case SIM_OP_SNE:
+        /* xor + sltu */
+        cost = sim_alu_cost(instruction, 2);
+        sim_set(instruction, 0, sim_value(instruction, 1) != sim_value(instruction, 2));
+        break;
+      case SIM_OP_SLL:
+        sim_set(instruction, 0, sim_value(instruction, 1) << (sim_value(instruction, 2) & 31));
+        break;
+      case SIM_OP_SRL:
+        sim_set(instruction, 0, sim_value(instruction, 1) >> (sim_value(instruction, 2) & 31));
+        break;
+      case SIM_OP_SRA:
+        a = sim_value(instruction, 1);
+        b = sim_value(instruction, 2) & 31;
+        sim_set(instruction, 0, (a & 0x80000000u) && b ? (a >> b) | (~0u << (32 - b)) : a >> b);
+        break;
+      case SIM_OP_LI:
+        a = sim_value(instruction, 1);
+        cost = sim_constant_cost(a);
+        sim_set(instruction, 0, a);
+        break;
+      case SIM_OP_LUI:
+        sim_set(instruction, 0, sim_value(instruction, 1) << 16);
+        break;
+      case SIM_OP_LA:
+        /* An address in a register plus an offset is a single addi */
+        a = sim_address_of(instruction, &instruction->operands[1]);
+        cost = (instruction->operands[1].kind == SIM_OPERAND_MEMORY) ? 1 : 2;
+        sim_set(instruction, 0, a);
+        break;
+      case SIM_OP_LW:
+      case SIM_OP_LH:
+      case SIM_OP_LHU:
+      case SIM_OP_LB:
+      case SIM_OP_LBU: {
+        int opcode = instruction->opcode;
+        int size = (opcode == SIM_OP_LW) ? 4 : ((opcode == SIM_OP_LH || opcode == SIM_OP_LHU) ? 2 : 1);
+        a = sim_address_of(instruction, &instruction->operands[1]);
+        if(instruction->operands[1].kind == SIM_OPERAND_LABEL) {
+          cost = 2;
+        }
+        sim_set(instruction, 0, sim_load(a, size, opcode != SIM_OP_LHU && opcode != SIM_OP_LBU,
+                                         instruction->line_number));
+        statistics.loads++;
+        extra_cycles = 1;
+        break;
+      }
+      case SIM_OP_SW:
+      case SIM_OP_SH:
+      case SIM_OP_SB: {
+        int opcode = instruction->opcode;
+        int size = (opcode == SIM_OP_SW) ? 4 : ((opcode == SIM_OP_SH) ? 2 : 1);
+        a = sim_address_of(instruction, &instruction->operands[1]);
+        if(instruction->operands[1].kind == SIM_OPERAND_LABEL) {
+          cost = 2;
+        }
+        sim_store(a, size, sim_value(instruction, 0), instruction->line_number);
+        statistics.stores++;
+        break;
+      }
+      case SIM_OP_MULT:
+      case SIM_OP_MULTU: {
+        unsigned long long product;
+        if(instruction->opcode == SIM_OP_MULTU) {
+          product = (unsigned long long)sim_value(instruction, 0) * sim_value(instruction, 1);
+        } else {
+          product = (unsigned long long)((long long)(int)sim_value(instruction, 0) *
+                                         (long long)(int)sim_value(instruction, 1));
+        }
+        lo = (unsigned int)product;
+        hi = (unsigned int)(product >> 32);
+        statistics.multiplies++;
+        extra_cycles = 4;
+        break;
+      }
+      case SIM_OP_DIV:
+      case SIM_OP_DIVU:
+        a = sim_value(instruction, 0);
+        b = sim_value(instruction, 1);
+        if(b == 0) {
+          fprintf(stderr, "simulator: line %d: division by zero\n", instruction->line_number);
+          return 1;
+        }
+        if(instruction->opcode == SIM_OP_DIVU) {
+          lo = a / b;
+          hi = a % b;
+        } else if((int)a == (int)0x80000000 && (int)b == -1) {
+          lo = a;
+          hi = 0;
+        } else {
+          lo = (unsigned int)((int)a / (int)b);
+          hi = (unsigned int)((int)a % (int)b);
+        }
+        statistics.divides++;
+        extra_cycles = 32;
+        break;
+      case SIM_OP_MFLO:
+        sim_set(instruction, 0, lo);
+        break;
+      case SIM_OP_MFHI:
+        sim_set(instruction, 0, hi);
+        break;
+      case SIM_OP_BEQ:
+      case SIM_OP_BNE:
+        branch = true;
+        a = sim_value(instruction, 0);
+        b = sim_value(instruction, 1);
+        taken = (instruction->opcode == SIM_OP_BEQ) ? (a == b) : (a != b);
+        target = sim_address_of(instruction, &instruction->operands[2]);
+        break;
+      case SIM_OP_BEQZ:
+      case SIM_OP_BNEZ:
+        branch = true;
+        a = sim_value(instruction, 0);
+        taken = (instruction->opcode == SIM_OP_BEQZ) ? (a == 0) : (a != 0);
+        target = sim_address_of(instruction, &instruction->operands[1]);
+        break;
+      case SIM_OP_BLEZ:
+      case SIM_OP_BGTZ:
+      case SIM_OP_BLTZ:
+      case SIM_OP_BGEZ: {
+        int value = (int)sim_value(instruction, 0);
+        branch = true;
+        if(instruction->opcode == SIM_OP_BLEZ) {
+          taken = value <= 0;
+        } else if(instruction->opcode == SIM_OP_BGTZ) {
+          taken = value > 0;
+        } else if(instruction->opcode == SIM_OP_BLTZ) {
+          taken = value < 0;
+        } else {
+          taken = value >= 0;
+        }
+        target = sim_address_of(instruction, &instruction->operands[1]);
+        break;
+      }
+      case SIM_OP_BLT:
+      case SIM_OP_BLE:
+      case SIM_OP_BGT:
+      case SIM_OP_BGE:
+      case SIM_OP_BLTU:
+      case SIM_OP_BLEU:
+      case SIM_OP_BGTU:
+      case SIM_OP_BGEU: {
+        /* slt + beq/bne */
+        int opcode = instruction->opcode;
+        bool is_unsigned = (opcode == SIM_OP_BLTU || opcode == SIM_OP_BLEU ||
+                            opcode == SIM_OP_BGTU || opcode == SIM_OP_BGEU);
+        long long left, right;
+        cost = sim_alu_cost(instruction, 2);
+        a = sim_value(instruction, 0);
+        b = sim_value(instruction, 1);
+        left = is_unsigned ? (long long)a : (long long)(int)a;
+        right = is_unsigned ? (long long)b : (long long)(int)b;
+        branch = true;
+        if(opcode == SIM_OP_BLT || opcode == SIM_OP_BLTU) {
+          taken = left < right;
+        } else if(opcode == SIM_OP_BLE || opcode == SIM_OP_BLEU) {
+          taken = left <= right;
+        } else if(opcode == SIM_OP_BGT || opcode == SIM_OP_BGTU) {
+          taken = left > right;
+        } else {
+          taken = left >= right;
+        }
+        target = sim_address_of(instruction, &instruction->operands[2]);
+        break;
+      }
+      case SIM_OP_JUMP:
+        statistics.jumps++;
+        taken = true;
+        target = sim_address_of(instruction, &instruction->operands[0]);
+        break;
+      case SIM_OP_JAL:
+        statistics.jumps++;
+        statistics.calls++;
+        taken = true;
+        registers[31] = TEXT_BASE + 4 * (pc + 1);
+        target = sim_address_of(instruction, &instruction->operands[0]);
+        break;
+      case SIM_OP_JALR:
+        statistics.jumps++;
+        statistics.calls++;
+        taken = true;
+        target = sim_value(instruction, 0);
+        registers[31] = TEXT_BASE + 4 * (pc + 1);
+        break;
+      case SIM_OP_JR:
+        statistics.jumps++;
+        taken = true;
+        target = sim_value(instruction, 0);
+        break;
+      case SIM_OP_SYSCALL:
+        if(!sim_syscall(instruction->line_number)) {
+          statistics.native_instructions += 1;
+          statistics.cycles += 1;
+          return 0;
+        }
+        break;
+      case SIM_OP_NOP:
+        /* nothing to do */
+        break;
+      default:
+        fprintf(stderr, "simulator: line %d: unsupported instruction %s\n",
+                instruction->line_number, instruction->mnemonic);
+        return 1;
+    }
+
+    if(branch) {
+      statistics.branches++;
+      if(taken) {
+        statistics.branches_taken++;
+      }
+    }
+    if(taken) {
+      extra_cycles += 1;
+      if(target == EXIT_ADDRESS) {
+        statistics.native_instructions += cost;
+        statistics.cycles += cost + extra_cycles;
+        return 0;
+      }
+      next_pc = sim_instruction_index(target, instruction->line_number);
+    }
+    statistics.native_instructions += cost;
+    statistics.cycles += cost + extra_cycles;
+    pc = next_pc;
+  }
+}
+
+/* Lays out argc/argv on the stack the way SPIM does and points $a0/$a1 at them. */
+static void sim_setup_arguments(int argc, char **argv) {
+  unsigned int string_area = STACK_TOP - 4096;
+  unsigned int pointer_area;
+  int i;
+
+  pointer_area = string_area - 4 * (argc + 1);
+  pointer_area &= ~7u;
+  for(i = 0; i < argc; i++) {
+    size_t j, length = strlen(argv[i]);
+    sim_store(pointer_area + 4 * i, 4, string_area, 0);
+    for(j = 0; j <= length; j++) {
+      *sim_memory(string_area++, 1, 0) = (unsigned char)argv[i][j];
+    }
+  }
+  sim_store(pointer_area + 4 * argc, 4, 0, 0);
+  registers[4] = (unsigned int)argc;
+  registers[5] = pointer_area;
+  registers[29] = (pointer_area - 64) & ~7u;
+  registers[30] = registers[29];
+}
+
+static void sim_print_statistics(FILE *output) {
+  fprintf(output, "\n=============== SIMULATOR STATISTICS ===============\n");
+  fprintf(output, "instructions executed:      %12lu\n", statistics.instructions);
+  fprintf(output, "native instructions:        %12lu\n", statistics.native_instructions);
+  fprintf(output, "loads:                      %12lu\n", statistics.loads);
+  fprintf(output, "stores:                     %12lu\n", statistics.stores);
+  fprintf(output, "conditional branches:       %12lu\n", statistics.branches);
+  fprintf(output, "  taken:                    %12lu\n", statistics.branches_taken);
+  fprintf(output, "jumps:                      %12lu\n", statistics.jumps);
+  fprintf(output, "calls:                      %12lu\n", statistics.calls);
+  fprintf(output, "multiplies:                 %12lu\n", statistics.multiplies);
+  fprintf(output, "divides:                    %12lu\n", statistics.divides);
+  fprintf(output, "syscalls:                   %12lu\n", statistics.syscalls);
+  fprintf(output, "estimated cycles:           %12lu\n", statistics.cycles);
+}
+
+int main(int argc, char **argv) {
+  FILE *input;
+  FILE *statistics_output = stderr;
+  bool quiet = false;
+  unsigned long max_instructions = 0;
+  int opt;
+  int result;
+
+  while (-1 != (opt = getopt(argc, argv, "qs:l:"))) {
+    switch (opt) {
+      case 'q':
+        quiet = true;
+        break;
+      case 's':
+        statistics_output = fopen(optarg, "w");
+        if (NULL == statistics_output) {
+          fprintf(stderr, "Could not open statistics file %s: %s\n", optarg, strerror(errno));
+          return -1;
+        }
+        break;
+      case 'l':
+        max_instructions = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-q] [-s statistics_file] [-l max_instructions] program.s [arguments...]\n",
+                argv[0]);
+        return -1;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "Expected an assembly file.\n");
+    return -1;
+  }
+  input = fopen(argv[optind], "r");
+  if (NULL == input) {
+    fprintf(stderr, "Could not open %s: %s\n", argv[optind], strerror(errno));
+    return -1;
+  }
+
+  data = calloc(DATA_SIZE, 1);
+  stack = calloc(STACK_SIZE, 1);
+  assert(NULL != data && NULL != stack);
+
+  sim_load_program(input);
+  fclose(input);
+  sim_resolve_labels();
+  sim_decode_mnemonics();
+  if (simulator_num_errors > 0) {
+    fprintf(stderr, "Simulator encountered %d %s while loading.\n",
+            simulator_num_errors, (simulator_num_errors == 1 ? "error" : "errors"));
+    return 2;
+  }
+
+  sim_setup_arguments(argc - optind, &argv[optind]);
+  result = sim_run(max_instructions);
+  fflush(stdout);
+
+  if (!quiet) {
+    sim_print_statistics(statistics_output);
+  }
+  return result;
+}
@@ -0,0 +1,522 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "node.h"
+#include "ir.h"
+#include "basic_blocks.h"
+#include "dataflow.h"
+#include "ssa.h"
+#include "arena.h"
+
+/*
+ * Construction of static single assignment form (Cytron et al.).
+ *
+ * Dominators are computed with the iterative algorithm of Cooper, Harvey and
+ * Kennedy over the reverse postorder, and dominance frontiers by walking up
+ * the dominator tree from the predecessors of every join. Phis for a variable
+ * go on the iterated dominance frontier of the blocks that define it, but
+ * only where the variable is live on entry. Renaming walks the dominator tree
+ * keeping the current name of every variable, with a log of the names it
+ * replaced so that leaving a block restores them.
+ *
+ * Leaving SSA form maps every name back to its variable and drops the phis.
+ * That is exact as long as no two names of the same variable are live at the
+ * same time, which holds for the form as built and is kept by passes that
+ * only rewrite or delete definitions. A phi argument that was replaced by a
+ * name of another variable gets a copy at the end of its predecessor.
+ */
+
+struct block_list {
+  int number;
+  struct block_list *next;
+};
+
+static void block_list_add(struct block_list **list, int number) {
+  struct block_list *element;
+
+  element = arena_allocate(&optimizer_arena, sizeof(struct block_list));
+  element->number = number;
+  element->next = *list;
+  *list = element;
+}
+
+/*************
+ * DOMINATORS *
+ *************/
+
+static int ssa_intersect(int *immediate_dominators, int *rpo_numbers, int left, int right) {
+  while(left != right) {
+    while(rpo_numbers[left] > rpo_numbers[right]) {
+      left = immediate_dominators[left];
+    }
+    while(rpo_numbers[right] > rpo_numbers[left]) {
+      right = immediate_dominators[right];
+    }
+  }
+  return left;
+}
+
+/*
+ * While the dominators are being computed the entry is its own immediate
+ * dominator, which stops the walks in ssa_intersect; it is set to -1 after.
+ */
+static void ssa_compute_dominators(struct ssa_form *ssa, int *rpo_numbers) {
+  struct control_flow_graph *cfg = ssa->cfg;
+  struct basic_block *basic_block, *predecessor;
+  int *immediate_dominators;
+  int i, j, new_dominator;
+  bool changed;
+
+  immediate_dominators = arena_allocate(&optimizer_arena, sizeof(int) * cfg->num_blocks);
+  for(i = 0; i < cfg->num_blocks; i++) {
+    immediate_dominators[i] = -1;
+    rpo_numbers[i] = -1;
+  }
+  for(i = 0; i < cfg->num_reachable_blocks; i++) {
+    rpo_numbers[cfg->reverse_postorder[i]->number] = i;
+  }
+  immediate_dominators[cfg->entry->number] = cfg->entry->number;
+
+  do {
+    changed = false;
+    for(i = 1; i < cfg->num_reachable_blocks; i++) {
+      basic_block = cfg->reverse_postorder[i];
+      new_dominator = -1;
+      for(j = 0; j < basic_block->num_predecessors; j++) {
+        predecessor = basic_block->predecessors[j];
+        if(immediate_dominators[predecessor->number] == -1) {
+          continue;
+        }
+        if(new_dominator == -1) {
+          new_dominator = predecessor->number;
+        } else {
+          new_dominator = ssa_intersect(immediate_dominators, rpo_numbers,
+                                        predecessor->number, new_dominator);
+        }
+      }
+      if(immediate_dominators[basic_block->number] != new_dominator) {
+        immediate_dominators[basic_block->number] = new_dominator;
+        changed = true;
+      }
+    }
+  } while(changed);
+
+  ssa->immediate_dominators = immediate_dominators;
+}
+
+static struct block_list **ssa_compute_dominance_frontiers(struct ssa_form *ssa, int *rpo_numbers) {
+  struct control_flow_graph *cfg = ssa->cfg;
+  struct basic_block *basic_block;
+  struct block_list **frontiers;
+  int i, j, runner, number;
+
+  frontiers = arena_allocate(&optimizer_arena, sizeof(struct block_list *) * cfg->num_blocks);
+  for(i = 0; i < cfg->num_reachable_blocks; i++) {
+    basic_block = cfg->reverse_postorder[i];
+    number = basic_block->number;
+    if(basic_block->num_predecessors < 2) {
+      continue;
+    }
+    for(j = 0; j < basic_block->num_predecessors; j++) {
+      runner = basic_block->predecessors[j]->number;
+      if(rpo_numbers[runner] == -1) {
+        continue;
+      }
+      /* A block reached twice from the same join is already at the head */
+      while(runner != ssa->immediate_dominators[number] &&
+            (frontiers[runner] == NULL || frontiers[runner]->number != number)) {
+        block_list_add(&frontiers[runner], number);
+        runner = ssa->immediate_dominators[runner];
+      }
+    }
+  }
+  return frontiers;
+}
+
+/****************
+ * PHI PLACEMENT *
+ ****************/
+
+static void ssa_place_phis(struct ssa_form *ssa, struct block_list **frontiers,
+                           struct dataflow *liveness) {
+  struct control_flow_graph *cfg = ssa->cfg;
+  struct basic_block *basic_block;
+  struct ir_instruction *instruction;
+  struct block_list **definition_blocks, *element, *frontier;
+  struct ssa_phi *phi;
+  int *last_definition_block, *phi_stamps, *work_stamps, *worklist;
+  int i, variable, number, num_work;
+
+  definition_blocks = arena_allocate(&optimizer_arena,
+                                     sizeof(struct block_list *) * (ssa->num_variables + 1));
+  last_definition_block = arena_allocate(&optimizer_arena, sizeof(int) * (ssa->num_variables + 1));
+  for(variable = 0; variable < ssa->num_variables; variable++) {
+    last_definition_block[variable] = -1;
+  }
+  for(i = 0; i < cfg->num_reachable_blocks; i++) {
+    basic_block = cfg->reverse_postorder[i];
+    for(instruction = basic_block->beginning; ; instruction = instruction->next) {
+      if(ir_is_destination_operand(instruction, 0)) {
+        variable = instruction->operands[0].data.temporary;
+        if(last_definition_block[variable] != basic_block->number) {
+          last_definition_block[variable] = basic_block->number;
+          block_list_add(&definition_blocks[variable], basic_block->number);
+        }
+      }
+      if(instruction == basic_block->end) {
+        break;
+      }
+    }
+  }
+
+  phi_stamps = arena_allocate(&optimizer_arena, sizeof(int) * cfg->num_blocks);
+  work_stamps = arena_allocate(&optimizer_arena, sizeof(int) * cfg->num_blocks);
+  worklist = arena_allocate(&optimizer_arena, sizeof(int) * cfg->num_blocks);
+  for(i = 0; i < cfg->num_blocks; i++) {
+    phi_stamps[i] = -1;
+    work_stamps[i] = -1;
+  }
+
+  for(variable = 0; variable < ssa->num_variables; variable++) {
+    num_work = 0;
+    for(element = definition_blocks[variable]; element != NULL; element = element->next) {
+      work_stamps[element->number] = variable;
+      worklist[num_work++] = element->number;
+    }
+    while(num_work > 0) {
+      number = worklist[--num_work];
+      for(frontier = frontiers[number]; frontier != NULL; frontier = frontier->next) {
+        if(phi_stamps[frontier->number] == variable ||
+           !bit_vector_test(&liveness->in[frontier->number], variable)) {
+          continue;
+        }
+        phi_stamps[frontier->number] = variable;
+        basic_block = cfg->blocks[frontier->number];
+        phi = arena_allocate(&optimizer_arena, sizeof(struct ssa_phi));
+        phi->variable = variable;
+        phi->basic_block = basic_block;
+        phi->arguments = arena_allocate(&optimizer_arena,
+                                        sizeof(int) * (basic_block->num_predecessors + 1));
+        phi->next = ssa->phis[frontier->number];
+        ssa->phis[frontier->number] = phi;
+        /* The phi is a new definition of the variable */
+        if(work_stamps[frontier->number] != variable) {
+          work_stamps[frontier->number] = variable;
+          worklist[num_work++] = frontier->number;
+        }
+      }
+    }
+  }
+}
+
+/***********
+ * RENAMING *
+ ***********/
+
+int ssa_predecessor_index(struct basic_block *basic_block, struct basic_block *predecessor) {
+  int i;
+  for(i = 0; i < basic_block->num_predecessors; i++) {
+    if(basic_block->predecessors[i] == predecessor) {
+      return i;
+    }
+  }
+  assert(false);
+  return -1;
+}
+
+struct ssa_renaming {
+  int *current_names;
+  int *log_variables;
+  int *log_names;
+  int log_size;
+};
+
+static int ssa_new_name(struct ssa_form *ssa, struct ssa_renaming *renaming, int variable,
+                        struct basic_block *basic_block) {
+  int name = ssa->num_names++;
+
+  ssa->names[name].variable = variable;
+  ssa->names[name].basic_block = basic_block;
+  renaming->log_variables[renaming->log_size] = variable;
+  renaming->log_names[renaming->log_size] = renaming->current_names[variable];
+  renaming->log_size++;
+  renaming->current_names[variable] = name;
+  return name;
+}
+
+static void ssa_rename_successor_phis(struct ssa_form *ssa, struct ssa_renaming *renaming,
+                                      struct basic_block *basic_block,
+                                      struct basic_block *successor) {
+  struct ssa_phi *phi;
+  int index;
+
+  if(successor == NULL || ssa->phis[successor->number] == NULL) {
+    return;
+  }
+  index = ssa_predecessor_index(successor, basic_block);
+  for(phi = ssa->phis[successor->number]; phi != NULL; phi = phi->next) {
+    phi->arguments[index] = renaming->current_names[phi->variable];
+  }
+}
+
+static void ssa_rename_block(struct ssa_form *ssa, struct ssa_renaming *renaming,
+                             struct basic_block *basic_block) {
+  struct ir_instruction *instruction;
+  struct ssa_phi *phi;
+  int i, name;
+
+  for(phi = ssa->phis[basic_block->number]; phi != NULL; phi = phi->next) {
+    name = ssa_new_name(ssa, renaming, phi->variable, basic_block);
+    ssa->names[name].phi = phi;
+    phi->temporary = name;
+  }
+
+  for(instruction = basic_block->beginning; ; instruction = instruction->next) {
+    for(i = 0; i < 3; i++) {
+      if(instruction->operands[i].kind == OPERAND_TEMPORARY &&
+         !ir_is_destination_operand(instruction, i)) {
+        instruction->operands[i].data.temporary =
+          renaming->current_names[instruction->operands[i].data.temporary];
+      }
+    }
+    if(ir_is_destination_operand(instruction, 0)) {
+      name = ssa_new_name(ssa, renaming, instruction->operands[0].data.temporary, basic_block);
+      ssa->names[name].instruction = instruction;
+      instruction->operands[0].data.temporary = name;
+    }
+    if(instruction == basic_block->end) {
+      break;
+    }
+  }
+
+  ssa_rename_successor_phis(ssa, renaming, basic_block, basic_block->left);
+  ssa_rename_successor_phis(ssa, renaming, basic_block, basic_block->right);
+}
+
+/*
+ * Walks the dominator tree in preorder with an explicit stack, since the
+ * tree of a long function can be very deep.
+ */
+static void ssa_rename(struct ssa_form *ssa, int num_definitions) {
+  struct control_flow_graph *cfg = ssa->cfg;
+  struct ssa_renaming renaming;
+  int *first_children, *next_siblings, *stack, *log_heights;
+  int i, number, dominator, top;
+
+  first_children = arena_allocate(&optimizer_arena, sizeof(int) * cfg->num_blocks);
+  next_siblings = arena_allocate(&optimizer_arena, sizeof(int) * cfg->num_blocks);
+  for(i = 0; i < cfg->num_blocks; i++) {
+    first_children[i] = -1;
+    next_siblings[i] = -1;
+  }
+  /* Going backwards leaves the children in reverse postorder */
+  for(i = cfg->num_reachable_blocks - 1; i > 0; i--) {
+    number = cfg->reverse_postorder[i]->number;
+    dominator = ssa->immediate_dominators[number];
+    next_siblings[number] = first_children[dominator];
+    first_children[dominator] = number;
+  }
+
+  renaming.current_names = arena_allocate(&optimizer_arena, sizeof(int) * (ssa->num_variables + 1));
+  for(i = 0; i < ssa->num_variables; i++) {
+    renaming.current_names[i] = i;
+  }
+  renaming.log_variables = arena_allocate(&optimizer_arena, sizeof(int) * (num_definitions + 1));
+  renaming.log_names = arena_allocate(&optimizer_arena, sizeof(int) * (num_definitions + 1));
+  renaming.log_size = 0;
+
+  /* The stack holds the blocks whose subtrees are being renamed, and for
+   * each the size of the log when it was entered. */
+  stack = arena_allocate(&optimizer_arena, sizeof(int) * (cfg->num_blocks + 1));
+  log_heights = arena_allocate(&optimizer_arena, sizeof(int) * (cfg->num_blocks + 1));
+  top = 0;
+  stack[0] = cfg->entry->number;
+  log_heights[0] = 0;
+  ssa_rename_block(ssa, &renaming, cfg->entry);
+  while(top >= 0) {
+    number = first_children[stack[top]];
+    if(number != -1) {
+      /* Unlink the child so the next visit moves on to its sibling */
+      first_children[stack[top]] = next_siblings[number];
+      top++;
+      stack[top] = number;
+      log_heights[top] = renaming.log_size;
+      ssa_rename_block(ssa, &renaming, cfg->blocks[number]);
+      continue;
+    }
+    while(renaming.log_size > log_heights[top]) {
+      renaming.log_size--;
+      renaming.current_names[renaming.log_variables[renaming.log_size]] =
+        renaming.log_names[renaming.log_size];
+    }
+    top--;
+  }
+}
+
+/*****************
+ * DEF-USE CHAINS *
+ *****************/
+
+static void ssa_add_use(struct ssa_form *ssa, int name, struct ir_instruction *instruction,
+                        struct ssa_phi *phi, struct basic_block *basic_block) {
+  struct ssa_use *use;
+
+  use = arena_allocate(&optimizer_arena, sizeof(struct ssa_use));
+  use->instruction = instruction;
+  use->phi = phi;
+  use->basic_block = basic_block;
+  use->next = ssa->names[name].uses;
+  ssa->names[name].uses = use;
+}
+
+static void ssa_compute_uses(struct ssa_form *ssa) {
+  struct control_flow_graph *cfg = ssa->cfg;
+  struct basic_block *basic_block;
+  struct ir_instruction *instruction;
+  struct ssa_phi *phi;
+  int i, j;
+
+  for(i = 0; i < cfg->num_reachable_blocks; i++) {
+    basic_block = cfg->reverse_postorder[i];
+    for(phi = ssa->phis[basic_block->number]; phi != NULL; phi = phi->next) {
+      for(j = 0; j < basic_block->num_predecessors; j++) {
+        ssa_add_use(ssa, phi->arguments[j], NULL, phi, basic_block);
+      }
+    }
+    for(instruction = basic_block->beginning; ; instruction = instruction->next) {
+      for(j = 0; j < 3; j++) {
+        if(instruction->operands[j].kind == OPERAND_TEMPORARY &&
+           !ir_is_destination_operand(instruction, j)) {
+          ssa_add_use(ssa, instruction->operands[j].data.temporary, instruction, NULL,
+                      basic_block);
+        }
+      }
+      if(instruction == basic_block->end) {
+        break;
+      }
+    }
+  }
+}
+
+/*
+ * Puts the function of the control flow graph, whose temporaries are
+ * numbered below num_temporaries, into SSA form.
+ */
+struct ssa_form *ssa_build(struct control_flow_graph *cfg, int num_temporaries) {
+  struct ssa_form *ssa;
+  struct basic_block *basic_block;
+  struct ir_instruction *instruction;
+  struct block_list **frontiers;
+  struct dataflow *liveness;
+  struct ssa_phi *phi;
+  int *rpo_numbers;
+  int i, num_definitions;
+
+  ssa = arena_allocate(&optimizer_arena, sizeof(struct ssa_form));
+  ssa->cfg = cfg;
+  ssa->num_variables = num_temporaries;
+  ssa->phis = arena_allocate(&optimizer_arena, sizeof(struct ssa_phi *) * cfg->num_blocks);
+
+  rpo_numbers = arena_allocate(&optimizer_arena, sizeof(int) * cfg->num_blocks);
+  ssa_compute_dominators(ssa, rpo_numbers);
+  frontiers = ssa_compute_dominance_frontiers(ssa, rpo_numbers);
+  ssa->immediate_dominators[cfg->entry->number] = -1;
+
+  liveness = dataflow_compute_liveness(cfg, num_temporaries);
+  ssa_place_phis(ssa, frontiers, liveness);
+
+  num_definitions = 0;
+  for(i = 0; i < cfg->num_reachable_blocks; i++) {
+    basic_block = cfg->reverse_postorder[i];
+    for(phi = ssa->phis[basic_block->number]; phi != NULL; phi = phi->next) {
+      num_definitions++;
+    }
+    for(instruction = basic_block->beginning; ; instruction = instruction->next) {
+      if(ir_is_destination_operand(instruction, 0)) {
+        num_definitions++;
+      }
+      if(instruction == basic_block->end) {
+        break;
+      }
+    }
+  }
+
+  /* The names of the values on entry are the variables themselves */
+  ssa->names = arena_allocate(&optimizer_arena,
+                              sizeof(struct ssa_name) * (num_temporaries + num_definitions + 1));
+  for(i = 0; i < num_temporaries; i++) {
+    ssa->names[i].variable = i;
+  }
+  ssa->num_names = num_temporaries;
+
+  ssa_rename(ssa, num_definitions);
+  ssa_compute_uses(ssa);
+  return ssa;
+}
+
+/**************
+ * LEAVING SSA *
+ **************/
+
+static void ssa_insert_copy(struct basic_block *basic_block, int destination, int source) {
+  struct ir_instruction *copy, *end = basic_block->end;
+
+  copy = ir_instruction(IR_COPY);
+  copy->operands[0].kind = OPERAND_TEMPORARY;
+  copy->operands[0].data.temporary = destination;
+  copy->operands[1].kind = OPERAND_TEMPORARY;
+  copy->operands[1].data.temporary = source;
+  copy->operands[2].kind = OPERAND_NULL;
+
+  /* The copy has to happen before the branch that leaves the block */
+  if(end->kind == IR_GOTO || end->kind == IR_GOTO_IF_FALSE || end->kind == IR_GOTO_IF_TRUE) {
+    copy->prev = end->prev;
+    copy->next = end;
+    end->prev->next = copy;
+    end->prev = copy;
+  } else {
+    copy->prev = end;
+    copy->next = end->next;
+    end->next->prev = copy;
+    end->next = copy;
+    basic_block->end = copy;
+  }
+}
+
+/*
+ * Takes the function out of SSA form. The form, its names and its use chains
+ * are no longer valid afterwards.
+ */
+void ssa_destroy(struct ssa_form *ssa) {
+  struct control_flow_graph *cfg = ssa->cfg;
+  struct basic_block *basic_block, *predecessor;
+  struct ir_instruction *instruction;
+  struct ssa_phi *phi;
+  int i, j, variable;
+
+  for(i = 0; i < cfg->num_reachable_blocks; i++) {
+    basic_block = cfg->reverse_postorder[i];
+    for(phi = ssa->phis[basic_block->number]; phi != NULL; phi = phi->next) {
+      for(j = 0; j < basic_block->num_predecessors; j++) {
+        predecessor = basic_block->predecessors[j];
+        variable = ssa->names[phi->arguments[j]].variable;
+        if(variable != phi->variable &&
+           (predecessor == cfg->entry || ssa->immediate_dominators[predecessor->number] != -1)) {
+          ssa_insert_copy(predecessor, phi->variable, variable);
+        }
+      }
+    }
+  }
+
+  for(instruction = cfg->function_begin; instruction != cfg->function_end;
+      instruction = instruction->next) {
+    for(j = 0; j < 3; j++) {
+      if(instruction->operands[j].kind == OPERAND_TEMPORARY) {
+        instruction->operands[j].data.temporary =
+          ssa->names[instruction->operands[j].data.temporary].variable;
+      }
+    }
+  }
+}
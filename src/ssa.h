@@ -0,0 +1,78 @@
+#ifndef _SSA_H
+#define _SSA_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+struct ir_instruction;
+struct basic_block;
+struct control_flow_graph;
+
+/*
+ * Static single assignment form of one function, built over its control flow
+ * graph. The temporaries of the function are the variables; every definition
+ * of one in a reachable block is given a name of its own, numbered from
+ * num_variables up, and the IR is rewritten to use the names. Names below
+ * num_variables stand for the value a variable has on entry to the function,
+ * which is what a use that no definition reaches reads.
+ *
+ * Phi functions are kept beside the IR, in a list for each block. A phi has
+ * one argument for each predecessor of its block, in the order of the
+ * predecessors array. Phis are only placed where the variable is live, so
+ * the form is pruned.
+ */
+
+struct ssa_phi {
+  int temporary;
+  int variable;
+  int *arguments;
+  struct basic_block *basic_block;
+  struct ssa_phi *next;
+};
+
+/*
+ * A use of a name, either by an instruction or as an argument of a phi, and
+ * the block the instruction or phi is in.
+ */
+struct ssa_use {
+  struct ir_instruction *instruction;
+  struct ssa_phi *phi;
+  struct basic_block *basic_block;
+  struct ssa_use *next;
+};
+
+/*
+ * What is known about each name: the variable it renames, its definition,
+ * which is an instruction, a phi or neither for the value on entry, and the
+ * chain of its uses.
+ */
+struct ssa_name {
+  int variable;
+  struct ir_instruction *instruction;
+  struct ssa_phi *phi;
+  struct basic_block *basic_block;
+  struct ssa_use *uses;
+};
+
+/*
+ * immediate_dominators holds a block number for each block, -1 for the entry
+ * and for blocks that cannot be reached from it. Unreachable blocks are left
+ * alone and keep the variables as their names.
+ */
+struct ssa_form {
+  struct control_flow_graph *cfg;
+  int *immediate_dominators;
+  struct ssa_phi **phis;
+  int num_variables;
+  int num_names;
+  struct ssa_name *names;
+};
+
+/* The form lives in optimizer_arena until it is reset */
+struct ssa_form *ssa_build(struct control_flow_graph *cfg, int num_temporaries);
+
+int ssa_predecessor_index(struct basic_block *basic_block, struct basic_block *predecessor);
+
+void ssa_destroy(struct ssa_form *ssa);
+
+#endif /* _SSA_H */
@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "string_pool.h"
+#include "arena.h"
+
+/*
+ * The characters live in the string arena, which never moves them, so
+ * pooled text keeps its address. The strings themselves are found through
+ * an open addressing hash table of handles that is doubled when it gets
+ * half full.
+ */
+
+#define STRING_POOL_INITIAL_SLOTS 1024
+
+struct pooled_string {
+  char *text;
+  int length;
+  unsigned int hash;
+};
+
+static struct pooled_string *strings;
+static int num_strings;
+static int max_strings;
+
+static int *slots;
+static int num_slots;
+
+static unsigned int string_pool_hash(const char *text, int length) {
+  /* FNV-1a */
+  unsigned int hash = 2166136261u;
+  int i;
+  for(i = 0; i < length; i++) {
+    hash ^= (unsigned char)text[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static char *string_pool_store(const char *text, int length) {
+  char *stored;
+
+  /* The arena hands out zeroed memory, which terminates the copy */
+  stored = arena_allocate(&string_arena, length + 1);
+  memcpy(stored, text, length);
+  return stored;
+}
+
+static void string_pool_grow_slots(void) {
+  int i, slot;
+
+  free(slots);
+  num_slots = num_slots == 0 ? STRING_POOL_INITIAL_SLOTS : 2 * num_slots;
+  slots = malloc(sizeof(int) * num_slots);
+  assert(slots != NULL);
+  for(i = 0; i < num_slots; i++) {
+    slots[i] = STRING_POOL_NO_STRING;
+  }
+  for(i = 0; i < num_strings; i++) {
+    slot = strings[i].hash & (num_slots - 1);
+    while(slots[slot] != STRING_POOL_NO_STRING) {
+      slot = (slot + 1) & (num_slots - 1);
+    }
+    slots[slot] = i;
+  }
+}
+
+/*
+ * Returns the handle of the given characters, adding them to the pool the
+ * first time they are seen.
+ */
+int string_pool_intern(const char *text, int length) {
+  unsigned int hash;
+  int slot, handle;
+
+  assert(length >= 0);
+  if(2 * (num_strings + 1) > num_slots) {
+    string_pool_grow_slots();
+  }
+
+  hash = string_pool_hash(text, length);
+  slot = hash & (num_slots - 1);
+  while(slots[slot] != STRING_POOL_NO_STRING) {
+    handle = slots[slot];
+    if(strings[handle].hash == hash && strings[handle].length == length &&
+       0 == memcmp(strings[handle].text, text, length)) {
+      return handle;
+    }
+    slot = (slot + 1) & (num_slots - 1);
+  }
+
+  if(num_strings == max_strings) {
+    max_strings = max_strings == 0 ? STRING_POOL_INITIAL_SLOTS : 2 * max_strings;
+    strings = realloc(strings, sizeof(struct pooled_string) * max_strings);
+    assert(strings != NULL);
+  }
+  handle = num_strings++;
+  strings[handle].text = string_pool_store(text, length);
+  strings[handle].length = length;
+  strings[handle].hash = hash;
+  slots[slot] = handle;
+  return handle;
+}
+
+const char *string_pool_text(int handle) {
+  assert(handle >= 0 && handle < num_strings);
+  return strings[handle].text;
+}
+
+int string_pool_length(int handle) {
+  assert(handle >= 0 && handle < num_strings);
+  return strings[handle].length;
+}
+
+int string_pool_count(void) {
+  return num_strings;
+}
+
+/*
+ * Forgets every pooled string; handles and text handed out before are no
+ * longer valid.
+ */
+void string_pool_release(void) {
+  free(strings);
+  free(slots);
+  strings = NULL;
+  slots = NULL;
+  num_strings = max_strings = num_slots = 0;
+  arena_reset(&string_arena);
+}
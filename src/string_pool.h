@@ -0,0 +1,26 @@
+#ifndef _STRING_POOL_H
+#define _STRING_POOL_H
+
+#include <stdio.h>
+
+/*
+ * A program-wide pool of interned strings. Interning the same characters
+ * twice returns the same handle, and handles are small consecutive integers
+ * starting at 0. The text of a handle never moves, so the pointer returned by
+ * string_pool_text stays valid for the rest of the compilation. Strings may
+ * contain NUL characters; every pooled string is also NUL-terminated.
+ */
+
+#define STRING_POOL_NO_STRING  -1
+
+int string_pool_intern(const char *text, int length);
+
+const char *string_pool_text(int handle);
+
+int string_pool_length(int handle);
+
+int string_pool_count(void);
+
+void string_pool_release(void);
+
+#endif /* _STRING_POOL_H */
@@ -6,50 +6,119 @@
 #include "node.h"
 #include "symbol.h"
 #include "type.h"
+#include "string_pool.h"
+#include "arena.h"
 
 int symbol_table_num_errors;
+unsigned long symbol_num_created;
 
 /* Labels - adding proper symbols for labels
  * Function def specifier - we assume that it has to be
  * a function declarator - it can be pointer decl too
  */
 
+#define SYMBOL_INDEX_INITIAL_SLOTS 8
+
+static void symbol_index_initialize(struct symbol_index *index) {
+  index->num_slots = 0;
+  index->num_symbols = 0;
+  index->slots = NULL;
+}
+
 void symbol_initialize_table(struct symbol_table *table,
     int type_of_symbol_table) {
   table->variables = NULL;
+  symbol_index_initialize(&table->variables_index);
   table->type_of_symbol_table = type_of_symbol_table;
   table->statement_labels = NULL;
+  symbol_index_initialize(&table->statement_labels_index);
   table->parent_symbol_table = NULL;
   table->total_stack_offset = 0;
 }
 
+/****************
+ * SYMBOL INDEX *
+ ****************/
+
+static int symbol_index_first_slot(struct symbol_index *index, int name) {
+  /* Handles are consecutive, so spread them with a multiplicative hash */
+  return (int)(((unsigned int)name * 2654435761u) & (unsigned int)(index->num_slots - 1));
+}
+
+static struct symbol *symbol_index_find(struct symbol_index *index, int name) {
+  int slot;
+
+  if(index->num_slots == 0) {
+    return NULL;
+  }
+  for(slot = symbol_index_first_slot(index, name); index->slots[slot].symbol != NULL;
+      slot = (slot + 1) & (index->num_slots - 1)) {
+    if(index->slots[slot].name == name) {
+      return index->slots[slot].symbol;
+    }
+  }
+  return NULL;
+}
+
+static void symbol_index_insert_slot(struct symbol_index *index, int name, struct symbol *symbol) {
+  int slot = symbol_index_first_slot(index, name);
+  while(index->slots[slot].symbol != NULL) {
+    slot = (slot + 1) & (index->num_slots - 1);
+  }
+  index->slots[slot].name = name;
+  index->slots[slot].symbol = symbol;
+}
+
+/*
+ * The slots are doubled when they get half full. Old slots stay behind in
+ * the symbol arena, which at most doubles what the index uses.
+ */
+static void symbol_index_insert(struct symbol_index *index, int name, struct symbol *symbol) {
+  struct symbol_index_slot *old_slots = index->slots;
+  int old_num_slots = index->num_slots;
+  int i;
+
+  assert(symbol_index_find(index, name) == NULL);
+  if(2 * (index->num_symbols + 1) > index->num_slots) {
+    index->num_slots = old_num_slots == 0 ? SYMBOL_INDEX_INITIAL_SLOTS : 2 * old_num_slots;
+    index->slots = arena_allocate(&symbol_arena, sizeof(struct symbol_index_slot) * index->num_slots);
+    for(i = 0; i < old_num_slots; i++) {
+      if(old_slots[i].symbol != NULL) {
+        symbol_index_insert_slot(index, old_slots[i].name, old_slots[i].symbol);
+      }
+    }
+  }
+  symbol_index_insert_slot(index, name, symbol);
+  index->num_symbols++;
+}
+
 /**********************************************
  * WALK PARSE TREE AND ADD SYMBOLS INTO TABLE *
  **********************************************/
 /*
- * This function is used to retrieve a symbol from a table.
+ * This function is used to retrieve a symbol from a table. The name is an
+ * interned identifier handle; each enclosing scope costs one hash probe.
  */
-struct symbol *symbol_get(struct symbol_table *table, char name[]) {
+struct symbol *symbol_get(struct symbol_table *table, int name) {
   struct symbol_table *present_symbol_table = table;
-  struct symbol_list *iter;
+  struct symbol *symbol;
   while(present_symbol_table != NULL) {
-      for (iter = present_symbol_table->variables; NULL != iter; iter = iter->next) {
-          if (!strcmp(name, iter->symbol.name)) {
-              return &iter->symbol;
-          }
+      symbol = symbol_index_find(&present_symbol_table->variables_index, name);
+      if (NULL != symbol) {
+          return symbol;
       }
       present_symbol_table = present_symbol_table->parent_symbol_table;
   }
   return NULL;
 }
 
-struct symbol *symbol_put(struct symbol_table **table, char name[],
+struct symbol *symbol_put(struct symbol_table **table, int name,
                           struct type *type) {
   struct symbol_list *symbol_list;
-  symbol_list = malloc(sizeof(struct symbol_list));
+  symbol_list = arena_allocate(&symbol_arena, sizeof(struct symbol_list));
   assert(NULL != symbol_list);
-  /* printf("Adding symbol of name: %s\n", name); */
-  strncpy(symbol_list->symbol.name, name, MAX_IDENTIFIER_LENGTH);
+  symbol_num_created++;
+  strncpy(symbol_list->symbol.name, string_pool_text(name), MAX_IDENTIFIER_LENGTH);
   symbol_list->symbol.result.type = type;
   symbol_list->symbol.result.ir_operand = NULL;
 
@@ -58,33 +127,30 @@ struct symbol *symbol_put(struct symbol_table **table, char name[],
 
   symbol_list->next = (*table)->variables;
   (*table)->variables = symbol_list;
+  symbol_index_insert(&(*table)->variables_index, name, &symbol_list->symbol);
 
   return &symbol_list->symbol;
 }
 
-struct symbol *symbol_get_labels(struct symbol_table *table, char name[]) {
-  struct symbol_list *iter;
-  for (iter = table->statement_labels; NULL != iter; iter = iter->next) {
-    if (!strcmp(name, iter->symbol.name)) {
-      return &iter->symbol;
-    }
-  }
-  return NULL;
+struct symbol *symbol_get_labels(struct symbol_table *table, int name) {
+  return symbol_index_find(&table->statement_labels_index, name);
 }
 
-struct symbol *symbol_put_labels(struct symbol_table *table, char name[],
+struct symbol *symbol_put_labels(struct symbol_table *table, int name,
                           struct type *type) {
   struct symbol_list *symbol_list;
 
-  symbol_list = malloc(sizeof(struct symbol_list));
+  symbol_list = arena_allocate(&symbol_arena, sizeof(struct symbol_list));
   assert(NULL != symbol_list);
+  symbol_num_created++;
 
-  strncpy(symbol_list->symbol.name, name, MAX_IDENTIFIER_LENGTH);
+  strncpy(symbol_list->symbol.name, string_pool_text(name), MAX_IDENTIFIER_LENGTH);
   symbol_list->symbol.result.type = type;
   symbol_list->symbol.result.ir_operand = NULL;
   symbol_list->symbol.stack_offset = STACK_OFFSET_NOT_YET_DEFINED;
   symbol_list->next = table->statement_labels;
   table->statement_labels = symbol_list;
+  symbol_index_insert(&table->statement_labels_index, name, &symbol_list->symbol);
 
   return &symbol_list->symbol;
 }
@@ -92,8 +158,9 @@ struct symbol *symbol_put_labels(struct symbol_table *table, char name[],
 void symbol_add_to_function_parameter_list(struct type *function_type,
                                            struct type *param_type,
 					   struct symbol_table *table) {
-    struct symbol_list *symbol_list = malloc(sizeof(struct symbol_list));
+    struct symbol_list *symbol_list = arena_allocate(&symbol_arena, sizeof(struct symbol_list));
     assert(NULL != symbol_list);
+    symbol_num_created++;
     symbol_list->symbol.result.type = param_type;
     symbol_list->symbol.result.ir_operand = NULL;
     symbol_list->next = function_type->data.function.parameter_list;
@@ -110,15 +177,13 @@ void symbol_add_from_identifier(struct symbol_table **table, struct node *identi
                                 struct type **type) {
   struct symbol *symbol;
   assert(NODE_IDENTIFIER == identifier->kind);
-  /* printf("Identifier name: %s\n", identifier->data.identifier.name); */
   symbol = symbol_get(*table, identifier->data.identifier.name);
   if (NULL == symbol) {
       if(type == NULL) {
           symbol_table_num_errors++;
-          printf("ERROR: Type of identifier %s not defined\n", identifier->data.identifier.name);
+          printf("ERROR: Type of identifier %s not defined\n", string_pool_text(identifier->data.identifier.name));
       } else {
           symbol = symbol_put(table, identifier->data.identifier.name, *type);
-          /* printf("Just added to symbol table : %p\n", (void *)(*table)); */
       }
   }
   identifier->data.identifier.symbol = symbol;
@@ -171,12 +236,16 @@ void symbol_add_from_statement(struct symbol_table *table, struct node *statemen
 }
 
 void symbol_add_from_statement_list(struct symbol_table *table, struct node *statement_list) {
+  struct node **elements;
+  int num_elements, i;
+
   assert(NODE_STATEMENT_LIST == statement_list->kind);
 
-  if (NULL != statement_list->data.statement_list.init) {
-      symbol_add_from_expression(table, statement_list->data.statement_list.init, NULL);
+  elements = node_list_elements(statement_list, &num_elements);
+  for (i = 0; i < num_elements; i++) {
+      symbol_add_from_expression(table, elements[i], NULL);
   }
-  symbol_add_from_expression(table, statement_list->data.statement_list.statement, NULL);
+  free(elements);
 }
 
 void symbol_add_from_expr(struct symbol_table *table, struct node *expr) {
@@ -233,13 +302,15 @@ void symbol_add_from_function_call(struct symbol_table *table, struct node *func
 }
 
 void symbol_add_from_expression_list(struct symbol_table *table, struct node *expression_list) {
+    struct node **elements;
+    int num_elements, i;
+
     assert(NODE_EXPRESSION_LIST == expression_list->kind);
-    if(expression_list->data.expression_list.expression_list != NULL) {
-      symbol_add_from_expression(table, expression_list->data.expression_list.expression_list, NULL);
-    }
-    if(expression_list->data.expression_list.assignment_expr != NULL) {
-      symbol_add_from_expression(table, expression_list->data.expression_list.assignment_expr, NULL);
+    elements = node_list_elements(expression_list, &num_elements);
+    for(i = 0; i < num_elements; i++) {
+      symbol_add_from_expression(table, elements[i], NULL);
     }
+    free(elements);
 }
 
 void symbol_add_from_for_expr(struct symbol_table *table, struct node *for_expr) {
@@ -458,7 +529,8 @@ void symbol_add_from_function_declarator(struct symbol_table *table, struct node
                                          struct type **return_type) {
     struct type *function_type = type_function(*return_type);
     assert(NODE_FUNCTION_DECLARATOR == function_declarator->kind);
-    function_type->data.function.function_symbol_table =  malloc(sizeof(struct symbol_table));
+    function_type->data.function.function_symbol_table =
+      arena_allocate(&symbol_arena, sizeof(struct symbol_table));
 
     /* Append the parameter_list into the function-type symbol as well */
     symbol_add_from_parameter_list(table,
@@ -615,7 +687,8 @@ void symbol_add_from_compound_statement(struct symbol_table *table, struct node
 				 compound_statement->data.compound_statement.declaration_or_statement_list,
 				 NULL);
     } else {
-      struct symbol_table *block_scope_symbol_table = malloc(sizeof(struct symbol_table));
+      struct symbol_table *block_scope_symbol_table =
+        arena_allocate(&symbol_arena, sizeof(struct symbol_table));
       symbol_initialize_table(block_scope_symbol_table, BLOCK_SCOPE_SYMBOL_TABLE);
       block_scope_symbol_table->parent_symbol_table = table;
       symbol_add_from_expression(block_scope_symbol_table,
@@ -637,7 +710,8 @@ void symbol_add_from_compound_statement(struct symbol_table *table, struct node
 void symbol_add_from_function_definition(struct symbol_table *table, struct node *function_definition) {
     struct type *function_type = type_function(NULL);
     assert(NODE_FUNCTION_DEFINITION == function_definition->kind);
-    function_type->data.function.function_symbol_table =  malloc(sizeof(struct symbol_table));
+    function_type->data.function.function_symbol_table =
+      arena_allocate(&symbol_arena, sizeof(struct symbol_table));
     symbol_initialize_table(function_type->data.function.function_symbol_table, FUNCTION_SCOPE_SYMBOL_TABLE);
     /* Link the symbol table of the function to the symbol table of the parent */
     function_type->data.function.function_symbol_table->parent_symbol_table = table;
@@ -762,13 +836,15 @@ void symbol_add_from_expression(struct symbol_table *table, struct node *express
 }
 
 void symbol_add_from_translation_unit(struct symbol_table *table, struct node *translation_unit) {
+  struct node **elements;
+  int num_elements, i;
+
   assert(NODE_TRANSLATION_UNIT == translation_unit->kind);
-  if(NULL != translation_unit->data.translation_unit.translation_unit) {
-    symbol_add_from_translation_unit(table, translation_unit->data.translation_unit.translation_unit);
-  }
-  if(NULL != translation_unit->data.translation_unit.top_level_decl) {
-      symbol_add_from_expression(table, translation_unit->data.translation_unit.top_level_decl, NULL);
+  elements = node_list_elements(translation_unit, &num_elements);
+  for (i = 0; i < num_elements; i++) {
+      symbol_add_from_expression(table, elements[i], NULL);
   }
+  free(elements);
 }
 
 /***********************
@@ -25,10 +25,27 @@ struct symbol_list {
   struct symbol_list *next;
 };
 
+/*
+ * Open addressing hash from interned identifier handles to the symbols of
+ * one scope. An index with no slots is empty, so a zeroed table is usable.
+ */
+struct symbol_index_slot {
+  int name;
+  struct symbol *symbol;
+};
+
+struct symbol_index {
+  int num_slots;
+  int num_symbols;
+  struct symbol_index_slot *slots;
+};
+
 struct symbol_table {
   struct symbol_list *variables;
+  struct symbol_index variables_index;
   int type_of_symbol_table;
   struct symbol_list *statement_labels;
+  struct symbol_index statement_labels_index;
   struct symbol_table *parent_symbol_table;
   int total_stack_offset;
 };
@@ -45,4 +62,7 @@ struct type *get_type_from_type_specifier(struct node *type_specifier);
 extern FILE *error_output;
 extern int symbol_table_num_errors;
 
+/* Number of symbols created over the whole compilation, parameters included */
+extern unsigned long symbol_num_created;
+
 #endif /* _SYMBOL_H */
@@ -1,10 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "node.h"
 #include "symbol.h"
 #include "type.h"
+#include "arena.h"
 
 /**************************
  * PRINT TYPE EXPRESSIONS *
@@ -46,51 +48,179 @@ void type_print(FILE *output, struct type *kind) {
  * CREATE TYPE EXPRESSIONS *
  ***************************/
 
-struct type *type_basic(bool is_unsigned, int width, int conversion_rank) {
-  struct type *basic;
+/*
+ * Every type except a function type is interned: asking for the same type
+ * twice returns the same object, so the number of types allocated is the
+ * number of distinct types in the program rather than the number of
+ * expressions. Interned types must never be modified. Function types carry
+ * their parameters and symbol table and are filled in after creation, so
+ * each declaration gets its own.
+ *
+ * The interned types are found through an open addressing hash table that
+ * is doubled when it gets half full; the types themselves live in the
+ * symbol arena.
+ */
+
+#define TYPE_INTERN_INITIAL_SLOTS 64
+
+static struct type **interned_types;
+static int num_interned_types;
+static int num_interned_slots;
+
+static struct type *void_type;
+static struct type *label_type;
 
-  basic = malloc(sizeof(struct type));
-  assert(NULL != basic);
+unsigned long type_num_created;
 
-  basic->kind = TYPE_BASIC;
-  basic->data.basic.is_unsigned = is_unsigned;
-  basic->data.basic.width = width;
-  basic->data.basic.conversion_rank = conversion_rank;
-  return basic;
+static unsigned int type_hash(int kind, unsigned long first, unsigned long second) {
+  unsigned int hash = 2166136261u;
+  hash = (hash ^ (unsigned int)kind) * 16777619u;
+  hash = (hash ^ (unsigned int)first) * 16777619u;
+  hash = (hash ^ (unsigned int)(first >> 16 >> 16)) * 16777619u;
+  hash = (hash ^ (unsigned int)second) * 16777619u;
+  return hash;
 }
 
-struct type *type_void() {
-  struct type *void_type;
-  void_type = malloc(sizeof(struct type));
-  assert(NULL != void_type);
+static unsigned int type_hash_of(struct type *type) {
+  switch(type->kind) {
+    case TYPE_BASIC:
+      return type_hash(TYPE_BASIC, type->data.basic.width * 2 + type->data.basic.is_unsigned,
+                       type->data.basic.conversion_rank);
+    case TYPE_POINTER:
+      return type_hash(TYPE_POINTER, (unsigned long)type->data.pointer.pointee, 0);
+    case TYPE_ARRAY:
+      return type_hash(TYPE_ARRAY, (unsigned long)type->data.array.array_type,
+                       type->data.array.array_size);
+    default:
+      assert(0);
+      return 0;
+  }
+}
+
+static bool type_is_same_key(struct type *type, struct type *key) {
+  if(type->kind != key->kind) {
+    return false;
+  }
+  switch(type->kind) {
+    case TYPE_BASIC:
+      return type->data.basic.is_unsigned == key->data.basic.is_unsigned &&
+        type->data.basic.width == key->data.basic.width &&
+        type->data.basic.conversion_rank == key->data.basic.conversion_rank;
+    case TYPE_POINTER:
+      return type->data.pointer.pointee == key->data.pointer.pointee;
+    case TYPE_ARRAY:
+      return type->data.array.array_type == key->data.array.array_type &&
+        type->data.array.array_size == key->data.array.array_size;
+    default:
+      assert(0);
+      return false;
+  }
+}
+
+static void type_grow_interned_slots(void) {
+  struct type **old_types = interned_types;
+  int old_num_slots = num_interned_slots;
+  int i, slot;
+
+  num_interned_slots = old_num_slots == 0 ? TYPE_INTERN_INITIAL_SLOTS : 2 * old_num_slots;
+  interned_types = calloc(num_interned_slots, sizeof(struct type *));
+  assert(NULL != interned_types);
+  for(i = 0; i < old_num_slots; i++) {
+    if(old_types[i] != NULL) {
+      slot = type_hash_of(old_types[i]) & (num_interned_slots - 1);
+      while(interned_types[slot] != NULL) {
+        slot = (slot + 1) & (num_interned_slots - 1);
+      }
+      interned_types[slot] = old_types[i];
+    }
+  }
+  free(old_types);
+}
+
+/*
+ * Returns the interned type equal to key, copying key into the symbol arena
+ * the first time it is seen.
+ */
+static struct type *type_intern(struct type *key) {
+  unsigned int hash;
+  int slot;
+
+  if(2 * (num_interned_types + 1) > num_interned_slots) {
+    type_grow_interned_slots();
+  }
+
+  hash = type_hash_of(key);
+  for(slot = hash & (num_interned_slots - 1); interned_types[slot] != NULL;
+      slot = (slot + 1) & (num_interned_slots - 1)) {
+    if(type_is_same_key(interned_types[slot], key)) {
+      return interned_types[slot];
+    }
+  }
 
-  void_type->kind = TYPE_VOID;
+  interned_types[slot] = arena_allocate(&symbol_arena, sizeof(struct type));
+  assert(NULL != interned_types[slot]);
+  type_num_created++;
+  *interned_types[slot] = *key;
+  num_interned_types++;
+  return interned_types[slot];
+}
+
+/*
+ * Forgets the interned types; needs to be called when the symbol arena is
+ * reset.
+ */
+void type_release(void) {
+  free(interned_types);
+  interned_types = NULL;
+  num_interned_types = num_interned_slots = 0;
+  void_type = label_type = NULL;
+}
+
+struct type *type_basic(bool is_unsigned, int width, int conversion_rank) {
+  struct type basic;
+
+  memset(&basic, 0, sizeof(struct type));
+  basic.kind = TYPE_BASIC;
+  basic.data.basic.is_unsigned = is_unsigned;
+  basic.data.basic.width = width;
+  basic.data.basic.conversion_rank = conversion_rank;
+  return type_intern(&basic);
+}
+
+struct type *type_void() {
+  if(NULL == void_type) {
+    void_type = arena_allocate(&symbol_arena, sizeof(struct type));
+    assert(NULL != void_type);
+    type_num_created++;
+    void_type->kind = TYPE_VOID;
+  }
   return void_type;
 }
 
 struct type *type_label() {
-  struct type *label_type;
-  label_type = malloc(sizeof(struct type));
-  assert(NULL != label_type);
-
-  label_type->kind = TYPE_LABEL;
+  if(NULL == label_type) {
+    label_type = arena_allocate(&symbol_arena, sizeof(struct type));
+    assert(NULL != label_type);
+    type_num_created++;
+    label_type->kind = TYPE_LABEL;
+  }
   return label_type;
 }
 
 struct type *type_pointer(struct type *pointee) {
-  struct type *pointer_type;
-  pointer_type = malloc(sizeof(struct type));
-  assert(NULL != pointer_type);
+  struct type pointer_type;
 
-  pointer_type->kind = TYPE_POINTER;
-  pointer_type->data.pointer.pointee = pointee;
-  return pointer_type;
+  memset(&pointer_type, 0, sizeof(struct type));
+  pointer_type.kind = TYPE_POINTER;
+  pointer_type.data.pointer.pointee = pointee;
+  return type_intern(&pointer_type);
 }
 
 struct type *type_function(struct type *type) {
     struct type *function_type;
-    function_type = malloc(sizeof(struct type));
+    function_type = arena_allocate(&symbol_arena, sizeof(struct type));
     assert(NULL != function_type);
+    type_num_created++;
 
     function_type->kind = TYPE_FUNCTION;
     function_type->data.function.return_type = type;
@@ -104,14 +234,13 @@ struct type *type_function(struct type *type) {
 
 struct type *type_array(struct type *type,
                         unsigned long array_size) {
-    struct type *array_type;
-    array_type = malloc(sizeof(struct type));
-    assert(NULL != array_type);
+    struct type array_type;
 
-    array_type->kind = TYPE_ARRAY;
-    array_type->data.array.array_type = type;
-    array_type->data.array.array_size = array_size;
-    return array_type;
+    memset(&array_type, 0, sizeof(struct type));
+    array_type.kind = TYPE_ARRAY;
+    array_type.data.array.array_type = type;
+    array_type.data.array.array_size = array_size;
+    return type_intern(&array_type);
 }
 
 /****************************************
@@ -119,21 +248,19 @@ struct type *type_array(struct type *type,
  ****************************************/
 
 int type_is_equal(struct type *left, struct type *right) {
-  int equal;
-  equal = left->kind == right->kind;
-  if (equal) {
-    switch (left->kind) {
-      case TYPE_BASIC:
-        equal = equal && left->data.basic.is_unsigned == right->data.basic.is_unsigned;
-        equal = equal && left->data.basic.width == right->data.basic.width;
-        break;
-      default:
-        equal = 0;
-        break;
-    }
+  /* Types are interned, so equal pointer and array types are one object */
+  if (left == right) {
+    return 1;
   }
-
-  return equal;
+  if (TYPE_BASIC != left->kind || TYPE_BASIC != right->kind) {
+    return 0;
+  }
+  /*
+   * Interned types are only distinct here when their conversion ranks
+   * differ, as for int and long, which share a width.
+   */
+  return left->data.basic.is_unsigned == right->data.basic.is_unsigned &&
+    left->data.basic.width == right->data.basic.width;
 }
 
 int type_is_arithmetic(struct type *t) {
@@ -692,31 +819,37 @@ void type_assign_in_expr(struct node *expr) {
     }
 }
 
+/*
+ * The outermost expression list node holds the last argument and the
+ * parameter list starts with the last parameter, so both are walked from
+ * the end together.
+ */
 void type_assign_in_expression_list(struct node *expression_list,
 				    int * number_of_parameters,
                                     struct symbol_list *parameter_list) {
-  (*number_of_parameters)++;
-  if(expression_list->data.expression_list.assignment_expr != NULL) {
-      type_assign_in_expression(expression_list->data.expression_list.assignment_expr);
-      /* printf("Type of prototype argument: %d\n", parameter_list->symbol.result.type->kind); */
-      /* printf("Type of function call argument: %d\n", node_get_result(expression_list->data.expression_list.assignment_expr)->type->kind); */
-      if(!types_are_compatible(parameter_list->symbol.result.type,
-                               node_get_result(expression_list->data.expression_list.assignment_expr)->type)) {
-          type_checking_num_errors++;
-          printf("ERROR: The type of arguments passed in to the function do not match the prototype\n");
-      } else if(((parameter_list->next != NULL) &&
-                 (expression_list->data.expression_list.expression_list == NULL)) ||
-                ((parameter_list->next == NULL) &&
-                 (expression_list->data.expression_list.expression_list != NULL))) {
-          type_checking_num_errors++;
-          printf("ERROR: Number of parameters in function call not same as declaration or definition\n");
-      } else {
-          parameter_list = parameter_list->next;
-          if(expression_list->data.expression_list.expression_list != NULL) {
-              type_assign_in_expression_list(expression_list->data.expression_list.expression_list,
-                                             number_of_parameters, parameter_list);
-          }
-      }
+  while(expression_list != NULL) {
+    (*number_of_parameters)++;
+    if(expression_list->data.expression_list.assignment_expr == NULL) {
+      break;
+    }
+    type_assign_in_expression(expression_list->data.expression_list.assignment_expr);
+    /* printf("Type of prototype argument: %d\n", parameter_list->symbol.result.type->kind); */
+    /* printf("Type of function call argument: %d\n", node_get_result(expression_list->data.expression_list.assignment_expr)->type->kind); */
+    if(!types_are_compatible(parameter_list->symbol.result.type,
+                             node_get_result(expression_list->data.expression_list.assignment_expr)->type)) {
+        type_checking_num_errors++;
+        printf("ERROR: The type of arguments passed in to the function do not match the prototype\n");
+        break;
+    } else if(((parameter_list->next != NULL) &&
+               (expression_list->data.expression_list.expression_list == NULL)) ||
+              ((parameter_list->next == NULL) &&
+               (expression_list->data.expression_list.expression_list != NULL))) {
+        type_checking_num_errors++;
+        printf("ERROR: Number of parameters in function call not same as declaration or definition\n");
+        break;
+    }
+    parameter_list = parameter_list->next;
+    expression_list = expression_list->data.expression_list.expression_list;
   }
 }
 
@@ -773,11 +906,15 @@ void type_assign_in_statement(struct node *statement) {
 }
 
 void type_assign_in_statement_list(struct node *statement_list) {
+  struct node **elements;
+  int num_elements, i;
+
   assert(NODE_STATEMENT_LIST == statement_list->kind);
-  if (NULL != statement_list->data.statement_list.init) {
-    type_assign_in_expression(statement_list->data.statement_list.init);
+  elements = node_list_elements(statement_list, &num_elements);
+  for (i = 0; i < num_elements; i++) {
+    type_assign_in_expression(elements[i]);
   }
-  type_assign_in_expression(statement_list->data.statement_list.statement);
+  free(elements);
 }
 
 void type_assign_in_function_def_specifier(struct node *function_def_specifier) {
@@ -918,11 +1055,13 @@ void type_assign_in_expression(struct node *expression) {
 }
 
 void type_assign_in_translation_unit(struct node *translation_unit) {
+  struct node **elements;
+  int num_elements, i;
+
   assert(NODE_TRANSLATION_UNIT == translation_unit->kind);
-  if (NULL != translation_unit->data.translation_unit.translation_unit) {
-    type_assign_in_translation_unit(translation_unit->data.translation_unit.translation_unit);
-  }
-  if(NULL != translation_unit->data.translation_unit.top_level_decl) {
-      type_assign_in_expression(translation_unit->data.translation_unit.top_level_decl);
+  elements = node_list_elements(translation_unit, &num_elements);
+  for (i = 0; i < num_elements; i++) {
+      type_assign_in_expression(elements[i]);
   }
+  free(elements);
 }
@@ -55,10 +55,11 @@ struct type *type_label();
 struct type *type_pointer(struct type *pointee);
 struct type *type_function(struct type *return_type);
 struct type *type_array(struct type *array_type, unsigned long array_size);
+void type_release(void);
 
 int type_size(struct type *t);
 
-int type_equal(struct type *left, struct type *right);
+int type_is_equal(struct type *left, struct type *right);
 
 int type_is_arithmetic(struct type *t);
 int type_is_unsigned(struct type *t);
@@ -72,4 +73,7 @@ void type_print(FILE *output, struct type *type);
 extern FILE *error_output;
 extern int type_checking_num_errors;
 
+/* Number of distinct type objects created over the whole compilation */
+extern unsigned long type_num_created;
+
 #endif /* _TYPE_H */
@@ -0,0 +1,54 @@
+/* Stores that are overwritten and values that are never used are removed;
+   calls are kept. */
+
+void print_int(int i);
+void print_string(char *s);
+
+int overwritten(int n) {
+  int x;
+  int y;
+  x = n * 5 + 3;
+  y = x - n;
+  x = n + 1;
+  y = x * 2;
+  return y + 0;
+}
+
+int unused_chain(int n) {
+  int a;
+  int b;
+  int c;
+  int i;
+  a = n;
+  b = 0;
+  c = 0;
+  i = 0;
+  while (i < n) {
+    a = a * 3 + i;
+    b = b + a;
+    c = c + i;
+    i = i + 1;
+  }
+  return c + 0;
+}
+
+int kept_call(int n) {
+  int ignored;
+  ignored = unused_chain(n);
+  print_string("called ");
+  return n + 0;
+}
+
+int main(void) {
+  int r;
+  r = overwritten(20);
+  print_int(r);
+  print_string("\n");
+  r = unused_chain(6);
+  print_int(r);
+  print_string("\n");
+  r = kept_call(4);
+  print_int(r);
+  print_string("\n");
+  return 0;
+}
@@ -0,0 +1,66 @@
+/* Division and remainder by 3, 7 and 0xffffffff, which become multiplications
+   by magic numbers. Division is unsigned. */
+
+void print_int(int i);
+void print_string(char *s);
+
+int by_three(int n) {
+  int q;
+  q = n / 3;
+  return q + 0;
+}
+
+int by_seven(int n) {
+  int q;
+  q = n / 7;
+  return q + 0;
+}
+
+int by_all_ones(int n) {
+  int q;
+  q = n / 4294967295;
+  return q + 0;
+}
+
+int mod_seven(int n) {
+  int r;
+  r = n % 7;
+  return r + 0;
+}
+
+int main(void) {
+  int n;
+  int q;
+  n = 0;
+  while (n < 25) {
+    q = by_three(n);
+    print_int(q);
+    print_string(" ");
+    q = by_seven(n);
+    print_int(q);
+    print_string(" ");
+    q = mod_seven(n);
+    print_int(q);
+    print_string("\n");
+    n = n + 4;
+  }
+  q = by_three(2147483647);
+  print_int(q);
+  print_string("\n");
+  q = by_seven(2147483647);
+  print_int(q);
+  print_string("\n");
+  q = by_seven(4294967295);
+  print_int(q);
+  print_string("\n");
+  q = by_all_ones(12345);
+  print_int(q);
+  print_string(" ");
+  q = by_all_ones(4294967294);
+  print_int(q);
+  print_string(" ");
+  q = by_all_ones(4294967295);
+  print_int(q);
+  print_string("\n");
+  return 0;
+}
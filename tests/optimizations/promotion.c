@@ -0,0 +1,70 @@
+/* Locals carried around loops, promoted to temporaries. */
+
+void print_int(int i);
+void print_string(char *s);
+
+int fibonacci(int n) {
+  int a;
+  int b;
+  int next;
+  int i;
+  a = 0;
+  b = 1;
+  i = 0;
+  while (i < n) {
+    next = a + b;
+    a = b;
+    b = next;
+    i = i + 1;
+  }
+  return a + 0;
+}
+
+int triangle(int n) {
+  int sum;
+  int row;
+  int column;
+  sum = 0;
+  row = 0;
+  while (row < n) {
+    column = 0;
+    while (column <= row) {
+      sum = sum + 1;
+      column = column + 1;
+    }
+    row = row + 1;
+  }
+  return sum + 0;
+}
+
+int collatz(int n) {
+  int steps;
+  steps = 0;
+  while (n != 1) {
+    if (n % 2 == 0) {
+      n = n / 2;
+    } else {
+      n = 3 * n + 1;
+    }
+    steps = steps + 1;
+  }
+  return steps + 0;
+}
+
+int main(void) {
+  int i;
+  int r;
+  for (i = 0; i < 10; i = i + 1) {
+    r = fibonacci(i);
+    print_int(r);
+    print_string(" ");
+  }
+  print_string("\n");
+  r = triangle(10);
+  print_int(r);
+  print_string("\n");
+  r = collatz(27);
+  print_int(r);
+  print_string("\n");
+  return 0;
+}
@@ -0,0 +1,74 @@
+/* Conditions on constants, including an if ladder, are folded and the
+   branches that cannot run are removed. */
+
+void print_int(int i);
+void print_string(char *s);
+
+int ladder(int n) {
+  int level;
+  int result;
+  level = 3;
+  if (level == 1) {
+    result = n + 100;
+  } else if (level == 2) {
+    result = n + 200;
+  } else if (level == 3) {
+    result = n + 300;
+  } else {
+    result = n + 400;
+  }
+  return result + 0;
+}
+
+int through_loop(int n) {
+  int flag;
+  int scale;
+  int total;
+  int i;
+  flag = 0;
+  scale = 4;
+  total = 0;
+  i = 0;
+  while (i < n) {
+    if (flag == 1) {
+      scale = scale + 1;
+    }
+    total = total + scale;
+    i = i + 1;
+  }
+  return total + 0;
+}
+
+int merged(int n) {
+  int k;
+  int m;
+  if (n < 10) {
+    k = 6;
+  } else {
+    k = 6;
+  }
+  m = k * 7;
+  if (m == 42) {
+    print_string("forty-two ");
+  } else {
+    print_string("wrong ");
+  }
+  return m + n;
+}
+
+int main(void) {
+  int r;
+  r = ladder(5);
+  print_int(r);
+  print_string("\n");
+  r = through_loop(5);
+  print_int(r);
+  print_string("\n");
+  r = merged(3);
+  print_int(r);
+  print_string("\n");
+  r = merged(30);
+  print_int(r);
+  print_string("\n");
+  return 0;
+}
@@ -0,0 +1,53 @@
+/* && and || are generated as branches: each call prints its tag, so the
+   output shows which operands were evaluated. */
+
+void print_int(int i);
+void print_string(char *s);
+
+int yes(int tag) {
+  print_int(tag);
+  print_string(" ");
+  return 1;
+}
+
+int no(int tag) {
+  print_int(tag);
+  print_string(" ");
+  return 0;
+}
+
+int main(void) {
+  int i;
+  if (no(1) && yes(2)) {
+    print_string("wrong");
+  }
+  print_string("\n");
+  if (yes(3) || no(4)) {
+    print_string("right");
+  }
+  print_string("\n");
+  if (yes(5) && no(6)) {
+    print_string("wrong");
+  } else {
+    print_string("right");
+  }
+  print_string("\n");
+  if (no(7) || yes(8) && no(9)) {
+    print_string("wrong");
+  } else {
+    print_string("right");
+  }
+  print_string("\n");
+  if ((no(10) || yes(11)) && (yes(12) || no(13))) {
+    print_string("right");
+  }
+  print_string("\n");
+  i = 0;
+  while (i < 3 && yes(i)) {
+    i = i + 1;
+  }
+  print_string("\n");
+  print_int(i);
+  print_string("\n");
+  return 0;
+}